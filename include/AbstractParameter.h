@@ -69,6 +69,11 @@ public:
   static AbstractParameter * createFromNode(QDomNode node, QObject * parent = nullptr);
 signals:
   void valueChanged();
+  void interactionChanged(bool active);
+
+protected slots:
+  void startInteraction();
+  void finishInteraction();
 };
 
 #endif // ZART_ABSTRACTPARAMETER_H
@@ -0,0 +1,98 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   CameraDiscovery.h
+ * @date   Oct 2026
+ * @brief  Declaration of the class CameraDiscovery
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_CAMERADISCOVERY_H
+#define ZART_CAMERADISCOVERY_H
+
+#include <QList>
+#include <QThread>
+#include <QTimer>
+#include "WebcamSource.h"
+
+class QFileSystemWatcher;
+
+/**
+ * Detects the available cameras (and their resolutions) in a background
+ * thread. A new detection is triggered whenever the content of /dev
+ * changes, so that cameras can be plugged or unplugged while running.
+ *
+ * Once the cameras are listed, the capture backends of the new ones are
+ * measured by the same thread, one camera at a time, and backendsProbed()
+ * is emitted. Cameras should not be opened while isBusy(): opening one
+ * interrupts its measurement.
+ */
+class CameraDiscovery : public QThread {
+  Q_OBJECT
+public:
+  CameraDiscovery(QObject * parent = nullptr);
+  ~CameraDiscovery() override;
+  const QList<WebcamSource::CameraInfo> & cameras() const;
+  void setHotplugEnabled(bool on);
+  bool isBusy() const; // Detecting cameras, or measuring their backends
+
+public slots:
+  void discover();
+
+signals:
+  void camerasDiscovered();
+  void backendsProbed();
+
+protected:
+  void run() override;
+
+private slots:
+  void onFinished();
+
+private:
+  QList<WebcamSource::CameraInfo> _cameras;
+  QFileSystemWatcher * _watcher;
+  QTimer _hotplugTimer;
+  bool _busy;
+  bool _pending;
+  bool _probing; // Measuring the capture backends, after a detection
+  static const int HotplugDelay = 500; // ms, leaves udev some time to set up the device
+};
+
+#endif // ZART_CAMERADISCOVERY_H
@@ -75,11 +75,13 @@ public slots:
   void reset();
 signals:
   void valueChanged();
+  void interactionChanged(bool active);
 
 protected:
   void clear();
   QVector<AbstractParameter *> _presetParameters;
-  QString _valueString;
+  mutable QString _valueString;
+  mutable bool _valueStringIsValid;
   QPushButton * _pbReset;
   QLabel * _labelNoParams;
   bool _hasKeypoints;
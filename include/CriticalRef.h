@@ -47,6 +47,7 @@
 #define ZART_CRITICALREF_H
 
 #include <QMutex>
+#include "Tracing.h"
 
 template <typename T> class CriticalRef {
 public:
@@ -81,7 +82,7 @@ template <typename T> const T & CriticalRef<T>::object() const
 
 template <typename T> void CriticalRef<T>::lock()
 {
-  _mutex.lock();
+  Tracing::lock(_mutex, "CriticalRef wait");
 }
 
 template <typename T> void CriticalRef<T>::unlock()
@@ -47,16 +47,21 @@
 #ifndef ZART_FILTERTHREAD_H
 #define ZART_FILTERTHREAD_H
 
+#include <QAtomicInt>
+#include <QMutex>
 #include <QThread>
+#include <QVector>
+#include <atomic>
 #include "Common.h"
 #include "CriticalRef.h"
+#include "FrameBus.h"
+#include "FrameTimings.h"
+#include "ImageSource.h"
 #ifndef gmic_core
 #include "CImg.h"
 #endif
 #include "gmic.h"
-class ImageSource;
-class QMutex;
-class QImage;
+class RenderCache;
 class QSemaphore;
 
 class FilterThread : public QThread {
@@ -74,8 +79,8 @@ public:
     Original
   };
 
-  FilterThread(ImageSource & webcam, const QString & command, QImage * outputImageA, QMutex * imageMutexA, QImage * outputImageB, QMutex * imageMutexB, PreviewMode previewMode, int frameSkip, int fps,
-               QSemaphore * blockingSemaphore);
+  // Frames are published on the bus, imageAvailable() is emitted after each output frame
+  FilterThread(ImageSource & webcam, const QString & command, FrameBus & frameBus, PreviewMode previewMode, int frameSkip, int fps, QSemaphore * blockingSemaphore);
 
   ~FilterThread() override;
 
@@ -83,6 +88,21 @@ public:
   void setMousePosition(int x, int y, int buttons);
 
   void setArguments(const QString &);
+  void setRenderCache(RenderCache *);
+  void setFrameTimings(FrameTimings *);
+  void setProgressiveRendering(bool);
+  void setInteractive(bool);
+  bool isInteractive() const;
+  void setInteractionScale(float);
+  void setLumaOnly(bool);
+  // After each output frame, the thread waits for room in this subscription (null: never waits)
+  void setOutputThrottle(const FrameBus::SubscriptionPtr &);
+  // Counters of this run, for monitoring
+  int capturedFrames() const;
+  int droppedFrames() const; // Source frames lost before their capture (not the ones skipped on purpose)
+  int gmicErrors() const;
+  QString lastGmicError();
+  int frameSkip() const;
 
 public slots:
 
@@ -99,16 +119,28 @@ signals:
 
 private:
   void setCommand(const QString & command);
+  void runCommand(const QString & arguments, const QSize & viewSize, float scale = 1.0f);
+  bool renderProgressively(const QString & arguments, const QSize & viewSize);
+  void runScaledCommand(const QString & arguments, const QSize & viewSize, float scale);
+  float effectiveInteractionScale() const;
+  QVector<float> progressiveScales() const;
+  bool renderRequestChanged(const QString & arguments);
+  void dropPendingRenderRequests();
+  void waitForOutputRoom();
+  bool abortRequested();
+  bool takeAbortRequest();
+  void presentOutput();
+  void publishInput();
+  void publishOutput(const QImage & image);
+  QString renderCacheKey(const QString & arguments, const QSize & viewSize) const;
+  void recordTiming(FrameTimings::Stage stage, qint64 start);
 
   ImageSource & _imageSource;
   QString _command;
   CriticalRef<QString> _arguments;
   CriticalRef<QSize> _viewSize;
   bool _commandUpdated;
-  QImage * _outputImageA;
-  QMutex * _imageMutexA;
-  QImage * _outputImageB;
-  QMutex * _imageMutexB;
+  FrameBus & _frameBus;
   QSemaphore * _blockingSemaphore;
   PreviewMode _previewMode;
   int _frameSkip;
@@ -123,6 +155,27 @@ private:
   cimg_library::CImgList<char> _gmic_images_names;
   gmic * _gmic;
   bool _noFilter;
+  bool _commandUsesMouse;
+  RenderCache * _renderCache;
+  FrameTimings * _timings;
+  QAtomicInt _capturedFrames;
+  QAtomicInt _droppedFrames;
+  QAtomicInt _gmicErrors;
+  CriticalRef<QString> _lastGmicError;
+  CriticalRef<FrameBus::SubscriptionPtr> _outputThrottle;
+  quint64 _lastSequence;
+  qint64 _filterTime; // us, for the current frame
+  qint64 _outputTime;
+  bool _progressiveRendering;
+  std::atomic<bool> _refining;
+  bool _abortRendering; // Polled by G'MIC, which takes a bool *: written with _arguments locked
+  bool _statefulCommand;
+  cimg_library::CImg<float> _fullResolutionInput;
+  std::atomic<bool> _interactive;
+  float _interactionScale;
+  bool _lumaOnly;
+  static const int ProgressiveMinimumSize = 640;
+  static const int InteractionMaximumSize = 1024;
 };
 
 #endif // ZART_FILTERTHREAD_H
@@ -0,0 +1,150 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   FrameBus.h
+ * @date   Oct 2026
+ * @brief  Declaration of the class FrameBus
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_FRAMEBUS_H
+#define ZART_FRAMEBUS_H
+
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QQueue>
+#include <QSize>
+#include <QWaitCondition>
+#include <climits>
+#include <memory>
+#include "ImageSource.h"
+
+class FrameBufferPool;
+
+/**
+ * Frames of the pipeline, published by the filter thread for any number of
+ * consumers (views, recorder, raw output...).
+ *
+ * A published frame is immutable and reference counted: all subscribers
+ * share the same pixels, which go back to a pool once the last of them
+ * has released it. Each subscription has its own queue, with its depth and
+ * what to drop when it is full. Publishing never waits: a slow subscriber
+ * only loses frames.
+ */
+class FrameBus {
+public:
+  enum Channel
+  {
+    Input = 0x1, // Captured frames, before any filter
+    Output = 0x2 // Rendered frames, as displayed
+  };
+
+  enum DropPolicy
+  {
+    DropOldest, // Keeps the most recent frames (live outputs)
+    DropNewest  // Keeps the queued frames (encoders)
+  };
+
+  struct Frame {
+    Channel channel;
+    QImage image; // RGB888, never written once published
+    ImageSource::FrameInfo info;
+    qint64 published; // us, see ImageSource::monotonicTime()
+  };
+  typedef std::shared_ptr<const Frame> FramePtr;
+
+  class Subscription {
+  public:
+    Subscription(int channels, int depth, DropPolicy policy);
+    // Waits for a frame; null on timeout, or once closed and empty
+    FramePtr take(unsigned long timeoutMs = ULONG_MAX);
+    // The most recent frame, older pending ones are dropped. Never waits.
+    FramePtr takeLatest();
+    // For consumers which prefer to slow down their producer than to lose frames
+    bool waitForRoom(unsigned long timeoutMs = ULONG_MAX);
+    // No more frames are queued, pending ones can still be taken. The bus forgets it.
+    void close();
+    bool isClosed();
+    void clear();
+    int channels() const;
+    int depth() const;
+    int pending(); // Frames queued, not taken yet
+    quint64 received();
+    quint64 dropped();
+
+  private:
+    friend class FrameBus;
+    void offer(const FramePtr & frame);
+    const int _channels;
+    const int _depth;
+    const DropPolicy _policy;
+    QQueue<FramePtr> _frames;
+    QMutex _mutex;
+    QWaitCondition _frameQueued;
+    QWaitCondition _frameTaken;
+    bool _closed;
+    quint64 _received;
+    quint64 _dropped;
+  };
+  typedef std::shared_ptr<Subscription> SubscriptionPtr;
+
+  FrameBus();
+  ~FrameBus();
+  SubscriptionPtr subscribe(int channels, int depth, DropPolicy policy);
+  void unsubscribe(const SubscriptionPtr & subscription);
+  bool hasSubscribers(Channel channel);
+  // An RGB888 image whose pixels are recycled, to be filled then published
+  QImage allocateImage(const QSize & size);
+  void publish(Channel channel, const QImage & image, const ImageSource::FrameInfo & info);
+  QList<SubscriptionPtr> subscriptions();
+  quint64 published(Channel channel);
+  qint64 lastPublished(Channel channel); // us, -1 if nothing was published yet
+  static const int PoolSize = 8; // Free buffers kept for reuse
+
+private:
+  static int channelIndex(Channel channel);
+  QMutex _mutex;
+  QList<SubscriptionPtr> _subscriptions;
+  quint64 _published[2];
+  qint64 _lastPublished[2];
+  std::shared_ptr<FrameBufferPool> _pool;
+};
+
+#endif // ZART_FRAMEBUS_H
@@ -0,0 +1,120 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   FrameSink.h
+ * @date   Oct 2026
+ * @brief  Declaration of the class FrameSink
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_FRAMESINK_H
+#define ZART_FRAMESINK_H
+
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+#include <QThread>
+#include <vector>
+#include "FrameBus.h"
+#include "ImageSource.h"
+#include "RawFrame.h"
+#include "SharedFrameRing.h"
+
+/**
+ * Writes the output frames of a bus as raw pixels for other processes,
+ * from its own thread: to the standard output, to a named FIFO, to a
+ * shared memory ring (see RawFrame.h) or to a v4l2loopback device. Only
+ * the latest frame is kept while the output is busy.
+ *
+ * The output is given as "stdout", "fifo:<path>", "shm:<name>" or
+ * "v4l2:<device>".
+ */
+class FrameSink : public QThread {
+public:
+  enum Kind
+  {
+    InvalidKind,
+    StandardOutput,
+    Fifo,
+    SharedMemory,
+    V4L2Loopback
+  };
+
+  explicit FrameSink(const QString & spec);
+  ~FrameSink() override;
+  bool isValid() const;
+  const QString & spec() const;
+  void setPixelFormat(RawFrame::PixelFormat format);
+  void setHeaders(bool on);
+  void attach(FrameBus & bus);
+  void stop();
+  quint64 framesWritten();
+  quint64 framesDropped();
+  static Kind kindFromSpec(const QString & spec, QString * target = nullptr);
+  static RawFrame::PixelFormat pixelFormatFromName(const QString & name);
+  static FrameSink * create(const QString & spec, const QString & format, bool headers);
+
+protected:
+  void run() override;
+
+private:
+  bool openOutput(const QSize & size);
+  void closeOutput();
+  bool writeFrame(const QImage & image, const ImageSource::FrameInfo & frame);
+  bool writeAll(const void * data, size_t size);
+  void convertRow(const uchar * src, uchar * dst, int width) const;
+
+  QString _spec;
+  Kind _kind;
+  QString _target;
+  RawFrame::PixelFormat _format;
+  bool _headers;
+  FrameBus::SubscriptionPtr _subscription;
+  QMutex _mutex;
+  int _fd;
+  bool _outputOpen;
+  SharedFrameRing _ring;
+  QSize _size;
+  std::vector<uchar> _buffer;
+  quint64 _written;
+  quint64 _dropped;
+};
+
+#endif // ZART_FRAMESINK_H
@@ -0,0 +1,106 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   FrameTimings.h
+ * @date   Oct 2026
+ * @brief  Declaration of the class FrameTimings
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_FRAMETIMINGS_H
+#define ZART_FRAMETIMINGS_H
+
+#include <QAtomicInt>
+#include <QString>
+#include <QStringList>
+#include <QtGlobal>
+
+/**
+ * Durations of the stages of the last frames, from capture to paint, to
+ * tell whether the pipeline is bound by the source, the filter or the
+ * display.
+ *
+ * Each stage is recorded by a single thread (the filter thread up to the
+ * output conversion, the GUI thread for the queue and the paint) into a
+ * ring of the last WindowSize durations, without any lock. The statistics
+ * are computed over these rings when asked, from any other thread.
+ */
+class FrameTimings {
+public:
+  enum Stage
+  {
+    Capture,    // Waiting for and reading the source frame
+    ConvertIn,  // Source pixels to the G'MIC input
+    Filter,     // G'MIC command(s)
+    ConvertOut, // G'MIC output (or merge with the source) to the published image
+    QueueWait,  // From its publication on the bus to its display
+    Paint,      // Drawing of the views
+    StageCount
+  };
+
+  struct Statistics {
+    int samples;
+    float p50; // ms
+    float p95;
+    float max;
+  };
+
+  FrameTimings();
+  void reset();
+  void record(Stage stage, qint64 duration); // us
+  Statistics statistics(Stage stage) const;
+  // The stage with the highest median, StageCount if nothing was recorded
+  Stage slowestStage() const;
+  // "capture 1.2/2.0/3.1 ms, G'MIC ..." (p50/p95/max) for the stages recorded
+  QString summary() const;
+  // The same as aligned lines, with a header
+  QStringList table() const;
+  static QString stageName(Stage stage);
+  static const int WindowSize = 256;
+
+private:
+  struct Ring {
+    QAtomicInt next;
+    QAtomicInt size;
+    QAtomicInt durations[WindowSize];
+  };
+  Ring _rings[StageCount];
+};
+
+#endif // ZART_FRAMETIMINGS_H
@@ -0,0 +1,114 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   HeadlessRunner.h
+ * @date   Oct 2026
+ * @brief  Declaration of the class HeadlessRunner
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_HEADLESSRUNNER_H
+#define ZART_HEADLESSRUNNER_H
+
+#include <QDomNode>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include "FrameBus.h"
+#include "FrameTimings.h"
+class FilterThread;
+class FrameSink;
+class ImageSource;
+class MetricsReporter;
+class MjpegServer;
+class Recorder;
+class WebcamSource;
+
+/**
+ * Runs the filter pipeline without any widget (--headless), from an input
+ * (camera, video file, image or image sequence) to an output file, as fast
+ * as the source and the command allow.
+ */
+class HeadlessRunner : public QObject {
+  Q_OBJECT
+public:
+  HeadlessRunner();
+  ~HeadlessRunner() override;
+  int exec(const QStringList & arguments);
+  static bool isRequested(int argc, char * argv[]);
+  static QString presetArguments(const QDomNode & preset);
+
+public slots:
+  void stop();
+
+private slots:
+  void onImageAvailable();
+
+private:
+  bool openInput(const QString & input, const QStringList & arguments);
+  bool loadCommand(const QString & preset, const QString & presetsFile);
+  bool writeFrame(const QImage & image);
+  void printStatistics();
+  static QString optionValue(const QStringList & arguments, const QString & option, const QString & defaultValue = QString());
+
+  ImageSource * _source;
+  WebcamSource * _webcam;
+  FilterThread * _filterThread;
+  QString _command;
+  QString _arguments;
+  QString _output;
+  FrameBus _frameBus;
+  FrameBus::SubscriptionPtr _outputSubscription;
+  FrameTimings _frameTimings;
+  Recorder * _recorder;
+  FrameSink * _frameSink;
+  MjpegServer * _mjpegServer;
+  MetricsReporter * _metricsReporter;
+  double _outputRate;
+  int _maxFrames;
+  int _frames;
+  int _failures;
+  QElapsedTimer _runTime;
+  QElapsedTimer _frameTime;
+  qint64 _longestFrame;
+};
+
+#endif // ZART_HEADLESSRUNNER_H
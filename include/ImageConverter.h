@@ -46,13 +46,13 @@
 #ifndef ZART_IMAGECONVERTER_H
 #define ZART_IMAGECONVERTER_H
 
-#include <QMutex>
 #include <opencv2/opencv.hpp>
 #ifndef gmic_core
 #include "CImg.h"
 #endif
 #include "gmic.h"
 
+class ImageSource;
 class QImage;
 
 class ImageConverter {
@@ -70,8 +70,9 @@ public:
   static void convert(const cv::Mat * in, QImage * out);
   static void convert(const QImage & in, cv::Mat ** out);
   static void convert(const cv::Mat * in, cimg_library::CImg<float> & out);
+  static void convert(const ImageSource & source, cimg_library::CImg<float> & out, bool lumaOnly = false);
   static void convert(const cimg_library::CImg<float> & in, QImage * out);
-  static void merge(cv::Mat * cvImage, const cimg_library::CImg<float> & cimgImage, QImage * out, QMutex * imageMutex, MergeDirection direction);
+  static void merge(cv::Mat * cvImage, const cimg_library::CImg<float> & cimgImage, QImage * out, MergeDirection direction);
   static void mergeTop(cv::Mat * cvImage, const cimg_library::CImg<float> & cimgImage, QImage * out);
   static void mergeLeft(cv::Mat * cvImage, const cimg_library::CImg<float> & cimgImage, QImage * out);
   static void mergeBottom(cv::Mat * cvImage, const cimg_library::CImg<float> & cimgImage, QImage * out, bool shift = false);
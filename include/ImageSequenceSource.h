@@ -0,0 +1,121 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   ImageSequenceSource.h
+ * @date   Oct 2026
+ * @brief  Declaration of the class ImageSequenceSource
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_IMAGESEQUENCESOURCE_H
+#define ZART_IMAGESEQUENCESOURCE_H
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+#include <opencv2/opencv.hpp>
+#include <thread>
+#include <vector>
+#include "ImageSource.h"
+
+/**
+ * Numbered image files (a folder, a printf-style pattern like
+ * "frame_%04d.png", or any file of the sequence) played as a video.
+ * A pool of threads decodes the next frames ahead, in a bounded set of
+ * buffers which are reused from one frame to another.
+ */
+class ImageSequenceSource : public ImageSource {
+public:
+  ImageSequenceSource();
+  ~ImageSequenceSource() override;
+  void capture() override;
+  void skipFrames(int count) override;
+  bool open(const QString & path);
+  void close();
+  const QString & filename() const;
+  const QString & filePath() const;
+  int frameCount() const;
+  int position() const;
+  void seek(int frame);
+  void setLoop(bool);
+  static QStringList sequenceFiles(const QString & path);
+  static bool isSequence(const QString & path);
+  static const int DefaultPrefetchMB = 512;
+  static const int MaximumSlots = 64;
+
+private:
+  enum SlotState
+  {
+    Free,
+    Decoding,
+    Ready,
+    Failed,
+    Held // Shared with the source image
+  };
+  struct Slot {
+    cv::Mat image;
+    int ticket; // Frame number, keeps increasing when looping
+    unsigned int generation;
+    SlotState state;
+  };
+  void decodeFrames();
+  int slotFor(int ticket) const;
+  int freeSlot() const;
+  void releaseSlots(bool all);
+
+  QString _filename;
+  QString _filePath;
+  QStringList _files;
+  QVector<Slot> _slots;
+  std::vector<std::thread> _decoders;
+  mutable QMutex _mutex;
+  QWaitCondition _slotReady;
+  QWaitCondition _slotFreed;
+  int _next;
+  int _scheduled;
+  unsigned int _generation;
+  int _heldSlot;
+  int _position;
+  bool _loop;
+  bool _continue;
+};
+
+#endif // ZART_IMAGESEQUENCESOURCE_H
@@ -53,26 +53,61 @@ class Mat;
 }
 
 #include <QSize>
+#include <QtGlobal>
 
 class ImageSource {
 public:
+  enum PixelFormat
+  {
+    BGR24,
+    YUYV,
+    NV12,
+    BGRX32 // As on X11 screens, the fourth byte is unused
+  };
+
+  struct FrameInfo {
+    qint64 timestamp; // Capture time, in us (see monotonicTime())
+    quint64 sequence;
+    int sourceId;
+  };
+
   ImageSource();
   virtual ~ImageSource();
   cv::Mat * image() const;
+  bool hasImage() const;
+  PixelFormat pixelFormat() const;
+  const unsigned char * rawData() const;
+  int rawStride() const;
   int width() const;
   int height() const;
   QSize size() const;
+  unsigned int generation() const;
+  const FrameInfo & frameInfo() const;
   virtual void capture() = 0;
+  virtual void skipFrames(int count);
+  // False if the frame has been overwritten while it was read (memory shared with another process)
+  virtual bool isFrameIntact() const;
+  static qint64 monotonicTime();
 
 protected:
   void setWidth(int);
   void setHeight(int);
   void setImage(cv::Mat * image);
+  // The raw data must remain valid until the next frame is set
+  void setRawFrame(PixelFormat format, const unsigned char * data, int stride, int width, int height);
+  // New frames are stamped when set, sources knowing better may override it
+  void setFrameInfo(qint64 timestamp, quint64 sequence);
 
 private:
-  cv::Mat * _image;
+  mutable cv::Mat * _image;
+  PixelFormat _pixelFormat;
+  const unsigned char * _rawData;
+  int _rawStride;
   int _width;
   int _height;
+  unsigned int _generation;
+  FrameInfo _frameInfo;
+  void stampFrame();
 };
 
 #endif // ZART_IMAGESOURCE_H
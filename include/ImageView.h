@@ -48,7 +48,9 @@
 
 #include <QElapsedTimer>
 #include <QMutex>
+#include <QStringList>
 #include <QWidget>
+#include "ImageSource.h"
 #include "KeypointList.h"
 
 class QPaintEvent;
@@ -65,6 +67,9 @@ public:
   void setKeypoints(const KeypointList & keypoints);
   KeypointList keypoints() const;
   QRect imagePosition();
+  void setFrameCounterVisible(bool on);
+  void setFrameInfo(const ImageSource::FrameInfo & frame);
+  void setPerformanceOverlay(const QStringList & lines); // Hidden if empty
 
 public slots:
   void zoomOriginal();
@@ -89,6 +94,7 @@ signals:
   void spaceBarPressed();
   void escapePressed();
   void keypointPositionsChanged();
+  void interactionChanged(bool active);
   void resized(QSize);
 
 private:
@@ -102,9 +108,14 @@ private:
   KeypointList _keypoints;
   int _movedKeypointIndex;
   QElapsedTimer _keypointTimestamp;
+  bool _frameCounterVisible;
+  ImageSource::FrameInfo _frameInfo;
+  QStringList _performanceLines;
   static int roundedDistance(const QPoint & p1, const QPoint & p2);
   int keypointUnderMouse(const QPoint & p);
   void paintKeypoints(QPainter & painter);
+  void paintFrameCounter(QPainter & painter);
+  void paintPerformanceOverlay(QPainter & painter);
   QPoint keypointToPointInWidget(const KeypointList::Keypoint & kp) const;
   QPoint keypointToVisiblePointInWidget(const KeypointList::Keypoint & kp) const;
   QPointF pointInWidgetToKeypointPosition(const QPoint & p) const;
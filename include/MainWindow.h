@@ -56,8 +56,17 @@
 #include <QVector>
 #include <QtXml>
 #include "FilterThread.h"
+#include "FrameBus.h"
+#include "RenderCache.h"
+#include "ImageSequenceSource.h"
+#include "RawFrameSource.h"
+#include "ScreenSource.h"
 #include "StillImageSource.h"
 #include "VideoFileSource.h"
+#include "CameraDiscovery.h"
+#include "FrameTimings.h"
+#include "LatencyMonitor.h"
+#include "V4L2Source.h"
 #include "WebcamSource.h"
 #include "ui_MainWindow.h"
 
@@ -68,6 +77,10 @@ class QComboBox;
 class QNetworkReply;
 class QNetworkAccessManager;
 class QMenu;
+class FrameSink;
+class MetricsReporter;
+class MjpegServer;
+class Recorder;
 class TreeWidgetPresetItem;
 class FullScreenWidget;
 class OutputWindow;
@@ -83,7 +96,10 @@ public:
   {
     Webcam,
     StillImage,
-    Video
+    Video,
+    ImageSequence,
+    Stream,
+    Screen
   };
   enum DisplayMode
   {
@@ -93,6 +109,14 @@ public:
 
   void setInputImage(QString filepath);
   void setInputVideo(QString filepath);
+  void setInputSequence(QString path);
+  void setInputStream(const QString & spec, const QSize & rawSize, const QString & rawFormat);
+  void setInputScreen(const QString & spec);
+  void setRecordFile(QString filename);
+  void setFrameSink(FrameSink * sink);
+  void setMjpegAddress(QString address, double fps = 0.0, int quality = -1);
+  // From the settings (Metrics/*) unless given
+  void setMetrics(const QString & socketPath, const QString & logFile, int interval = 0);
 
 public slots:
 
@@ -123,11 +147,23 @@ public slots:
   void onReloadPresets();
   void onPreviewModeChanged(int index);
   void onRightPanel(bool);
+  void onLumaOnlyInput(bool);
+  void onFrameCounterOverlay(bool);
+  void onPerformanceOverlay(bool);
+  void onTraceAction(bool);
   void onComboSourceChanged(int);
   void onOpenImageFile();
   void onOpenVideoFile();
+  void onOpenImageSequence();
+  void onOpenStream();
+  void onOpenScreen();
   void updateWindowTitle();
   void onVideoFileLoop(bool);
+  void onVideoPlaybackClock(bool);
+  void onVideoPositionChanged(int);
+  void onVideoPositionReleased();
+  void seekVideo();
+  void updateVideoPosition();
   void changePlayButtonAppearence(bool);
   void onFilterThreadFinished();
   void onCommandParametersChanged();
@@ -136,6 +172,7 @@ public slots:
   void onRefreshCameraResolutions();
   void onDetectCameras();
   void initGUIFromCameraList(const QList<int> & camList, int firstUnused);
+  void updateCameraList(const QList<int> & camList, const QString & currentCamera);
   void onOutputWindow(bool);
   void onOutputWindowClosing();
   void onAddFave();
@@ -152,13 +189,38 @@ private slots:
   void onOutputWindowKeypointsEvent();
   void onFullScreenKeypointsEvent();
   void fullScreenImageViewResized(QSize size);
+  void onInteractionChanged(bool active);
+  void onInteractionIdle();
+  void flushRenderRequest();
+  void onCamerasDiscovered();
+  void onBackendsProbed();
+  void showLatencyStatistics();
+  void updatePerformanceOverlay();
+  void updateCaptureMenus();
+  void onCaptureBackendChosen(QAction * action);
+  void onBufferSizeChosen(QAction * action);
+  void onRecordAction(bool);
+  void updateRecordMenus();
+  void onRecordCodecChosen(QAction * action);
+  void onRecordPolicyChosen(QAction * action);
+  void onMjpegAction(bool);
 
 private:
   void setPresets(const QDomElement &);
   void addPresets(const QDomElement &, TreeWidgetPresetItem * parent);
   void setCurrentPreset(QDomNode node);
   void showOneSourceImage();
+  void fillCameraCombos(const QList<int> & camList);
+  int keptSourceIndex();
   void updateCameraResolutionCombo();
+  void showRenderCacheStatistics();
+  void setInteractionLOD(bool on);
+  void requestRender();
+  void updateFilterThreadOutputs();
+  void saveCameraDefaultResolutions();
+  void releaseWebcamIfIdle();
+  void reopenWebcam();
+  void stopRecording();
   TreeWidgetPresetItem * findPresetItem(QTreeWidget * tree, const QString & folder, const QString & name);
   TreeWidgetPresetItem * findPresetItem(QTreeWidget * tree, const QStringList & path);
 
@@ -167,10 +229,19 @@ private:
   int _firstWebcamIndex;
   int _secondWebcamIndex;
   FilterThread * _filterThread;
+  FrameBus _frameBus;
+  FrameBus::SubscriptionPtr _displaySubscription; // Latest output frame, for the views
   Source _source;
+#ifdef HAS_V4L2
+  V4L2Source _webcam;
+#else
   WebcamSource _webcam;
+#endif
   StillImageSource _stillImage;
   VideoFileSource _videoFile;
+  ImageSequenceSource _imageSequence;
+  RawFrameSource _rawStream;
+  ScreenSource _screen;
   ImageSource * _currentSource;
   QDomDocument _presets;
   QDomNode _currentPresetNode;
@@ -181,10 +252,41 @@ private:
   QAction * _builtInPresetsAction;
   QAction * _startStopAction;
   QAction * _outputWindowAction;
+  QMenu * _captureBackendMenu;
+  QMenu * _bufferSizeMenu;
+  QAction * _recordAction;
+  QMenu * _recordCodecMenu;
+  QMenu * _recordPolicyMenu;
+  Recorder * _recorder;
+  QString _recordFile;
+  FrameSink * _frameSink;
+  QAction * _mjpegAction;
+  MjpegServer * _mjpegServer;
+  QString _mjpegAddress;
+  double _mjpegRate;
+  int _mjpegQuality;
+  MetricsReporter * _metricsReporter;
   DisplayMode _displayMode;
   FullScreenWidget * _fullScreenWidget;
   OutputWindow * _outputWindow;
   QSemaphore _filterThreadSemaphore;
+  RenderCache _renderCache;
+  QTimer _interactionIdleTimer;
+  bool _interacting;
+  QTimer _renderRequestTimer;
+  bool _pendingParameters;
+  int _mouseX;
+  int _mouseY;
+  int _mouseButtons;
+  CameraDiscovery _cameraDiscovery;
+  LatencyMonitor _latencyMonitor;
+  FrameTimings _frameTimings;
+  bool _performanceOverlay;
+  QTimer _latencyReportTimer;
+  QTimer _videoPositionTimer;
+  QTimer _videoSeekTimer; // Throttles the seeks while the position slider is dragged
+  bool _forceCameraListUpdate;
+  bool _openWebcamWhenProbed;
   bool _zeroFPS;
   int _presetsCount;
   QVector<int> _cameraDefaultResolutionsIndexes;
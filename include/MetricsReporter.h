@@ -0,0 +1,117 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   MetricsReporter.h
+ * @date   Oct 2026
+ * @brief  Declaration of the class MetricsReporter
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_METRICSREPORTER_H
+#define ZART_METRICSREPORTER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include "FrameBus.h"
+class FilterThread;
+class FrameTimings;
+class QLocalServer;
+
+/**
+ * Health and performance of the pipeline for a supervisor, as a JSON
+ * object on a single line: frame rates, dropped frames, stage durations,
+ * current preset, G'MIC errors, memory and queue depths.
+ *
+ * A snapshot is written to each client of a Unix domain socket, which is
+ * then closed (e.g. socat - UNIX-CONNECT:/tmp/zart.sock), and/or appended
+ * periodically to a file. Frame rates are measured over the last second.
+ */
+class MetricsReporter : public QObject {
+  Q_OBJECT
+public:
+  MetricsReporter(FrameBus & bus, FrameTimings & timings, QObject * parent = nullptr);
+  ~MetricsReporter() override;
+  bool listen(const QString & path);
+  bool openLog(const QString & filename, int interval); // seconds
+  // Before the thread is deleted, then null: its counters are kept
+  void setFilterThread(FilterThread * thread);
+  void setPreset(const QString & name);
+  QByteArray snapshot();
+  static qint64 residentSetSize(); // bytes, -1 if unknown
+  // Settings Metrics/Socket, Metrics/Log and Metrics/Interval unless given. Null if nothing is requested, or on error.
+  static MetricsReporter * create(FrameBus & bus, FrameTimings & timings, const QString & socketPath, const QString & logFile, int interval = 0);
+  static const int DefaultInterval = 10;
+
+private slots:
+  void onNewConnection();
+  void onSample();
+  void onLogTimer();
+
+private:
+  quint64 capturedFrames() const;
+  quint64 droppedFrames() const;
+  quint64 gmicErrors() const;
+
+  FrameBus & _bus;
+  FrameTimings & _timings;
+  QLocalServer * _server;
+  QFile _log;
+  QTimer _logTimer;
+  QTimer _sampleTimer;
+  QElapsedTimer _uptime;
+  QElapsedTimer _sampleTime;
+  FilterThread * _filterThread;
+  QString _preset;
+  // Counters of the previous filter threads
+  quint64 _capturedBase;
+  quint64 _droppedBase;
+  quint64 _errorsBase;
+  QString _lastError;
+  // Last sample, for the rates
+  quint64 _sampledIn;
+  quint64 _sampledOut;
+  float _fpsIn;
+  float _fpsOut;
+};
+
+#endif // ZART_METRICSREPORTER_H
@@ -0,0 +1,164 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   MjpegServer.h
+ * @date   Oct 2026
+ * @brief  Declaration of the classes MjpegServer and MjpegEncoder
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_MJPEGSERVER_H
+#define ZART_MJPEGSERVER_H
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QTcpServer>
+#include <QThread>
+#include <vector>
+#include "FrameBus.h"
+class QTcpSocket;
+
+namespace cv
+{
+class Mat;
+}
+
+/**
+ * Encodes the output frames of a bus as JPEG images from its own thread,
+ * at most at a given rate: only the most recent frame is encoded, older
+ * ones are dropped. The receiver's onFrameEncoded() slot is invoked
+ * (queued) once a new image is available.
+ */
+class MjpegEncoder : public QThread {
+public:
+  explicit MjpegEncoder(QObject * receiver);
+  ~MjpegEncoder() override;
+  void setQuality(int quality);
+  void setMaximumRate(double fps);
+  void attach(FrameBus & bus);
+  void stop();
+  QByteArray latestImage();
+  quint64 framesEncoded();
+
+protected:
+  void run() override;
+
+private:
+  bool encode(const QImage & image);
+
+  QObject * _receiver;
+  FrameBus::SubscriptionPtr _subscription;
+  QMutex _mutex;
+  QByteArray _jpeg;
+  int _quality;
+  double _maximumRate;
+  quint64 _encoded;
+  cv::Mat * _bgr;
+  std::vector<uchar> _buffer;
+};
+
+/**
+ * A small HTTP server for watching the output from a browser, as a
+ * multipart MJPEG stream (http://<address>/stream). The page at "/"
+ * shows it.
+ *
+ * Each frame is encoded once and the same bytes are sent to all the
+ * viewers. A viewer whose connection is still busy with the previous
+ * frame only gets the latest one when it is ready. No frame is taken
+ * from the bus, and nothing is encoded, while nobody is watching.
+ *
+ * The address is given as "[host:]port", localhost by default.
+ */
+class MjpegServer : public QObject {
+  Q_OBJECT
+public:
+  explicit MjpegServer(FrameBus & bus, QObject * parent = nullptr);
+  ~MjpegServer() override;
+  bool listen(const QString & address);
+  void close();
+  bool isListening() const;
+  QString url() const;
+  void setQuality(int quality);
+  void setMaximumRate(double fps);
+  void setMaximumClients(int count);
+  int viewerCount() const;
+  static MjpegServer * create(FrameBus & bus, const QString & address, double fps = 0.0, int quality = -1);
+  static const int DefaultPort = 8080;
+  static const int DefaultQuality = 80;
+  static const int DefaultMaximumRate = 15;
+  static const int DefaultMaximumClients = 16;
+  static const int MaximumRequestSize = 8192;
+
+private slots:
+  void onNewConnection();
+  void onReadyRead();
+  void onBytesWritten();
+  void onDisconnected();
+  void onFrameEncoded();
+
+private:
+  struct Client {
+    QTcpSocket * socket;
+    QString peer;
+    QByteArray request;
+    bool streaming;
+    QByteArray pending; // Latest frame, while the socket is busy with the previous one
+    quint64 sent;
+    quint64 dropped;
+  };
+  Client * client(QTcpSocket * socket);
+  void respond(Client * client);
+  void reply(Client * client, const QByteArray & status, const QByteArray & type, const QByteArray & body);
+  void sendFrame(Client * client, const QByteArray & jpeg);
+  void removeClient(Client * client);
+
+  FrameBus & _bus;
+  QTcpServer _server;
+  QHostAddress _host;
+  MjpegEncoder _encoder;
+  QList<Client *> _clients;
+  int _maximumClients;
+  int _viewers;
+};
+
+#endif // ZART_MJPEGSERVER_H
@@ -0,0 +1,119 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   RawFrame.h
+ * @date   Oct 2026
+ * @brief  Layout of the raw frames exchanged with other processes
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_RAWFRAME_H
+#define ZART_RAWFRAME_H
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Raw frames written to (or read from) pipes, FIFOs and shared memory.
+ * All fields are in the byte order of the host.
+ *
+ * On a pipe, each frame is a FrameHeader followed by the pixels (unless
+ * headers are disabled, for tools like "ffmpeg -f rawvideo").
+ *
+ * A shared memory ring (shm_open() name) starts with a RingHeader, then
+ * holds slotCount slots of slotSize bytes. Each slot begins with a
+ * SlotHeader and its pixels are at SlotHeaderSize bytes from its start.
+ * The n-th published frame goes to slot n % slotCount (the sequence of
+ * its header is the one of the source, which may skip). The lock of a slot is odd
+ * while it is written: a consumer reads it before and after using the
+ * pixels, and drops the frame if it has changed. The doorbell is
+ * incremented (and futex-woken on Linux) after each frame.
+ *
+ * This header does not depend on Qt, so that producers and consumers
+ * written for other programs can include it as is.
+ */
+namespace RawFrame
+{
+enum PixelFormat
+{
+  RGB24 = 1,
+  BGR24 = 2,
+  Gray8 = 3
+};
+
+const std::uint32_t FrameMagic = 0x4d52465a; // "ZFRM"
+const std::uint32_t RingMagic = 0x474e525a;  // "ZRNG"
+const std::uint32_t Version = 1;
+
+struct FrameHeader {
+  std::uint32_t magic;
+  std::uint32_t format; // PixelFormat
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint32_t stride; // Bytes per line
+  std::uint32_t size;   // Bytes of pixels
+  std::int64_t timestamp; // us, monotonic clock of the producer
+  std::uint64_t sequence;
+};
+
+struct RingHeader {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t slotCount;
+  std::uint32_t slotSize;
+  std::atomic<std::uint32_t> doorbell;
+  std::atomic<std::uint32_t> closed; // Set by the producer before it removes the ring
+  std::atomic<std::uint64_t> frames; // Frames published so far, the latest one is frames - 1
+};
+
+struct SlotHeader {
+  std::atomic<std::uint64_t> lock;
+  FrameHeader frame;
+};
+
+const int RingHeaderSize = 64;
+const int SlotHeaderSize = 64;
+
+inline int bytesPerPixel(std::uint32_t format)
+{
+  return (format == Gray8) ? 1 : 3;
+}
+} // namespace RawFrame
+
+#endif // ZART_RAWFRAME_H
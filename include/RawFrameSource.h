@@ -0,0 +1,125 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   RawFrameSource.h
+ * @date   Oct 2026
+ * @brief  Declaration of the class RawFrameSource
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_RAWFRAMESOURCE_H
+#define ZART_RAWFRAMESOURCE_H
+
+#include <QSize>
+#include <QString>
+#include <vector>
+#include "ImageSource.h"
+#include "RawFrame.h"
+#include "SharedFrameRing.h"
+
+/**
+ * Frames written by another process, as described in RawFrame.h: from a
+ * shared memory ring ("shm:<name>"), or from a pipe ("stdin", "-" or
+ * "fifo:<path>").
+ *
+ * BGR24 frames of a ring are used in place, without any copy: the image of
+ * the source points to the slot of the producer, which may overwrite it
+ * once it has gone round the ring. Such frames are counted as torn (see
+ * tornFrames()), the producer should then use more slots.
+ *
+ * Pipes carry a FrameHeader before each frame, unless a raw size is given,
+ * for plain video like the output of "ffmpeg -f rawvideo".
+ */
+class RawFrameSource : public ImageSource {
+public:
+  enum Kind
+  {
+    InvalidKind,
+    SharedMemory,
+    StandardInput,
+    Fifo
+  };
+
+  RawFrameSource();
+  ~RawFrameSource() override;
+  bool open(const QString & spec, const QSize & rawSize = QSize(), const QString & rawFormat = QString());
+  void close();
+  bool isOpen() const;
+  const QString & spec() const;
+  void capture() override;
+  void skipFrames(int count) override;
+  bool isFrameIntact() const override;
+  quint64 tornFrames() const;
+  static Kind kindFromSpec(const QString & spec, QString * target = nullptr);
+  static bool isStream(const QString & spec);
+  static QSize sizeFromString(const QString & text); // Like "640x480"
+  static const int WaitTimeout = 1000;     // ms, before the previous frame is used again
+  static const int ReconnectTimeout = 2000; // ms, for a producer to come back
+
+private:
+  enum ReadStatus
+  {
+    ReadDone,
+    ReadTimeout,
+    ReadEnd
+  };
+  void captureFromRing();
+  bool reopenRing();
+  void captureFromPipe();
+  bool openPipe();
+  void closePipe();
+  ReadStatus readAll(void * data, size_t size, bool waitForStart);
+  void endOfStream();
+
+  QString _spec;
+  Kind _kind;
+  QString _target;
+  SharedFrameRing * _ring;
+  quint64 _lastFrame;
+  const RawFrame::SlotHeader * _heldSlot;
+  quint64 _heldLock;
+  mutable quint64 _tornFrames;
+  int _fd;
+  bool _headers;
+  RawFrame::FrameHeader _rawHeader;
+  std::vector<uchar> _buffer;
+  bool _endOfStream;
+};
+
+#endif // ZART_RAWFRAMESOURCE_H
@@ -0,0 +1,109 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   Recorder.h
+ * @date   Oct 2026
+ * @brief  Declaration of the class Recorder
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_RECORDER_H
+#define ZART_RECORDER_H
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include "FrameBus.h"
+
+/**
+ * Encodes the output frames of a bus into a video file, in its own thread,
+ * from a bounded subscription. The output has a constant frame rate:
+ * frames are placed on the time line of their capture (repeated to fill
+ * gaps, dropped when closer than a frame period), or written one after the
+ * other if timestamps are not used.
+ * When the queue is full, new frames are dropped. With WaitForEncoder, the
+ * producer thread waits for the encoder, either by calling throttle() or
+ * through FilterThread::setOutputThrottle(throttlingSubscription()).
+ * Never from the GUI thread.
+ */
+class Recorder : public QThread {
+public:
+  enum Policy
+  {
+    DropFrames,
+    WaitForEncoder
+  };
+
+  Recorder(const QString & filename, const QString & codec, double fps, Policy policy, int queueSize = DefaultQueueSize);
+  ~Recorder() override;
+  void attach(FrameBus & bus);
+  void setTimestamps(bool on);
+  void throttle();
+  FrameBus::SubscriptionPtr throttlingSubscription() const; // Null with DropFrames
+  void finish();
+  bool hasFailed();
+  quint64 framesWritten();
+  quint64 framesDropped();
+  const QString & filename() const;
+  static QStringList codecs();
+  static QString defaultCodec(const QString & filename);
+  static Policy policyFromName(const QString & name);
+  static QString policyName(Policy policy);
+  static const int DefaultQueueSize = 16;
+  static const int MaximumGap = 2; // s, longer gaps (pauses) are not filled
+
+protected:
+  void run() override;
+
+private:
+  QString _filename;
+  QString _codec;
+  double _fps;
+  Policy _policy;
+  int _queueSize;
+  FrameBus::SubscriptionPtr _subscription;
+  QMutex _mutex;
+  bool _timestamps;
+  bool _failed;
+  quint64 _written;
+  quint64 _dropped;
+};
+
+#endif // ZART_RECORDER_H
@@ -0,0 +1,102 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   RenderCache.h
+ * @date   Oct 2026
+ * @brief  Declaration of the class RenderCache
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_RENDERCACHE_H
+#define ZART_RENDERCACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <list>
+#ifndef gmic_core
+#include "CImg.h"
+#endif
+#include "gmic.h"
+
+/**
+ * Bounded-memory LRU cache of G'MIC outputs, used when the same still image
+ * is processed again with an already seen parameter combination.
+ * Images are stored with 8 bits per channel, which is what ends up on screen.
+ */
+class RenderCache {
+public:
+  struct Statistics {
+    quint64 hits;
+    quint64 misses;
+    quint64 evictions;
+    size_t bytes;
+    size_t maximumBytes;
+    int entries;
+  };
+
+  RenderCache(size_t maximumBytes = DefaultMaximumBytes);
+  ~RenderCache();
+  void setMaximumSize(size_t bytes);
+  size_t maximumSize() const;
+  bool get(const QString & key, cimg_library::CImg<float> & image);
+  void insert(const QString & key, const cimg_library::CImg<float> & image);
+  void clear();
+  Statistics statistics() const;
+
+  static const size_t DefaultMaximumBytes = 512 * 1024 * 1024;
+
+private:
+  struct Entry {
+    QString key;
+    cimg_library::CImg<unsigned char> image;
+  };
+  typedef std::list<Entry> EntryList;
+  void evict(size_t requiredBytes);
+  EntryList _entries; // Most recently used first
+  QHash<QString, EntryList::iterator> _index;
+  size_t _bytes;
+  size_t _maximumBytes;
+  quint64 _hits;
+  quint64 _misses;
+  quint64 _evictions;
+  mutable QMutex _mutex;
+};
+
+#endif // ZART_RENDERCACHE_H
@@ -0,0 +1,105 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   ScreenSource.h
+ * @date   Oct 2026
+ * @brief  Declaration of the class ScreenSource
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_SCREENSOURCE_H
+#define ZART_SCREENSOURCE_H
+
+#include <QElapsedTimer>
+#include <QRect>
+#include <QString>
+#include <QVector>
+#include "ImageSource.h"
+
+struct _XDisplay;
+
+/**
+ * A region of the X11 screen, or a window, captured through the MIT-SHM
+ * extension (XShmGetImage) at a given rate.
+ *
+ * The server writes the pixels into shared memory segments which are used
+ * as raw frames (BGRX32) without any copy. The segments are used in turn:
+ * the one of a frame is only written again BufferCount captures later.
+ *
+ * The region is given as "screen:" (the whole screen), "screen:WxH+X+Y"
+ * or "screen:window=<id>", on the display given by $DISPLAY. Only
+ * available when built with the X11 libraries (HAS_XSHM).
+ */
+class ScreenSource : public ImageSource {
+public:
+  ScreenSource();
+  ~ScreenSource() override;
+  bool open(const QString & spec);
+  void close();
+  bool isOpen() const;
+  const QString & spec() const;
+  void setFrameRate(double fps);
+  double frameRate() const;
+  void capture() override;
+  void skipFrames(int count) override;
+  static bool isScreen(const QString & spec);
+  static const int DefaultFrameRate = 25;
+  static const int BufferCount = 3;
+
+private:
+  struct Buffer;
+  bool parseSpec(const QString & spec);
+  bool allocateBuffers(const QSize & size);
+  void releaseBuffers();
+  bool updateWindowGeometry();
+
+  QString _spec;
+  _XDisplay * _display;
+  unsigned long _window; // Drawable the region is read from
+  bool _followWindow;    // The whole window, wherever it is
+  QRect _region;
+  QVector<Buffer *> _buffers;
+  int _nextBuffer;
+  double _frameRate;
+  QElapsedTimer _clock;
+  qint64 _nextFrame; // ms, on _clock
+  quint64 _failures;
+};
+
+#endif // ZART_SCREENSOURCE_H
@@ -0,0 +1,156 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   Tracing.h
+ * @date   Oct 2026
+ * @brief  Declaration of the class Tracing
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_TRACING_H
+#define ZART_TRACING_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QtGlobal>
+
+/**
+ * Timestamped spans of the work of every thread (capture, conversions,
+ * G'MIC, presentation, preset compilation, mutex waits), saved as a Chrome
+ * trace (chrome://tracing, ui.perfetto.dev) to see how the threads overlap
+ * and where they stall.
+ *
+ * Each thread records into its own buffer of the last BufferSize spans,
+ * without any lock. Buffers are kept after their thread has finished, so
+ * that a trace saved at exit still shows them, and are reused by new
+ * threads once saved (or cleared by start()). Beyond MaximumBuffers, new
+ * threads take over the buffers of the oldest finished ones, or are not
+ * recorded if all the threads are still running.
+ * Nothing is recorded while tracing is not started, apart from the test
+ * of a flag.
+ */
+class Tracing {
+public:
+  static void start(); // Previous spans are cleared
+  static void stop();
+  static inline bool isEnabled();
+  // Spans recorded so far, in the Chrome trace event format
+  static bool save(const QString & filename);
+  // name and category must be string literals: only their address is kept
+  static void record(const char * name, const char * category, qint64 start, qint64 duration);
+  // Locks mutex, recording the wait if it was held by another thread
+  static void lock(QMutex & mutex, const char * name);
+  static const int BufferSize = 65536; // spans per thread (2 MB)
+  static const int MaximumBuffers = 32;
+
+  // Records its lifetime
+  class Span {
+  public:
+    inline Span(const char * name, const char * category = "pipeline");
+    inline ~Span();
+
+  private:
+    const char * _name;
+    const char * _category;
+    qint64 _start;
+  };
+
+  // QMutexLocker recording the wait
+  class Locker {
+  public:
+    inline Locker(QMutex * mutex, const char * name);
+    inline ~Locker();
+
+  private:
+    QMutex * _mutex;
+  };
+
+private:
+  struct Event {
+    const char * name;
+    const char * category;
+    qint64 start; // us
+    qint64 duration;
+  };
+  struct Buffer {
+    QString thread;
+    int id;
+    QAtomicInt next;
+    QAtomicInt size;
+    QAtomicInt finished; // Its thread has ended, the buffer can be reused
+    Event events[BufferSize];
+  };
+  // Releases the buffer of a thread when the thread ends
+  struct BufferOwner {
+    Buffer * buffer = nullptr;
+    ~BufferOwner();
+  };
+  static qint64 now();
+  static QList<Buffer *> & buffers();
+  static Buffer * threadBuffer();
+  static QAtomicInt _enabled;
+};
+
+bool Tracing::isEnabled()
+{
+  return _enabled.loadAcquire();
+}
+
+Tracing::Span::Span(const char * name, const char * category) : _name(name), _category(category), _start(isEnabled() ? now() : -1) {}
+
+Tracing::Span::~Span()
+{
+  if (_start >= 0) {
+    record(_name, _category, _start, now() - _start);
+  }
+}
+
+Tracing::Locker::Locker(QMutex * mutex, const char * name) : _mutex(mutex)
+{
+  lock(*mutex, name);
+}
+
+Tracing::Locker::~Locker()
+{
+  _mutex->unlock();
+}
+
+#endif // ZART_TRACING_H
@@ -0,0 +1,109 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   V4L2Source.h
+ * @date   Oct 2026
+ * @brief  Declaration of the class V4L2Source
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_V4L2SOURCE_H
+#define ZART_V4L2SOURCE_H
+
+#ifdef HAS_V4L2
+
+#include <QVector>
+#include <QtGlobal>
+#include "WebcamSource.h"
+
+class QElapsedTimer;
+
+/**
+ * Webcam source reading frames through the V4L2 streaming I/O interface
+ * (memory mapped driver buffers) instead of cv::VideoCapture. The dequeued
+ * buffer itself is used as the source image (BGR24) or raw frame (YUYV,
+ * NV12), and is given back to the driver on the next capture.
+ * Falls back to the OpenCV capture when the device cannot be streamed.
+ */
+class V4L2Source : public WebcamSource {
+public:
+  V4L2Source();
+  ~V4L2Source() override;
+  void capture() override;
+  void start() override;
+  void stop() override;
+  bool isStarted() const override;
+  bool usesNativeCapture() const;
+  float frameRate() const;
+  static bool nativeCaptureEnabled();
+
+protected:
+  bool reconfigure() override;
+
+private:
+  struct Buffer {
+    void * start;
+    size_t length;
+  };
+  bool openDevice();
+  bool configureStreaming();
+  bool captureFirstFrame(const QElapsedTimer & timer);
+  void releaseHeldBuffer();
+  void releaseStreaming();
+  void dropQueuedFrames();
+  void closeDevice();
+  bool dequeueBuffer(int & index);
+  void requeueBuffer(int index);
+
+  int _fd;
+  QVector<Buffer> _buffers;
+  int _heldBuffer;
+  unsigned int _pixelFormat;
+  int _bytesPerLine;
+  float _frameRate;
+  qint64 _frameTimestamp; // us, 0 if not on the monotonic clock
+  quint64 _frameSequence;
+  static const int DefaultBufferCount = 4;
+  static const int MinimumBufferCount = 2; // One held as the source image, one filled by the driver
+  static const int DequeueTimeout = 2000; // ms
+};
+
+#endif // HAS_V4L2
+
+#endif // ZART_V4L2SOURCE_H
@@ -0,0 +1,141 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   VideoDecoder.h
+ * @date   Oct 2026
+ * @brief  Declaration of the class VideoDecoder
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+#ifndef ZART_VIDEODECODER_H
+#define ZART_VIDEODECODER_H
+
+#include <QMutex>
+#include <QQueue>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+#include <atomic>
+#include <thread>
+
+namespace cv
+{
+class Mat;
+class VideoCapture;
+} // namespace cv
+
+/**
+ * Decodes a video file ahead of its consumer, in its own thread, into a
+ * bounded queue of frames. Looping is done by seeking back to the first
+ * frame, or by switching to a second decoder opened in advance when the
+ * file cannot be seeked.
+ *
+ * In clock mode, frames are handed over when their timestamp is due:
+ * early frames are held, late ones are dropped, and frames the consumer
+ * cannot catch up with are not even decoded (grabbed only).
+ * On the first seek, the timestamp of every frame is indexed in the
+ * background (a second pass over the file), which makes seeking to a
+ * frame or a time exact.
+ */
+class VideoDecoder : public QThread {
+public:
+  struct Frame {
+    cv::Mat * image;
+    qint64 position; // Frame number in the file
+    double timestamp; // ms, keeps increasing when looping
+  };
+
+  VideoDecoder(const QString & filename, int readAhead, int threads);
+  ~VideoDecoder() override;
+  bool takeFrame(Frame & frame);
+  void skipFrames(int count);
+  void setLoop(bool on);
+  void setClockMode(bool on);
+  void pauseClock();
+  void seek(qint64 position);
+  qint64 positionAt(double timestamp);
+  qint64 frameCount();
+  void stop();
+
+protected:
+  void run() override;
+
+private:
+  cv::VideoCapture * openCapture() const;
+  bool nextFrame(Frame & frame, bool decode);
+  bool retrieveFrame(Frame & frame);
+  bool grabUntil(qint64 position);
+  bool seekTo(qint64 position, Frame & frame);
+  bool loopToStart();
+  double indexedTimestamp(qint64 position);
+  double mediaTime() const;
+  void startIndexing();
+  void buildIndex();
+  void clearFrames();
+
+  QString _filename;
+  int _readAhead;
+  int _threads;
+  cv::VideoCapture * _capture;
+  cv::VideoCapture * _spare;
+  bool _seekable;
+  double _framePeriod; // ms
+  double _timeOffset;  // ms, added to the timestamps of the frames read after looping
+  double _lastTimestamp;
+  QQueue<Frame> _frames;
+  QMutex _mutex;
+  QWaitCondition _frameTaken;
+  QWaitCondition _frameAvailable;
+  bool _continue;
+  bool _loop;
+  qint64 _seekPosition; // -1 if none
+  int _framesToSkip;
+  bool _endOfFile;
+  bool _clockMode;
+  bool _clockRunning;
+  qint64 _clockOrigin; // us (ImageSource::monotonicTime()) when media time was 0
+  qint64 _estimatedFrameCount;
+  QVector<double> _timestamps;
+  bool _indexed;
+  std::thread _indexer;
+  std::atomic<bool> _stopIndexing;
+};
+
+#endif // ZART_VIDEODECODER_H
@@ -51,22 +51,34 @@
 #include <opencv2/opencv.hpp>
 #include "ImageSource.h"
 
+class VideoDecoder;
+
 class VideoFileSource : public ImageSource {
 public:
   VideoFileSource();
   ~VideoFileSource() override;
   void capture() override;
+  void skipFrames(int count) override;
   bool loadVideoFile(QString filename);
   const QString & filename() const;
   const QString & filePath() const;
   void setLoop(bool);
+  void setClockMode(bool);
+  void pauseClock();
+  void seek(qint64 position);
+  void seekTime(double ms);
+  qint64 frameCount() const;
+  qint64 position() const;
+  static const int DefaultReadAhead = 8; // Frames
 
 private:
-  cv::VideoCapture * _capture;
+  VideoDecoder * _decoder;
   QString _filename;
   QString _filePath;
   bool _videoIsReadable;
   bool _loop;
+  bool _clockMode;
+  qint64 _position;
 };
 
 #endif // ZART_VIDEOFILESOURCE_H
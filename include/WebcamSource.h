@@ -49,47 +49,136 @@
 #define ZART_WEBCAMSOURCE_H
 
 #include <QList>
+#include <QMutex>
 #include <QSize>
 #include <QString>
+#include <QStringList>
 #include <QVector>
 #include <opencv2/opencv.hpp>
 #include "ImageSource.h"
 
-class QSplashScreen;
-class QStatusBar;
-
 class WebcamSource : public ImageSource {
 public:
+  struct CaptureMode {
+    unsigned int pixelFormat; // FourCC code, 0 if unknown
+    QSize size;
+    float fps;
+  };
+
+  enum Backend {
+    AnyBackend, // Let OpenCV choose
+    V4L2Backend,
+    GStreamerBackend,
+    FFmpegBackend
+  };
+
+  struct BackendProbe {
+    Backend backend;
+    bool ok;
+    float fps;
+    float latency; // ms, estimated from the frames queued by the driver
+  };
+
+  struct CameraInfo {
+    int index;        // As in /dev/videoN
+    QString identity; // Stable identifier, empty if the platform gives none (settings are then not kept)
+    bool available;   // Not used by another application
+    QList<QSize> resolutions;
+    QList<CaptureMode> modes;
+  };
+
   WebcamSource();
   ~WebcamSource() override;
   int cameraIndex();
+  QString cameraIdentity() const;
   void capture() override;
   void setCameraIndex(int i);
-  void stop();
-  void start();
+  virtual void stop();
+  virtual void start();
+  virtual bool isStarted() const;
   QSize captureSize();
   void setCaptureSize(int width, int height);
   void setCaptureSize(const QSize & size);
-  static const QList<int> & getWebcamList();
+  int timeToFirstFrame() const;
+  Backend captureBackend() const;
+  int captureBufferSize() const;
+  static QList<int> getWebcamList();
   static const QList<int> & getCachedWebcamList();
   static int getFirstUnusedWebcam();
   static bool isWebcamUnused(int index);
   static bool canOpenDeviceFile(int index);
-  static void retrieveWebcamResolutions(const QList<int> & camList, QSplashScreen * splashScreen = nullptr, QStatusBar * statusBar = nullptr);
-  static void retrieveWebcamResolutionsV4L2(const QList<int> & camList);
-  static void retrieveWebcamResolutionsOpenCV(const QList<int> & camList, QSplashScreen * splashScreen = nullptr, QStatusBar * statusBar = nullptr);
+  static bool isCameraOpen(const QString & identity); // By this process
+  static QList<CameraInfo> discoverCameras();
+  static void setCameras(const QList<CameraInfo> & cameras);
+  static bool camerasDiffer(const QList<CameraInfo> & cameras);
+  static QString webcamIdentity(int index);
+  static QString settingsKey(const QString & identity, const QString & name);
   static const QList<QSize> & webcamResolutions(int index);
+  static const QList<CaptureMode> & webcamCaptureModes(int index);
+  static CaptureMode bestCaptureMode(int index, const QSize & size, const QList<unsigned int> & pixelFormats = QList<unsigned int>());
+  static CaptureMode bestCaptureMode(const QList<CaptureMode> & modes, const QSize & size, const QList<unsigned int> & pixelFormats = QList<unsigned int>());
+  static QString pixelFormatName(unsigned int pixelFormat);
+  static QString backendName(Backend backend);
+  static Backend backendFromName(const QString & name);
+  static QList<Backend> probedBackends();
+  static Backend cameraBackend(const QString & identity);
+  static Backend chosenBackend(const QString & identity); // By the user, AnyBackend otherwise
+  static Backend recommendedBackend(const QString & identity);
+  // Measures the backends of the cameras not measured yet, one at a time (takes seconds)
+  static void recommendBackends(const QList<CameraInfo> & cameras);
+  // Interrupts the measurement of this camera (of any camera if empty), so that it can be opened
+  static void cancelBackendProbe(const QString & identity = QString());
+  // Once, from the main thread, before any capture
+  static void setCaptureEnvironment();
+  static int cameraBufferSize(const QString & identity);
+  static QList<BackendProbe> probeBackends(int index, const QSize & size, int bufferSize);
+  static Backend bestBackend(const QList<BackendProbe> & probes);
+  static void clearBackendProbes();
   static void clearSavedSettings();
   static QString osName();
 
+protected:
+  void setActualCaptureSize(const QSize & size);
+  bool takeCaptureSizeChange();
+  virtual bool reconfigure();
+  const QList<CaptureMode> & captureModes() const;
+  CaptureMode lastKnownGoodMode();
+  void saveLastKnownGoodMode(const CaptureMode & mode);
+  void setTimeToFirstFrame(int ms);
+  void setCameraOpen(bool open);
+
 private:
+  void applyCaptureMode();
+
   cv::VideoCapture * _capture;
   int _cameraIndex;
+  QString _cameraIdentity;
+  QString _openIdentity; // Of the camera this source keeps open
+  QList<CaptureMode> _captureModes;
   QSize _captureSize;
+  bool _captureSizeChanged;
+  mutable QMutex _captureSizeMutex;
+  int _timeToFirstFrame;
   static QList<int> _webcamList;
+  static QStringList _webcamIdentities;
+  static QList<bool> _webcamAvailability;
   static QVector<QList<QSize>> _webcamResolutions;
+  static QVector<QList<CaptureMode>> _webcamCaptureModes;
+  static QStringList _openCameras;
 
   static bool captureIsValid(const cv::VideoCapture & capture, int index);
+  static bool openCapture(cv::VideoCapture & capture, int index, Backend backend, const QSize & size, int bufferSize);
+  static BackendProbe probeBackend(int index, Backend backend, const QSize & size, int bufferSize);
+  static void recommendBackend(const CameraInfo & camera);
+  static const int ProbeWarmupFrames = 10;
+  static const int ProbeFrames = 30;
+  static const int ProbeLatencyTrials = 3;
+  static const int ProbeIdleTime = 500; // ms, long enough for the driver queue to fill up
+  static const qint64 MaximumCaptureAge = 5000000; // us, older backend timestamps are not on our clock
+  static const unsigned long ProbeCancelTimeout = 2000; // ms
+  static void probeCamera(CameraInfo & camera);
+  static void probeCameraV4L2(CameraInfo & camera);
+  static void probeCameraOpenCV(CameraInfo & camera);
 };
 
 #endif // ZART_WEBCAMSOURCE_H
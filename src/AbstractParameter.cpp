@@ -77,6 +77,16 @@ void AbstractParameter::addToKeypointList(KeypointList &) const {}
 
 void AbstractParameter::extractPositionFromKeypointList(KeypointList &) {}
 
+void AbstractParameter::startInteraction()
+{
+  emit interactionChanged(true);
+}
+
+void AbstractParameter::finishInteraction()
+{
+  emit interactionChanged(false);
+}
+
 AbstractParameter * AbstractParameter::createFromNode(QDomNode node, QObject * parent)
 {
   QString name = node.nodeName();
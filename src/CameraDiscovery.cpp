@@ -0,0 +1,133 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   CameraDiscovery.cpp
+ * @date   Oct 2026
+ * @brief  Definition of the class CameraDiscovery
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "CameraDiscovery.h"
+#include <QFileSystemWatcher>
+#include "Common.h"
+
+CameraDiscovery::CameraDiscovery(QObject * parent) : QThread(parent), _watcher(nullptr), _busy(false), _pending(false), _probing(false)
+{
+  _hotplugTimer.setSingleShot(true);
+  _hotplugTimer.setInterval(HotplugDelay);
+  connect(&_hotplugTimer, SIGNAL(timeout()), this, SLOT(discover()));
+  connect(this, SIGNAL(finished()), this, SLOT(onFinished()));
+}
+
+CameraDiscovery::~CameraDiscovery()
+{
+  WebcamSource::cancelBackendProbe();
+  wait();
+}
+
+const QList<WebcamSource::CameraInfo> & CameraDiscovery::cameras() const
+{
+  return _cameras;
+}
+
+bool CameraDiscovery::isBusy() const
+{
+  return _busy;
+}
+
+void CameraDiscovery::setHotplugEnabled(bool on)
+{
+#if defined(_IS_UNIX_)
+  if (on && !_watcher) {
+    _watcher = new QFileSystemWatcher(this);
+    _watcher->addPath("/dev");
+    connect(_watcher, SIGNAL(directoryChanged(QString)), &_hotplugTimer, SLOT(start()));
+  } else if (!on && _watcher) {
+    delete _watcher;
+    _watcher = nullptr;
+  }
+#else
+  Q_UNUSED(on)
+#endif
+}
+
+void CameraDiscovery::discover()
+{
+  // Results are read in onFinished(), a new run cannot start before
+  if (_busy) {
+    _pending = true;
+    return;
+  }
+  _busy = true;
+  start();
+}
+
+void CameraDiscovery::run()
+{
+  if (_probing) {
+    WebcamSource::recommendBackends(_cameras);
+  } else {
+    _cameras = WebcamSource::discoverCameras();
+  }
+}
+
+void CameraDiscovery::onFinished()
+{
+  // finished() is emitted just before the thread ends
+  wait();
+  const bool discovered = !_probing;
+  if (_pending) {
+    // Detected again first, measured afterwards
+    _pending = false;
+    _probing = false;
+    start();
+  } else if (discovered) {
+    // Before the cameras are opened, see isBusy()
+    _probing = true;
+    start();
+  } else {
+    _probing = false;
+    _busy = false;
+  }
+  if (discovered) {
+    emit camerasDiscovered();
+  }
+  if (!_busy) {
+    emit backendsProbed();
+  }
+}
@@ -51,7 +51,7 @@
 #include "Common.h"
 #include "PointParameter.h"
 
-CommandParamsWidget::CommandParamsWidget(QWidget * parent) : QWidget(parent), _valueString(""), _pbReset(0), _labelNoParams(0)
+CommandParamsWidget::CommandParamsWidget(QWidget * parent) : QWidget(parent), _valueString(""), _valueStringIsValid(true), _pbReset(0), _labelNoParams(0)
 {
   delete layout();
   QGridLayout * grid = new QGridLayout;
@@ -82,6 +82,7 @@ void CommandParamsWidget::build(QDomNode presetNode)
         parameter->addTo(this, row++);
       }
       connect(parameter, SIGNAL(valueChanged()), this, SLOT(updateValueString()));
+      connect(parameter, SIGNAL(interactionChanged(bool)), this, SIGNAL(interactionChanged(bool)));
     }
     child = child.nextSibling();
   }
@@ -115,6 +116,21 @@ CommandParamsWidget::~CommandParamsWidget()
 
 const QString & CommandParamsWidget::valueString() const
 {
+  if (!_valueStringIsValid) {
+    _valueString.clear();
+    bool firstParameter = true;
+    for (int i = 0; i < _presetParameters.size(); ++i) {
+      QString str = _presetParameters[i]->textValue();
+      if (!str.isNull()) {
+        if (!firstParameter) {
+          _valueString += ",";
+        }
+        _valueString += str;
+        firstParameter = false;
+      }
+    }
+    _valueStringIsValid = true;
+  }
   return _valueString;
 }
 
@@ -152,18 +168,8 @@ bool CommandParamsWidget::hasKeypoints() const
 
 void CommandParamsWidget::updateValueString(bool notify)
 {
-  _valueString.clear();
-  bool firstParameter = true;
-  for (int i = 0; i < _presetParameters.size(); ++i) {
-    QString str = _presetParameters[i]->textValue();
-    if (!str.isNull()) {
-      if (!firstParameter) {
-        _valueString += ",";
-      }
-      _valueString += str;
-      firstParameter = false;
-    }
-  }
+  // The string itself is rebuilt on demand, by valueString()
+  _valueStringIsValid = false;
   if (notify)
     emit valueChanged();
 }
@@ -53,16 +53,18 @@
 #include <QMutex>
 #include <QPainter>
 #include <QSemaphore>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include "ImageConverter.h"
+#include "RenderCache.h"
+#include "Tracing.h"
 #include "WebcamSource.h"
 using namespace cimg_library;
 
-FilterThread::FilterThread(ImageSource & imageSource, const QString & command, QImage * outputImageA, QMutex * imageMutexA, QImage * outputImageB, QMutex * imageMutexB, PreviewMode previewMode,
-                           int frameSkip, int fps, QSemaphore * blockingSemaphore)
-    : _imageSource(imageSource), _arguments(new QString("")), _viewSize(new QSize), _commandUpdated(true), _outputImageA(outputImageA), _imageMutexA(imageMutexA), _outputImageB(outputImageB),
-      _imageMutexB(imageMutexB), _blockingSemaphore(blockingSemaphore), _previewMode(previewMode), _frameSkip(frameSkip), _continue(true), _xMouse(-1), _yMouse(-1), _buttonsMouse(0), _gmic_images(),
-      _gmic(0)
+FilterThread::FilterThread(ImageSource & imageSource, const QString & command, FrameBus & frameBus, PreviewMode previewMode, int frameSkip, int fps, QSemaphore * blockingSemaphore)
+    : _imageSource(imageSource), _arguments(new QString("")), _viewSize(new QSize), _commandUpdated(true), _frameBus(frameBus), _blockingSemaphore(blockingSemaphore), _previewMode(previewMode), _frameSkip(frameSkip), _continue(true), _xMouse(-1), _yMouse(-1), _buttonsMouse(0), _gmic_images(),
+      _gmic(0), _renderCache(nullptr), _timings(nullptr), _lastGmicError(new QString), _outputThrottle(new FrameBus::SubscriptionPtr), _lastSequence(0), _filterTime(0), _outputTime(0), _progressiveRendering(false), _refining(false), _abortRendering(false), _statefulCommand(false), _interactive(false), _interactionScale(0.5f), _lumaOnly(false)
 {
   setCommand(command);
   setFPS(fps);
@@ -86,10 +88,38 @@ void FilterThread::setMousePosition(int x, int y, int buttons)
 void FilterThread::setArguments(const QString & str)
 {
   _arguments.lock();
+  if (_refining && _arguments.object() != str) {
+    _abortRendering = true;
+  }
   _arguments.object() = str;
   _arguments.unlock();
 }
 
+void FilterThread::setProgressiveRendering(bool on)
+{
+  _progressiveRendering = on;
+}
+
+void FilterThread::setInteractive(bool on)
+{
+  _interactive = on;
+}
+
+bool FilterThread::isInteractive() const
+{
+  return _interactive;
+}
+
+void FilterThread::setInteractionScale(float scale)
+{
+  _interactionScale = std::max(0.05f, std::min(1.0f, scale));
+}
+
+void FilterThread::setLumaOnly(bool on)
+{
+  _lumaOnly = on;
+}
+
 void FilterThread::setPreviewMode(PreviewMode pm)
 {
   _previewMode = pm;
@@ -100,6 +130,11 @@ void FilterThread::setFrameSkip(int n)
   _frameSkip = n;
 }
 
+int FilterThread::frameSkip() const
+{
+  return _frameSkip;
+}
+
 void FilterThread::setFPS(int fps)
 {
   _fps = fps;
@@ -112,10 +147,55 @@ void FilterThread::setFPS(int fps)
 void FilterThread::stop()
 {
   _continue = false;
+  _arguments.lock();
+  if (_refining) {
+    _abortRendering = true;
+  }
+  _arguments.unlock();
   _fps = 1;
   _frameInterval = 0;
 }
 
+void FilterThread::setRenderCache(RenderCache * cache)
+{
+  _renderCache = cache;
+}
+
+void FilterThread::setFrameTimings(FrameTimings * timings)
+{
+  _timings = timings;
+}
+
+void FilterThread::setOutputThrottle(const FrameBus::SubscriptionPtr & subscription)
+{
+  _outputThrottle.lock();
+  _outputThrottle.object() = subscription;
+  _outputThrottle.unlock();
+}
+
+int FilterThread::capturedFrames() const
+{
+  return _capturedFrames.loadAcquire();
+}
+
+int FilterThread::droppedFrames() const
+{
+  return _droppedFrames.loadAcquire();
+}
+
+int FilterThread::gmicErrors() const
+{
+  return _gmicErrors.loadAcquire();
+}
+
+QString FilterThread::lastGmicError()
+{
+  _lastGmicError.lock();
+  const QString error = _lastGmicError.object();
+  _lastGmicError.unlock();
+  return error;
+}
+
 void FilterThread::setViewSize(const QSize & size)
 {
   _viewSize.lock();
@@ -128,135 +208,113 @@ void FilterThread::run()
   QElapsedTimer timeMeasure;
   unsigned int lastCommandDuration = 0;
   timeMeasure.start();
-  int n;
   while (_continue) {
     // Delay (minus last command duration)
     if (_frameInterval && lastCommandDuration < _frameInterval) {
+      Tracing::Span span("frame interval", "wait");
       msleep(_frameInterval - lastCommandDuration);
     }
     // Skip some frames and grab an image from the webcam
-    n = _frameSkip + 1;
-    while (n--) {
+    const qint64 captureStart = ImageSource::monotonicTime();
+    {
+      Tracing::Span span("capture");
+      _imageSource.skipFrames(_frameSkip);
       _imageSource.capture();
     }
     // Abort if no image is provided by the source
-    if (!_imageSource.image()) {
+    if (!_imageSource.hasImage()) {
       emit endOfCapture();
       return;
     }
+    recordTiming(FrameTimings::Capture, captureStart);
+    // Gaps in the sequence numbers are frames lost by the source, or too late to be read
+    const quint64 sequence = _imageSource.frameInfo().sequence;
+    if (_capturedFrames.loadAcquire() && sequence > _lastSequence + 1 + _frameSkip) {
+      _droppedFrames.fetchAndAddRelaxed(static_cast<int>(sequence - _lastSequence - 1 - _frameSkip));
+    }
+    _lastSequence = sequence;
+    _capturedFrames.fetchAndAddRelaxed(1);
+    _filterTime = _outputTime = 0;
+    publishInput();
     if (!_gmic_images)
       _gmic_images.assign(1);
-    if (!_gmic_images[0].is_sameXYZC(_imageSource.width(), _imageSource.height(), 1, 3))
-      _gmic_images[0].assign(_imageSource.width(), _imageSource.height(), 1, 3);
+    if (!_gmic_images[0].is_sameXYZC(_imageSource.width(), _imageSource.height(), 1, _lumaOnly ? 1 : 3))
+      _gmic_images[0].assign(_imageSource.width(), _imageSource.height(), 1, _lumaOnly ? 1 : 3);
 
     if (_noFilter) {
-      ImageConverter::convert(_imageSource.image(), _outputImageA);
-      ImageConverter::convert(_imageSource.image(), _outputImageB);
+      const qint64 outputStart = ImageSource::monotonicTime();
+      Tracing::Span span("present");
+      QImage image = _frameBus.allocateImage(_imageSource.size());
+      ImageConverter::convert(_imageSource.image(), &image);
+      recordTiming(FrameTimings::ConvertOut, outputStart);
+      publishOutput(image);
     } else {
+      _arguments.lock();
+      const QString arguments = _arguments.object();
+      _arguments.unlock();
+      _viewSize.lock();
+      const QSize viewSize = _viewSize.object();
+      _viewSize.unlock();
 
-      ImageConverter::convert(_imageSource.image(), _gmic_images[0]);
-
-      // Call the G'MIC interpreter.
+      // Call the G'MIC interpreter, unless the result is already in the cache.
       try {
         timeMeasure.restart();
-
-        if (_commandUpdated) {
-          delete _gmic;
-          QString c = QString("zart: -skip $\"*\" ") + _command;
-          _gmic = new gmic("", c.toLocal8Bit().constData(), true, 0, 0, 0.0f);
-          _commandUpdated = false;
-        }
-
-        QString c("v -");
-        c += QString(" _x=%1").arg(_xMouse);
-        c += QString(" _y=%1").arg(_yMouse);
-        c += QString(" _b=%1").arg(_buttonsMouse);
-        c += QString(" _host=zart _input_layers=1 _output_mode=0 _output_messages=0 _preview_mode=0 _preview_timeout=16");
-        _viewSize.lock();
-        c += QString(" _preview_width=%1 _preview_height=%2").arg(_viewSize.object().width()).arg(_viewSize.object().height());
-        _viewSize.unlock();
-        QString call;
-        _arguments.lock();
-        if (_arguments.object().isEmpty()) {
-          call = QString(" -zart 0");
-        } else {
-          call = QString(" -zart %1").arg(_arguments.object());
-        }
-        _arguments.unlock();
-        c += call;
-
-        _gmic->run(c.toLocal8Bit().constData(), _gmic_images, _gmic_images_names);
-        lastCommandDuration = timeMeasure.elapsed();
-
-        switch (_previewMode) {
-        case Full:
-          if (_gmic_images && _gmic_images[0]) {
-            QSize size(_gmic_images[0].width(), _gmic_images[0].height());
-            _imageMutexA->lock();
-            if (_outputImageA->size() != size) {
-              *_outputImageA = QImage(size, QImage::Format_RGB888);
-            }
-            _imageMutexA->unlock();
-            ImageConverter::convert(_gmic_images[0], _outputImageA);
-            if (_outputImageB) {
-              _imageMutexB->lock();
-              if (_outputImageB->size() != size) {
-                *_outputImageB = QImage(size, QImage::Format_RGB888);
-              }
-              _imageMutexB->unlock();
-              ImageConverter::convert(_gmic_images[0], _outputImageB);
-            }
+        const QString cacheKey = _renderCache ? renderCacheKey(arguments, viewSize) : QString();
+        if (!_renderCache || (_gmic_images.size() != 1) || !_renderCache->get(cacheKey, _gmic_images[0])) {
+          const qint64 convertStart = ImageSource::monotonicTime();
+          {
+            Tracing::Span span("convert in");
+            ImageConverter::convert(_imageSource, _gmic_images[0], _lumaOnly);
           }
-          break;
-        case Original: {
-          _imageMutexA->lock();
-          QSize size(_imageSource.width(), _imageSource.height());
-          if (_outputImageA->size() != size) {
-            *_outputImageA = QImage(size, QImage::Format_RGB888);
+          if (!_imageSource.isFrameIntact()) {
+            continue; // Overwritten by its producer while being read, take the next one
           }
-          _imageMutexA->unlock();
-          if (_outputImageB) {
-            if (_outputImageB->size() != size) {
-              *_outputImageB = QImage(size, QImage::Format_RGB888);
+          recordTiming(FrameTimings::ConvertIn, convertStart);
+          const float interactionScale = _interactive ? effectiveInteractionScale() : 1.0f;
+          if (interactionScale < 1.0f) {
+            // Parameters are being dragged: render quickly at a reduced scale
+            _gmic_images[0].move_to(_fullResolutionInput);
+            runScaledCommand(arguments, viewSize, interactionScale);
+            _fullResolutionInput.assign();
+          } else {
+            if (!renderProgressively(arguments, viewSize)) {
+              // Parameters have changed while refining: start over with the new ones
+              dropPendingRenderRequests();
+              continue;
             }
-            _imageMutexB->unlock();
+            runCommand(arguments, viewSize);
           }
-          ImageConverter::convert(_imageSource.image(), _outputImageA);
-          ImageConverter::convert(_imageSource.image(), _outputImageB);
-        } break;
-        case LeftHalf:
-          ImageConverter::merge(_imageSource.image(), _gmic_images[0], _outputImageA, _imageMutexA, ImageConverter::MergeLeft);
-          ImageConverter::merge(_imageSource.image(), _gmic_images[0], _outputImageB, _imageMutexB, ImageConverter::MergeLeft);
-          break;
-        case TopHalf:
-          ImageConverter::merge(_imageSource.image(), _gmic_images[0], _outputImageA, _imageMutexA, ImageConverter::MergeTop);
-          ImageConverter::merge(_imageSource.image(), _gmic_images[0], _outputImageB, _imageMutexB, ImageConverter::MergeTop);
-          break;
-        case BottomHalf:
-          ImageConverter::merge(_imageSource.image(), _gmic_images[0], _outputImageA, _imageMutexA, ImageConverter::MergeBottom);
-          ImageConverter::merge(_imageSource.image(), _gmic_images[0], _outputImageB, _imageMutexB, ImageConverter::MergeBottom);
-          break;
-        case RightHalf:
-          ImageConverter::merge(_imageSource.image(), _gmic_images[0], _outputImageA, _imageMutexB, ImageConverter::MergeRight);
-          ImageConverter::merge(_imageSource.image(), _gmic_images[0], _outputImageB, _imageMutexB, ImageConverter::MergeRight);
-          break;
-        case DuplicateHorizontal:
-          ImageConverter::merge(_imageSource.image(), _gmic_images[0], _outputImageA, _imageMutexA, ImageConverter::DuplicateHorizontal);
-          ImageConverter::merge(_imageSource.image(), _gmic_images[0], _outputImageB, _imageMutexB, ImageConverter::DuplicateHorizontal);
-          break;
-        case DuplicateVertical:
-          ImageConverter::merge(_imageSource.image(), _gmic_images[0], _outputImageA, _imageMutexA, ImageConverter::DuplicateVertical);
-          ImageConverter::merge(_imageSource.image(), _gmic_images[0], _outputImageB, _imageMutexB, ImageConverter::DuplicateVertical);
-          break;
-        default:
-          _outputImageA->fill(QColor(255, 255, 255).rgb());
-          if (_outputImageB) {
-            _outputImageB->fill(QColor(255, 255, 255).rgb());
+          if (takeAbortRequest()) {
+            dropPendingRenderRequests();
+            continue;
+          }
+          // Presets leaving more than one image keep a state between runs: their output is not cached.
+          if (_gmic_images.size() != 1) {
+            _statefulCommand = true;
+          } else if (_renderCache && interactionScale == 1.0f) {
+            _renderCache->insert(cacheKey, _gmic_images[0]);
           }
-          break;
         }
-
+        lastCommandDuration = timeMeasure.elapsed();
+        presentOutput();
+        // Progressive renderings add up, as all of them are needed for this frame
+        if (_timings && _filterTime) {
+          _timings->record(FrameTimings::Filter, _filterTime);
+        }
+        if (_timings && _outputTime) {
+          _timings->record(FrameTimings::ConvertOut, _outputTime);
+        }
       } catch (gmic_exception & e) {
+        if (takeAbortRequest()) {
+          _refining = false;
+          _fullResolutionInput.assign();
+          dropPendingRenderRequests();
+          continue;
+        }
+        _gmicErrors.fetchAndAddRelaxed(1);
+        _lastGmicError.lock();
+        _lastGmicError.object() = QString::fromLocal8Bit(e.what());
+        _lastGmicError.unlock();
         CImg<unsigned char> src(reinterpret_cast<unsigned char *>(_imageSource.image()->ptr()), 3, _imageSource.width(), _imageSource.height(), 1, true);
         _gmic_images = src.get_permute_axes("yzcx");
         QString errorCommand = QString("-gimp_error_preview \"%1\"").arg(e.what());
@@ -268,24 +326,18 @@ void FilterThread::run()
           _gmic_images = src.get_permute_axes("yzcx").channel(0).resize(-100, -100, 1, 3).draw_text(10, 10, "Syntax Error", color1, color2, 0.5, 57);
         }
         std::cerr << e.what() << std::endl;
-        QSize size(_imageSource.image()->cols, _imageSource.image()->rows);
-        if (_outputImageA->size() != size) {
-          _imageMutexA->lock();
-          *_outputImageA = QImage(size, QImage::Format_RGB888);
-          _imageMutexA->unlock();
-        }
-        if (_outputImageB && _outputImageB->size() != size) {
-          _imageMutexB->lock();
-          *_outputImageB = QImage(size, QImage::Format_RGB888);
-          _imageMutexB->unlock();
-        }
-        ImageConverter::convert(_gmic_images[0], _outputImageA);
-        ImageConverter::convert(_gmic_images[0], _outputImageB);
+        QImage image = _frameBus.allocateImage(QSize(_gmic_images[0].width(), _gmic_images[0].height()));
+        ImageConverter::convert(_gmic_images[0], &image);
+        publishOutput(image);
       }
     }
     emit imageAvailable();
+    waitForOutputRoom();
     if (!_fps && _blockingSemaphore) {
-      _blockingSemaphore->acquire(_blockingSemaphore->available() + 1);
+      // Wait for a render request; one received while rendering is honored at once.
+      Tracing::Span span("render request", "wait");
+      _blockingSemaphore->acquire();
+      dropPendingRenderRequests();
     }
   }
 }
@@ -294,6 +346,37 @@ void FilterThread::run()
  * Private methods
  */
 
+void FilterThread::waitForOutputRoom()
+{
+  _outputThrottle.lock();
+  const FrameBus::SubscriptionPtr subscription = _outputThrottle.object();
+  _outputThrottle.unlock();
+  if (!subscription) {
+    return;
+  }
+  Tracing::Span span("output room", "wait");
+  // Wakes up regularly, so that stop() is not delayed by a stalled consumer
+  while (_continue && !subscription->waitForRoom(100) && !subscription->isClosed()) {
+  }
+}
+
+bool FilterThread::abortRequested()
+{
+  _arguments.lock();
+  const bool abort = _abortRendering;
+  _arguments.unlock();
+  return abort;
+}
+
+bool FilterThread::takeAbortRequest()
+{
+  _arguments.lock();
+  const bool abort = _abortRendering;
+  _abortRendering = false;
+  _arguments.unlock();
+  return abort;
+}
+
 void FilterThread::setCommand(const QString & command)
 {
   if (command == "_none_") {
@@ -305,5 +388,232 @@ void FilterThread::setCommand(const QString & command)
     _command = str.constData();
     _command.replace("{*,x}", "$_x").replace("{*,y}", "$_y").replace("{*,b}", "$_b");
   }
+  _commandUsesMouse = _command.contains("$_x") || _command.contains("$_y") || _command.contains("$_b");
   _commandUpdated = true;
 }
+
+bool FilterThread::renderProgressively(const QString & arguments, const QSize & viewSize)
+{
+  const QVector<float> scales = progressiveScales();
+  if (scales.isEmpty()) {
+    return true;
+  }
+  _gmic_images[0].move_to(_fullResolutionInput);
+  for (int level = 0; level < scales.size(); ++level) {
+    const float scale = scales[level];
+    if (level && renderRequestChanged(arguments)) {
+      _fullResolutionInput.assign();
+      return false;
+    }
+    _refining = (level > 0);
+    runScaledCommand(arguments, viewSize, scale);
+    if (takeAbortRequest()) {
+      _fullResolutionInput.assign();
+      return false;
+    }
+    if (_gmic_images.size() != 1) {
+      // This preset keeps a state between runs, which only makes sense at full resolution:
+      // neither this scaled output nor the other levels are presented.
+      _statefulCommand = true;
+      break;
+    }
+    if (_gmic_images && _gmic_images[0]) {
+      presentOutput();
+      emit imageAvailable();
+    }
+  }
+  if (renderRequestChanged(arguments)) {
+    _fullResolutionInput.assign();
+    return false;
+  }
+  _gmic_images.assign(1);
+  _fullResolutionInput.move_to(_gmic_images[0]);
+  _refining = true;
+  return true;
+}
+
+void FilterThread::runScaledCommand(const QString & arguments, const QSize & viewSize, float scale)
+{
+  // Process a downscaled copy of _fullResolutionInput, then upscale the result
+  const int scaledWidth = std::max(1, static_cast<int>(_fullResolutionInput.width() * scale));
+  const int scaledHeight = std::max(1, static_cast<int>(_fullResolutionInput.height() * scale));
+  _gmic_images.assign(1);
+  _gmic_images[0] = _fullResolutionInput.get_resize(scaledWidth, scaledHeight, 1, -100, 2);
+  runCommand(arguments, viewSize, scale);
+  if (!abortRequested() && _gmic_images && _gmic_images[0]) {
+    CImg<float> & output = _gmic_images[0];
+    if (output.width() == scaledWidth && output.height() == scaledHeight) {
+      // Exactly the size of the full resolution output, whatever the rounding of the scaled one
+      output.resize(_fullResolutionInput.width(), _fullResolutionInput.height(), -100, -100, 3);
+    } else {
+      // The preset changed the size
+      output.resize(static_cast<int>(std::round(output.width() / scale)), static_cast<int>(std::round(output.height() / scale)), -100, -100, 3);
+    }
+  }
+}
+
+float FilterThread::effectiveInteractionScale() const
+{
+  if (_statefulCommand) {
+    return 1.0f;
+  }
+  const int size = std::max(_gmic_images[0].width(), _gmic_images[0].height());
+  if (size <= 0) {
+    return 1.0f;
+  }
+  return std::min(_interactionScale, InteractionMaximumSize / static_cast<float>(size));
+}
+
+QVector<float> FilterThread::progressiveScales() const
+{
+  // Coarser levels are 4 times smaller than the next one, down to about
+  // ProgressiveMinimumSize pixels for the largest dimension.
+  QVector<float> scales;
+  const int size = std::max(_gmic_images[0].width(), _gmic_images[0].height());
+  if (!_progressiveRendering || _statefulCommand || (size <= 2 * ProgressiveMinimumSize)) {
+    return scales;
+  }
+  float scale = 0.25f;
+  while (size * scale >= ProgressiveMinimumSize / 4) {
+    scales.push_front(scale);
+    if (size * scale <= ProgressiveMinimumSize) {
+      break;
+    }
+    scale *= 0.25f;
+  }
+  return scales;
+}
+
+void FilterThread::dropPendingRenderRequests()
+{
+  // The next iteration renders with the latest parameters anyway
+  if (_blockingSemaphore) {
+    _blockingSemaphore->tryAcquire(_blockingSemaphore->available());
+  }
+}
+
+bool FilterThread::renderRequestChanged(const QString & arguments)
+{
+  if (_blockingSemaphore && !_fps && _blockingSemaphore->available()) {
+    return true;
+  }
+  _arguments.lock();
+  const bool changed = (_arguments.object() != arguments);
+  _arguments.unlock();
+  return changed;
+}
+
+void FilterThread::runCommand(const QString & arguments, const QSize & viewSize, float scale)
+{
+  if (_commandUpdated) {
+    Tracing::Span span("preset compile");
+    delete _gmic;
+    QString c = QString("zart: -skip $\"*\" ") + _command;
+    _gmic = new gmic("", c.toLocal8Bit().constData(), true, 0, 0, 0.0f);
+    _commandUpdated = false;
+  }
+
+  QString c("v -");
+  c += QString(" _x=%1").arg(static_cast<int>(_xMouse * scale));
+  c += QString(" _y=%1").arg(static_cast<int>(_yMouse * scale));
+  c += QString(" _b=%1").arg(_buttonsMouse);
+  c += QString(" _host=zart _input_layers=1 _output_mode=0 _output_messages=0 _preview_mode=0 _preview_timeout=16");
+  c += QString(" _preview_width=%1 _preview_height=%2").arg(viewSize.width()).arg(viewSize.height());
+  if (arguments.isEmpty()) {
+    c += QString(" -zart 0");
+  } else {
+    c += QString(" -zart %1").arg(arguments);
+  }
+  const qint64 start = ImageSource::monotonicTime();
+  Tracing::Span span("G'MIC");
+  _gmic->run(c.toLocal8Bit().constData(), _gmic_images, _gmic_images_names, nullptr, &_abortRendering);
+  _filterTime += ImageSource::monotonicTime() - start;
+  _refining = false;
+}
+
+void FilterThread::presentOutput()
+{
+  // One image for all the consumers of the bus
+  Tracing::Span span("present");
+  const qint64 start = ImageSource::monotonicTime();
+  QImage image;
+  switch (_previewMode) {
+  case Full:
+    if (!_gmic_images || !_gmic_images[0]) {
+      return;
+    }
+    image = _frameBus.allocateImage(QSize(_gmic_images[0].width(), _gmic_images[0].height()));
+    ImageConverter::convert(_gmic_images[0], &image);
+    break;
+  case Original:
+    image = _frameBus.allocateImage(_imageSource.size());
+    ImageConverter::convert(_imageSource.image(), &image);
+    break;
+  case LeftHalf:
+    image = _frameBus.allocateImage(QSize(_gmic_images[0].width(), _gmic_images[0].height()));
+    ImageConverter::merge(_imageSource.image(), _gmic_images[0], &image, ImageConverter::MergeLeft);
+    break;
+  case TopHalf:
+    image = _frameBus.allocateImage(QSize(_gmic_images[0].width(), _gmic_images[0].height()));
+    ImageConverter::merge(_imageSource.image(), _gmic_images[0], &image, ImageConverter::MergeTop);
+    break;
+  case BottomHalf:
+    image = _frameBus.allocateImage(QSize(_gmic_images[0].width(), _gmic_images[0].height()));
+    ImageConverter::merge(_imageSource.image(), _gmic_images[0], &image, ImageConverter::MergeBottom);
+    break;
+  case RightHalf:
+    image = _frameBus.allocateImage(QSize(_gmic_images[0].width(), _gmic_images[0].height()));
+    ImageConverter::merge(_imageSource.image(), _gmic_images[0], &image, ImageConverter::MergeRight);
+    break;
+  case DuplicateHorizontal:
+    image = _frameBus.allocateImage(QSize(_gmic_images[0].width(), _gmic_images[0].height()));
+    ImageConverter::merge(_imageSource.image(), _gmic_images[0], &image, ImageConverter::DuplicateHorizontal);
+    break;
+  case DuplicateVertical:
+    image = _frameBus.allocateImage(QSize(_gmic_images[0].width(), _gmic_images[0].height()));
+    ImageConverter::merge(_imageSource.image(), _gmic_images[0], &image, ImageConverter::DuplicateVertical);
+    break;
+  default:
+    image = _frameBus.allocateImage(_imageSource.size());
+    image.fill(QColor(255, 255, 255).rgb());
+    break;
+  }
+  _outputTime += ImageSource::monotonicTime() - start;
+  publishOutput(image);
+}
+
+void FilterThread::publishInput()
+{
+  // Converted only if someone wants it
+  if (!_frameBus.hasSubscribers(FrameBus::Input)) {
+    return;
+  }
+  QImage image = _frameBus.allocateImage(_imageSource.size());
+  ImageConverter::convert(_imageSource.image(), &image);
+  _frameBus.publish(FrameBus::Input, image, _imageSource.frameInfo());
+}
+
+void FilterThread::publishOutput(const QImage & image)
+{
+  // The source is only captured by this thread, its metadata is the one of the frame just rendered
+  _frameBus.publish(FrameBus::Output, image, _imageSource.frameInfo());
+}
+
+void FilterThread::recordTiming(FrameTimings::Stage stage, qint64 start)
+{
+  if (_timings) {
+    _timings->record(stage, ImageSource::monotonicTime() - start);
+  }
+}
+
+QString FilterThread::renderCacheKey(const QString & arguments, const QSize & viewSize) const
+{
+  QString key = QString("%1\n%2\n%3x%4\n%5").arg(_command).arg(arguments).arg(viewSize.width()).arg(viewSize.height()).arg(_imageSource.generation());
+  if (_lumaOnly) {
+    key += "\nluma";
+  }
+  if (_commandUsesMouse) {
+    key += QString("\n%1,%2,%3").arg(_xMouse).arg(_yMouse).arg(_buttonsMouse);
+  }
+  return key;
+}
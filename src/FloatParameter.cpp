@@ -93,6 +93,8 @@ void FloatParameter::addTo(QWidget * widget, int row)
   grid->addWidget(_slider, row, 1, 1, 1);
   grid->addWidget(_spinBox, row, 2, 1, 1);
   connect(_slider, SIGNAL(valueChanged(int)), this, SLOT(onSliderChanged(int)));
+  connect(_slider, SIGNAL(sliderPressed()), this, SLOT(startInteraction()));
+  connect(_slider, SIGNAL(sliderReleased()), this, SLOT(finishInteraction()));
   connect(_spinBox, SIGNAL(valueChanged(double)), this, SLOT(onSpinBoxChanged(double)));
 }
 
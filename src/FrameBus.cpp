@@ -0,0 +1,331 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   FrameBus.cpp
+ * @date   Oct 2026
+ * @brief  Implementation of the class FrameBus
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "FrameBus.h"
+#include <QMutexLocker>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "Common.h"
+
+/*
+ * Pixel buffers of the published images, handed back by the last image
+ * using them (see allocateImage()). The pool outlives the bus if images
+ * are still referenced when it is destroyed.
+ */
+class FrameBufferPool {
+public:
+  ~FrameBufferPool()
+  {
+    for (const auto & buffer : _free) {
+      delete[] buffer.second;
+    }
+  }
+
+  uchar * take(size_t size)
+  {
+    QMutexLocker locker(&_mutex);
+    for (auto it = _free.begin(); it != _free.end(); ++it) {
+      if (it->first == size) {
+        uchar * data = it->second;
+        _free.erase(it);
+        return data;
+      }
+    }
+    locker.unlock();
+    return new uchar[size];
+  }
+
+  void recycle(uchar * data, size_t size)
+  {
+    QMutexLocker locker(&_mutex);
+    if (_free.size() >= FrameBus::PoolSize) {
+      // The oldest goes first, it may have the size of a previous resolution
+      delete[] _free.front().second;
+      _free.erase(_free.begin());
+    }
+    _free.push_back(std::make_pair(size, data));
+  }
+
+private:
+  QMutex _mutex;
+  std::vector<std::pair<size_t, uchar *>> _free;
+};
+
+namespace
+{
+struct PooledBuffer {
+  std::shared_ptr<FrameBufferPool> pool;
+  uchar * data;
+  size_t size;
+};
+
+void releasePooledBuffer(void * info)
+{
+  PooledBuffer * buffer = static_cast<PooledBuffer *>(info);
+  buffer->pool->recycle(buffer->data, buffer->size);
+  delete buffer;
+}
+} // namespace
+
+FrameBus::Subscription::Subscription(int channels, int depth, DropPolicy policy)
+    : _channels(channels), _depth(std::max(1, depth)), _policy(policy), _closed(false), _received(0), _dropped(0)
+{
+}
+
+FrameBus::FramePtr FrameBus::Subscription::take(unsigned long timeoutMs)
+{
+  QMutexLocker locker(&_mutex);
+  while (_frames.isEmpty() && !_closed) {
+    if (!_frameQueued.wait(&_mutex, timeoutMs)) {
+      break;
+    }
+  }
+  if (_frames.isEmpty()) {
+    return FramePtr();
+  }
+  FramePtr frame = _frames.dequeue();
+  _frameTaken.wakeAll();
+  return frame;
+}
+
+FrameBus::FramePtr FrameBus::Subscription::takeLatest()
+{
+  QMutexLocker locker(&_mutex);
+  if (_frames.isEmpty()) {
+    return FramePtr();
+  }
+  FramePtr frame = _frames.last();
+  _dropped += _frames.size() - 1;
+  _frames.clear();
+  _frameTaken.wakeAll();
+  return frame;
+}
+
+bool FrameBus::Subscription::waitForRoom(unsigned long timeoutMs)
+{
+  QMutexLocker locker(&_mutex);
+  while (_frames.size() >= _depth && !_closed) {
+    if (!_frameTaken.wait(&_mutex, timeoutMs)) {
+      return false;
+    }
+  }
+  return !_closed;
+}
+
+void FrameBus::Subscription::close()
+{
+  QMutexLocker locker(&_mutex);
+  _closed = true;
+  _frameQueued.wakeAll();
+  _frameTaken.wakeAll();
+}
+
+bool FrameBus::Subscription::isClosed()
+{
+  QMutexLocker locker(&_mutex);
+  return _closed;
+}
+
+void FrameBus::Subscription::clear()
+{
+  QMutexLocker locker(&_mutex);
+  _frames.clear();
+  _frameTaken.wakeAll();
+}
+
+int FrameBus::Subscription::channels() const
+{
+  return _channels;
+}
+
+int FrameBus::Subscription::depth() const
+{
+  return _depth;
+}
+
+int FrameBus::Subscription::pending()
+{
+  QMutexLocker locker(&_mutex);
+  return _frames.size();
+}
+
+quint64 FrameBus::Subscription::received()
+{
+  QMutexLocker locker(&_mutex);
+  return _received;
+}
+
+quint64 FrameBus::Subscription::dropped()
+{
+  QMutexLocker locker(&_mutex);
+  return _dropped;
+}
+
+void FrameBus::Subscription::offer(const FramePtr & frame)
+{
+  QMutexLocker locker(&_mutex);
+  if (_closed) {
+    return;
+  }
+  ++_received;
+  if (_frames.size() >= _depth) {
+    ++_dropped;
+    if (_policy == DropNewest) {
+      return;
+    }
+    _frames.dequeue();
+  }
+  _frames.enqueue(frame);
+  _frameQueued.wakeAll();
+}
+
+FrameBus::FrameBus() : _pool(new FrameBufferPool)
+{
+  _published[0] = _published[1] = 0;
+  _lastPublished[0] = _lastPublished[1] = -1;
+}
+
+FrameBus::~FrameBus()
+{
+  QMutexLocker locker(&_mutex);
+  // Consumers still waiting on a subscription are released
+  for (const SubscriptionPtr & subscription : _subscriptions) {
+    subscription->close();
+  }
+}
+
+FrameBus::SubscriptionPtr FrameBus::subscribe(int channels, int depth, DropPolicy policy)
+{
+  SubscriptionPtr subscription = std::make_shared<Subscription>(channels, depth, policy);
+  QMutexLocker locker(&_mutex);
+  _subscriptions.push_back(subscription);
+  return subscription;
+}
+
+void FrameBus::unsubscribe(const SubscriptionPtr & subscription)
+{
+  if (!subscription) {
+    return;
+  }
+  subscription->close();
+  QMutexLocker locker(&_mutex);
+  _subscriptions.removeAll(subscription);
+}
+
+bool FrameBus::hasSubscribers(Channel channel)
+{
+  QMutexLocker locker(&_mutex);
+  for (const SubscriptionPtr & subscription : _subscriptions) {
+    if ((subscription->channels() & channel) && !subscription->isClosed()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+QImage FrameBus::allocateImage(const QSize & size)
+{
+#if QT_VERSION_GTE(5, 0)
+  // Lines are 32-bit aligned, as in any QImage
+  const int bytesPerLine = (size.width() * 3 + 3) & ~3;
+  PooledBuffer * buffer = new PooledBuffer;
+  buffer->pool = _pool;
+  buffer->size = size_t(bytesPerLine) * size.height();
+  buffer->data = _pool->take(buffer->size);
+  return QImage(buffer->data, size.width(), size.height(), bytesPerLine, QImage::Format_RGB888, releasePooledBuffer, buffer);
+#else
+  return QImage(size, QImage::Format_RGB888);
+#endif
+}
+
+void FrameBus::publish(Channel channel, const QImage & image, const ImageSource::FrameInfo & info)
+{
+  std::shared_ptr<Frame> frame = std::make_shared<Frame>();
+  frame->channel = channel;
+  frame->image = image;
+  frame->info = info;
+  frame->published = ImageSource::monotonicTime();
+  QList<SubscriptionPtr> subscriptions;
+  _mutex.lock();
+  ++_published[channelIndex(channel)];
+  _lastPublished[channelIndex(channel)] = frame->published;
+  for (auto it = _subscriptions.begin(); it != _subscriptions.end();) {
+    if ((*it)->isClosed()) {
+      it = _subscriptions.erase(it); // Closed by its consumer
+    } else {
+      if ((*it)->channels() & channel) {
+        subscriptions.push_back(*it);
+      }
+      ++it;
+    }
+  }
+  _mutex.unlock();
+  for (const SubscriptionPtr & subscription : subscriptions) {
+    subscription->offer(frame);
+  }
+}
+
+QList<FrameBus::SubscriptionPtr> FrameBus::subscriptions()
+{
+  QMutexLocker locker(&_mutex);
+  return _subscriptions;
+}
+
+quint64 FrameBus::published(Channel channel)
+{
+  QMutexLocker locker(&_mutex);
+  return _published[channelIndex(channel)];
+}
+
+qint64 FrameBus::lastPublished(Channel channel)
+{
+  QMutexLocker locker(&_mutex);
+  return _lastPublished[channelIndex(channel)];
+}
+
+int FrameBus::channelIndex(Channel channel)
+{
+  return (channel == Input) ? 0 : 1;
+}
@@ -0,0 +1,413 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   FrameSink.cpp
+ * @date   Oct 2026
+ * @brief  Implementation of the class FrameSink
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "FrameSink.h"
+#include <QMutexLocker>
+#include <QSettings>
+#include <cstring>
+#include <iostream>
+#include "Tracing.h"
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef HAS_V4L2
+#include <linux/videodev2.h>
+#include <sys/ioctl.h>
+#endif
+
+FrameSink::FrameSink(const QString & spec)
+    : _spec(spec), _kind(kindFromSpec(spec, &_target)), _format(RawFrame::RGB24), _headers(true), _fd(-1), _outputOpen(false), _written(0), _dropped(0)
+{
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+  if (_kind == StandardOutput || _kind == Fifo) {
+    // A reader going away must not kill the process
+    signal(SIGPIPE, SIG_IGN);
+  }
+  if (_kind == StandardOutput) {
+    // Frames get the original standard output, messages go to the standard error
+    std::cout.flush();
+    _fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+  }
+#else
+  _kind = InvalidKind;
+#endif
+#ifndef HAS_V4L2
+  if (_kind == V4L2Loopback) {
+    _kind = InvalidKind;
+  }
+#endif
+  if (_kind == InvalidKind) {
+    std::cerr << "[ZArt] Unsupported frame output: " << spec.toLocal8Bit().constData() << std::endl;
+  }
+}
+
+FrameSink::~FrameSink()
+{
+  stop();
+  wait();
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+  if (_kind == StandardOutput && _fd != -1) {
+    ::close(_fd);
+  }
+#endif
+}
+
+bool FrameSink::isValid() const
+{
+  return _kind != InvalidKind;
+}
+
+const QString & FrameSink::spec() const
+{
+  return _spec;
+}
+
+FrameSink::Kind FrameSink::kindFromSpec(const QString & spec, QString * target)
+{
+  if (spec == "stdout" || spec == "-") {
+    return StandardOutput;
+  }
+  const int colon = spec.indexOf(':');
+  if (colon == -1 || colon + 1 == spec.size()) {
+    return InvalidKind;
+  }
+  const QString kind = spec.left(colon);
+  if (target) {
+    *target = spec.mid(colon + 1);
+    if (kind == "shm" && !target->startsWith('/')) {
+      target->prepend('/');
+    }
+  }
+  if (kind == "fifo") {
+    return Fifo;
+  }
+  if (kind == "shm") {
+    return SharedMemory;
+  }
+  if (kind == "v4l2") {
+    return V4L2Loopback;
+  }
+  return InvalidKind;
+}
+
+RawFrame::PixelFormat FrameSink::pixelFormatFromName(const QString & name)
+{
+  if (name == "bgr24") {
+    return RawFrame::BGR24;
+  }
+  if (name == "gray" || name == "gray8") {
+    return RawFrame::Gray8;
+  }
+  return RawFrame::RGB24;
+}
+
+FrameSink * FrameSink::create(const QString & spec, const QString & format, bool headers)
+{
+  FrameSink * sink = new FrameSink(spec);
+  if (!sink->isValid()) {
+    delete sink;
+    return nullptr;
+  }
+  sink->setPixelFormat(pixelFormatFromName(format));
+  sink->setHeaders(headers);
+  return sink;
+}
+
+void FrameSink::setPixelFormat(RawFrame::PixelFormat format)
+{
+  _format = format;
+}
+
+void FrameSink::setHeaders(bool on)
+{
+  _headers = on;
+}
+
+void FrameSink::attach(FrameBus & bus)
+{
+  // A frame not written yet is replaced by a newer one
+  _subscription = bus.subscribe(FrameBus::Output, 1, FrameBus::DropOldest);
+  start();
+}
+
+void FrameSink::stop()
+{
+  if (_subscription) {
+    _subscription->close();
+  }
+}
+
+quint64 FrameSink::framesWritten()
+{
+  QMutexLocker locker(&_mutex);
+  return _written;
+}
+
+quint64 FrameSink::framesDropped()
+{
+  QMutexLocker locker(&_mutex);
+  return _dropped + (_subscription ? _subscription->dropped() : 0);
+}
+
+void FrameSink::run()
+{
+  if (_kind == InvalidKind) {
+    return;
+  }
+  while (FrameBus::FramePtr frame = _subscription->take()) {
+    bool ok;
+    {
+      Tracing::Span span("sink write");
+      ok = writeFrame(frame->image, frame->info);
+    }
+    QMutexLocker locker(&_mutex);
+    if (ok) {
+      ++_written;
+    } else {
+      ++_dropped;
+    }
+  }
+  closeOutput();
+}
+
+bool FrameSink::openOutput(const QSize & size)
+{
+  const int bytesPerLine = size.width() * RawFrame::bytesPerPixel(_format);
+  switch (_kind) {
+  case StandardOutput:
+    return _fd != -1;
+  case Fifo:
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+  {
+    const QByteArray path = _target.toLocal8Bit();
+    struct stat status;
+    if (stat(path.constData(), &status) == -1 && mkfifo(path.constData(), 0600) == -1) {
+      std::cerr << "[ZArt] Cannot create FIFO " << path.constData() << ": " << strerror(errno) << std::endl;
+      return false;
+    }
+    // Fails until a reader opens the FIFO, frames are dropped meanwhile
+    _fd = ::open(path.constData(), O_WRONLY | O_NONBLOCK);
+    return _fd != -1;
+  }
+#else
+    return false;
+#endif
+  case SharedMemory: {
+    const int slotCount = QSettings().value("FrameSink/SharedMemorySlots", SharedFrameRing::DefaultSlotCount).toInt();
+    return _ring.create(_target, slotCount, size_t(bytesPerLine) * size.height());
+  }
+  case V4L2Loopback:
+#ifdef HAS_V4L2
+  {
+    _fd = ::open(_target.toLocal8Bit().constData(), O_WRONLY | O_NONBLOCK);
+    if (_fd == -1) {
+      std::cerr << "[ZArt] Cannot open " << _target.toLocal8Bit().constData() << ": " << strerror(errno) << std::endl;
+      return false;
+    }
+    struct v4l2_format format;
+    memset(&format, 0, sizeof(format));
+    format.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    format.fmt.pix.width = size.width();
+    format.fmt.pix.height = size.height();
+    format.fmt.pix.pixelformat = (_format == RawFrame::Gray8) ? V4L2_PIX_FMT_GREY : ((_format == RawFrame::BGR24) ? V4L2_PIX_FMT_BGR24 : V4L2_PIX_FMT_RGB24);
+    format.fmt.pix.field = V4L2_FIELD_NONE;
+    format.fmt.pix.bytesperline = bytesPerLine;
+    format.fmt.pix.sizeimage = bytesPerLine * size.height();
+    format.fmt.pix.colorspace = V4L2_COLORSPACE_SRGB;
+    if (ioctl(_fd, VIDIOC_S_FMT, &format) == -1) {
+      std::cerr << "[ZArt] " << _target.toLocal8Bit().constData() << " is not a v4l2loopback device: " << strerror(errno) << std::endl;
+      ::close(_fd);
+      _fd = -1;
+      return false;
+    }
+    return true;
+  }
+#else
+    return false;
+#endif
+  default:
+    return false;
+  }
+}
+
+void FrameSink::closeOutput()
+{
+  _outputOpen = false;
+  if (_kind == SharedMemory) {
+    _ring.close();
+  }
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+  if ((_kind == Fifo || _kind == V4L2Loopback) && _fd != -1) {
+    ::close(_fd);
+    _fd = -1;
+  }
+#endif
+}
+
+void FrameSink::convertRow(const uchar * src, uchar * dst, int width) const
+{
+  // Source rows are RGB888
+  switch (_format) {
+  case RawFrame::BGR24:
+    for (int x = 0; x < width; ++x, src += 3, dst += 3) {
+      dst[0] = src[2];
+      dst[1] = src[1];
+      dst[2] = src[0];
+    }
+    break;
+  case RawFrame::Gray8:
+    for (int x = 0; x < width; ++x, src += 3) {
+      *dst++ = static_cast<uchar>((77 * src[0] + 150 * src[1] + 29 * src[2]) >> 8);
+    }
+    break;
+  default:
+    memcpy(dst, src, size_t(width) * 3);
+    break;
+  }
+}
+
+bool FrameSink::writeFrame(const QImage & source, const ImageSource::FrameInfo & frame)
+{
+  if (source.isNull()) {
+    return false;
+  }
+  const QImage image = (source.format() == QImage::Format_RGB888) ? source : source.convertToFormat(QImage::Format_RGB888);
+  if (_outputOpen && (image.size() != _size || (_kind == SharedMemory && _ring.isOpen() && image.width() * RawFrame::bytesPerPixel(_format) * size_t(image.height()) > _ring.frameCapacity()))) {
+    closeOutput();
+  }
+  if (!_outputOpen) {
+    _outputOpen = openOutput(image.size());
+    _size = image.size();
+    if (!_outputOpen) {
+      return false;
+    }
+  }
+  RawFrame::FrameHeader header;
+  header.magic = RawFrame::FrameMagic;
+  header.format = _format;
+  header.width = image.width();
+  header.height = image.height();
+  header.stride = image.width() * RawFrame::bytesPerPixel(_format);
+  header.size = header.stride * header.height;
+  header.timestamp = frame.timestamp;
+  header.sequence = frame.sequence;
+
+  if (_kind == SharedMemory) {
+    // The single copy: straight into the ring, where consumers read the pixels
+    RawFrame::SlotHeader * slot = _ring.beginFrame();
+    slot->frame = header;
+    uchar * pixels = _ring.pixels(slot);
+    for (int y = 0; y < image.height(); ++y) {
+      convertRow(image.constScanLine(y), pixels + size_t(y) * header.stride, image.width());
+    }
+    _ring.publishFrame(slot);
+    return true;
+  }
+
+  const uchar * pixels = image.constBits();
+  if (_format != RawFrame::RGB24 || image.bytesPerLine() != static_cast<int>(header.stride)) {
+    _buffer.resize(header.size);
+    for (int y = 0; y < image.height(); ++y) {
+      convertRow(image.constScanLine(y), _buffer.data() + size_t(y) * header.stride, image.width());
+    }
+    pixels = _buffer.data();
+  }
+  if (_kind == V4L2Loopback) {
+    // One write() per frame
+    return writeAll(pixels, header.size);
+  }
+  if (_headers && !writeAll(&header, sizeof(header))) {
+    return false;
+  }
+  return writeAll(pixels, header.size);
+}
+
+bool FrameSink::writeAll(const void * data, size_t size)
+{
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+  const char * bytes = static_cast<const char *>(data);
+  while (size) {
+    struct pollfd pfd;
+    pfd.fd = _fd;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+    // A stalled reader must not prevent the sink from stopping
+    if (poll(&pfd, 1, 100) == 0) {
+      if (_subscription->isClosed()) {
+        return false;
+      }
+      continue;
+    }
+    const ssize_t count = ::write(_fd, bytes, size);
+    if (count == -1) {
+      if (errno == EAGAIN || errno == EINTR) {
+        continue;
+      }
+      if (errno == EPIPE && _kind == Fifo) {
+        // The reader went away, wait for the next one
+        closeOutput();
+      } else {
+        std::cerr << "[ZArt] Frame output " << _spec.toLocal8Bit().constData() << ": " << strerror(errno) << std::endl;
+        if (_kind == StandardOutput) {
+          stop();
+        }
+      }
+      return false;
+    }
+    bytes += count;
+    size -= static_cast<size_t>(count);
+  }
+  return true;
+#else
+  Q_UNUSED(data)
+  Q_UNUSED(size)
+  return false;
+#endif
+}
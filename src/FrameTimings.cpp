@@ -0,0 +1,160 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   FrameTimings.cpp
+ * @date   Oct 2026
+ * @brief  Implementation of the class FrameTimings
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "FrameTimings.h"
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+FrameTimings::FrameTimings()
+{
+  reset();
+}
+
+void FrameTimings::reset()
+{
+  // Only while no stage is being recorded
+  for (Ring & ring : _rings) {
+    ring.next.storeRelease(0);
+    ring.size.storeRelease(0);
+    for (QAtomicInt & duration : ring.durations) {
+      duration.storeRelease(0);
+    }
+  }
+}
+
+void FrameTimings::record(Stage stage, qint64 duration)
+{
+  Ring & ring = _rings[stage];
+  const int next = ring.next.loadAcquire();
+  ring.durations[next].storeRelease(static_cast<int>(std::min(std::max(duration, qint64(0)), qint64(INT_MAX))));
+  ring.next.storeRelease((next + 1) % WindowSize);
+  const int size = ring.size.loadAcquire();
+  if (size < WindowSize) {
+    ring.size.storeRelease(size + 1);
+  }
+}
+
+FrameTimings::Statistics FrameTimings::statistics(Stage stage) const
+{
+  const Ring & ring = _rings[stage];
+  // A duration may be replaced meanwhile by a newer one, which is as good
+  std::vector<int> durations(ring.size.loadAcquire());
+  for (size_t i = 0; i < durations.size(); ++i) {
+    durations[i] = ring.durations[i].loadAcquire();
+  }
+  Statistics stats;
+  stats.samples = static_cast<int>(durations.size());
+  stats.p50 = stats.p95 = stats.max = 0.0f;
+  if (durations.empty()) {
+    return stats;
+  }
+  std::sort(durations.begin(), durations.end());
+  const int last = stats.samples - 1;
+  stats.p50 = durations[std::min(last, static_cast<int>(0.50f * stats.samples))] / 1000.0f;
+  stats.p95 = durations[std::min(last, static_cast<int>(0.95f * stats.samples))] / 1000.0f;
+  stats.max = durations[last] / 1000.0f;
+  return stats;
+}
+
+FrameTimings::Stage FrameTimings::slowestStage() const
+{
+  Stage slowest = StageCount;
+  float median = -1.0f;
+  for (int stage = 0; stage < StageCount; ++stage) {
+    const Statistics stats = statistics(static_cast<Stage>(stage));
+    if (stats.samples && stats.p50 > median) {
+      slowest = static_cast<Stage>(stage);
+      median = stats.p50;
+    }
+  }
+  return slowest;
+}
+
+QString FrameTimings::summary() const
+{
+  QStringList stages;
+  for (int stage = 0; stage < StageCount; ++stage) {
+    const Statistics stats = statistics(static_cast<Stage>(stage));
+    if (stats.samples) {
+      stages << QString("%1 %2/%3/%4 ms").arg(stageName(static_cast<Stage>(stage))).arg(stats.p50, 0, 'f', 1).arg(stats.p95, 0, 'f', 1).arg(stats.max, 0, 'f', 1);
+    }
+  }
+  return stages.join(", ");
+}
+
+QStringList FrameTimings::table() const
+{
+  QStringList lines;
+  for (int stage = 0; stage < StageCount; ++stage) {
+    const Statistics stats = statistics(static_cast<Stage>(stage));
+    if (stats.samples) {
+      lines << QString("%1 %2 %3 %4").arg(stageName(static_cast<Stage>(stage)), -11).arg(stats.p50, 6, 'f', 1).arg(stats.p95, 6, 'f', 1).arg(stats.max, 6, 'f', 1);
+    }
+  }
+  if (!lines.isEmpty()) {
+    lines.prepend(QString("%1 %2 %3 %4").arg(QString("ms"), -11).arg(QString("p50"), 6).arg(QString("p95"), 6).arg(QString("max"), 6));
+  }
+  return lines;
+}
+
+QString FrameTimings::stageName(Stage stage)
+{
+  switch (stage) {
+  case Capture:
+    return "capture";
+  case ConvertIn:
+    return "convert in";
+  case Filter:
+    return "G'MIC";
+  case ConvertOut:
+    return "convert out";
+  case QueueWait:
+    return "queue";
+  case Paint:
+    return "paint";
+  default:
+    return QString();
+  }
+}
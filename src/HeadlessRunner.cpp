@@ -0,0 +1,419 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   HeadlessRunner.cpp
+ * @date   Oct 2026
+ * @brief  Implementation of the class HeadlessRunner
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "HeadlessRunner.h"
+#include <QCoreApplication>
+#include <QDomDocument>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QSettings>
+#include <QSize>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "FilterThread.h"
+#include "FrameSink.h"
+#include "ImageSequenceSource.h"
+#include "MetricsReporter.h"
+#include "MjpegServer.h"
+#include "RawFrameSource.h"
+#include "ScreenSource.h"
+#include "Recorder.h"
+#include "StillImageSource.h"
+#include "Tracing.h"
+#include "VideoFileSource.h"
+#include "WebcamSource.h"
+#ifdef HAS_V4L2
+#include "V4L2Source.h"
+#endif
+
+namespace
+{
+bool isVideoFile(const QString & filename)
+{
+  static const QStringList extensions = QString("avi;mpg;mpeg;flv;mov;mp4;m4v;webm;mkv;ts").split(";");
+  return extensions.contains(QFileInfo(filename).suffix().toLower());
+}
+
+QString presetPath(const QDomNode & preset)
+{
+  QStringList path(preset.attributes().namedItem("name").nodeValue());
+  for (QDomNode node = preset.parentNode(); !node.isNull(); node = node.parentNode()) {
+    if (node.nodeName() == "preset_group") {
+      path.push_front(node.attributes().namedItem("name").nodeValue());
+    }
+  }
+  return path.join("/");
+}
+
+QString quotedText(const QString & text)
+{
+  if (text.isEmpty()) {
+    return QString("\"\\\"\\\"\"");
+  }
+  QString escaped = text;
+  escaped.replace(QChar('"'), QString("\\\""));
+  return QString("\"%1\"").arg(escaped);
+}
+} // namespace
+
+HeadlessRunner::HeadlessRunner()
+    : _source(nullptr), _webcam(nullptr), _filterThread(nullptr), _command("_none_"), _recorder(nullptr), _frameSink(nullptr), _mjpegServer(nullptr), _metricsReporter(nullptr), _outputRate(25.0), _maxFrames(0), _frames(0), _failures(0), _longestFrame(0)
+{
+}
+
+HeadlessRunner::~HeadlessRunner()
+{
+  delete _recorder;
+  delete _mjpegServer;
+  delete _metricsReporter;
+  delete _frameSink;
+  delete _filterThread;
+  delete _source;
+}
+
+bool HeadlessRunner::isRequested(int argc, char * argv[])
+{
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--headless")) {
+      return true;
+    }
+  }
+  return false;
+}
+
+QString HeadlessRunner::optionValue(const QStringList & arguments, const QString & option, const QString & defaultValue)
+{
+  const int index = arguments.indexOf(option);
+  if (index == -1 || index + 1 >= arguments.size()) {
+    return defaultValue;
+  }
+  return arguments[index + 1];
+}
+
+QString HeadlessRunner::presetArguments(const QDomNode & preset)
+{
+  // Same values as a freshly built CommandParamsWidget would give
+  QStringList values;
+  for (QDomElement e = preset.firstChildElement(); !e.isNull(); e = e.nextSiblingElement()) {
+    const QString tag = e.tagName();
+    const QString value = e.attribute("savedValue", e.attribute("default"));
+    if (tag == "int" || tag == "float" || tag == "color") {
+      values << value;
+    } else if (tag == "choice") {
+      values << e.attribute("savedValue", e.attribute("default", "0"));
+    } else if (tag == "bool") {
+      values << ((value == "1") ? "1" : "0");
+    } else if (tag == "text" || tag == "file" || tag == "folder") {
+      values << quotedText(value);
+    } else if (tag == "const") {
+      values << e.attribute("value");
+    } else if (tag == "point") {
+      QString position = e.attribute("position");
+      QString saved = e.attribute("savedValue");
+      if (!saved.isEmpty()) {
+        if (saved.endsWith(QChar('-'))) {
+          values << "nan,nan";
+          continue;
+        }
+        saved.chop(1);
+        position = saved;
+      }
+      values << position;
+    }
+  }
+  return values.join(",");
+}
+
+int HeadlessRunner::exec(const QStringList & arguments)
+{
+  const QString traceFile = optionValue(arguments, "--trace");
+  if (!traceFile.isEmpty()) {
+    Tracing::start();
+  }
+  if (arguments.contains("--sink")) {
+    // Created first: messages printed until then would be mixed with frames sent to the standard output
+    _frameSink = FrameSink::create(optionValue(arguments, "--sink"), optionValue(arguments, "--sink-format"), !arguments.contains("--sink-no-header"));
+    if (!_frameSink) {
+      return EXIT_FAILURE;
+    }
+    _frameSink->attach(_frameBus);
+  }
+  const QString input = optionValue(arguments, "--input");
+  if (input.isEmpty()) {
+    std::cerr << "[ZArt] Error: --headless requires an --input." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!openInput(input, arguments)) {
+    return EXIT_FAILURE;
+  }
+  if (arguments.contains("--command")) {
+    _command = optionValue(arguments, "--command");
+  } else if (!loadCommand(optionValue(arguments, "--preset"), optionValue(arguments, "--presets"))) {
+    return EXIT_FAILURE;
+  }
+  if (arguments.contains("--params")) {
+    _arguments = optionValue(arguments, "--params");
+  }
+  _output = optionValue(arguments, "--output");
+  _outputRate = optionValue(arguments, "--rate", "25").toDouble();
+  if (_outputRate <= 0.0) {
+    _outputRate = 25.0;
+  }
+  if (isVideoFile(_output)) {
+    // Every frame is kept, unless --record-policy drop is given
+    const Recorder::Policy policy = (optionValue(arguments, "--record-policy", "wait") == "drop") ? Recorder::DropFrames : Recorder::WaitForEncoder;
+    _recorder = new Recorder(_output, optionValue(arguments, "--codec"), _outputRate, policy);
+    // Only a camera, the screen or another process gives frames on a time line
+    _recorder->setTimestamps((_source == _webcam) || dynamic_cast<RawFrameSource *>(_source) || dynamic_cast<ScreenSource *>(_source));
+    _recorder->attach(_frameBus);
+  }
+  if (arguments.contains("--mjpeg")) {
+    const QString quality = optionValue(arguments, "--mjpeg-quality");
+    _mjpegServer = MjpegServer::create(_frameBus, optionValue(arguments, "--mjpeg"), optionValue(arguments, "--mjpeg-rate").toDouble(), quality.isEmpty() ? -1 : quality.toInt());
+    if (!_mjpegServer) {
+      return EXIT_FAILURE;
+    }
+  }
+  // A still image would be rendered forever
+  const bool stillImage = dynamic_cast<StillImageSource *>(_source);
+  _maxFrames = std::max(0, optionValue(arguments, "--frames", stillImage ? "1" : "0").toInt());
+
+  // Image files are written from the filter thread, once each frame is published
+  _outputSubscription = _frameBus.subscribe(FrameBus::Output, 1, FrameBus::DropOldest);
+  // No frame rate and no blocking semaphore: the thread renders as fast as it can
+  _filterThread = new FilterThread(*_source, _command, _frameBus, FilterThread::Full, 0, 0, nullptr);
+  _filterThread->setViewSize(QSize(_source->width(), _source->height()));
+  _filterThread->setArguments(_arguments);
+  _filterThread->setFrameTimings(&_frameTimings);
+  _metricsReporter = MetricsReporter::create(_frameBus, _frameTimings, optionValue(arguments, "--metrics-socket"), optionValue(arguments, "--metrics-log"), optionValue(arguments, "--metrics-interval").toInt());
+  if (_metricsReporter) {
+    _metricsReporter->setFilterThread(_filterThread);
+    _metricsReporter->setPreset(arguments.contains("--command") ? QString("command") : optionValue(arguments, "--preset"));
+  } else if (arguments.contains("--metrics-socket") || arguments.contains("--metrics-log")) {
+    return EXIT_FAILURE;
+  }
+  // Frames are written by the filter thread itself, before it renders the next one
+  connect(_filterThread, SIGNAL(imageAvailable()), this, SLOT(onImageAvailable()), Qt::DirectConnection);
+  connect(_filterThread, SIGNAL(finished()), QCoreApplication::instance(), SLOT(quit()));
+  std::cout << "[ZArt] Headless: " << input.toLocal8Bit().constData() << " (" << _source->width() << "x" << _source->height() << ") -> "
+            << (_output.isEmpty() ? "no output" : _output.toLocal8Bit().constData()) << std::endl;
+  _runTime.start();
+  _frameTime.start();
+  _filterThread->start();
+  QCoreApplication::exec();
+  stop();
+  _filterThread->wait();
+  if (_webcam) {
+    _webcam->stop();
+  }
+  if (_recorder) {
+    _recorder->finish();
+    _recorder->wait();
+    if (_recorder->hasFailed()) {
+      ++_failures;
+    } else if (_recorder->framesDropped()) {
+      std::cout << "[ZArt] " << _recorder->framesDropped() << " frame(s) dropped by the encoder" << std::endl;
+    }
+  }
+  if (_frameSink) {
+    _frameSink->stop();
+    _frameSink->wait();
+    std::cout << "[ZArt] Frame output: " << _frameSink->framesWritten() << " frame(s) written, " << _frameSink->framesDropped() << " dropped" << std::endl;
+  }
+  printStatistics();
+  if (!traceFile.isEmpty()) {
+    Tracing::stop();
+    Tracing::save(traceFile);
+  }
+  return (_frames && !_failures) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void HeadlessRunner::stop()
+{
+  if (_filterThread) {
+    _filterThread->stop();
+  }
+}
+
+void HeadlessRunner::onImageAvailable()
+{
+  _longestFrame = std::max(_longestFrame, _frameTime.restart());
+  const FrameBus::FramePtr frame = _outputSubscription->takeLatest();
+  if (!frame || !writeFrame(frame->image)) {
+    ++_failures;
+    _filterThread->stop();
+    return;
+  }
+  ++_frames;
+  if (_maxFrames && _frames >= _maxFrames) {
+    _filterThread->stop();
+  }
+}
+
+bool HeadlessRunner::openInput(const QString & input, const QStringList & arguments)
+{
+  bool isNumber = false;
+  const int camera = input.toInt(&isNumber);
+  if (RawFrameSource::isStream(input)) {
+    RawFrameSource * stream = new RawFrameSource;
+    _source = stream;
+    stream->open(input, RawFrameSource::sizeFromString(optionValue(arguments, "--raw-size")), optionValue(arguments, "--raw-format"));
+  } else if (ScreenSource::isScreen(input)) {
+    ScreenSource * screen = new ScreenSource;
+    _source = screen;
+    // Captured at the rate of the output video
+    screen->setFrameRate(optionValue(arguments, "--rate", QSettings().value("ScreenSource/FrameRate", ScreenSource::DefaultFrameRate).toString()).toDouble());
+    screen->open(input);
+  } else if (isNumber) {
+    WebcamSource::setCameras(WebcamSource::discoverCameras());
+    const int position = WebcamSource::getCachedWebcamList().indexOf(camera);
+    if (position == -1 || WebcamSource::webcamResolutions(position).isEmpty()) {
+      std::cerr << "[ZArt] Error: No usable camera with index " << camera << std::endl;
+      return false;
+    }
+#ifdef HAS_V4L2
+    _webcam = new V4L2Source;
+#else
+    _webcam = new WebcamSource;
+#endif
+    _source = _webcam;
+    _webcam->setCaptureSize(WebcamSource::webcamResolutions(position).last());
+    _webcam->setCameraIndex(camera);
+    _webcam->start();
+    _webcam->capture();
+  } else if (ImageSequenceSource::isSequence(input)) {
+    ImageSequenceSource * sequence = new ImageSequenceSource;
+    _source = sequence;
+    sequence->setLoop(false);
+    sequence->open(input);
+  } else if (isVideoFile(input)) {
+    VideoFileSource * video = new VideoFileSource;
+    _source = video;
+    video->setLoop(false);
+    video->loadVideoFile(input);
+  } else {
+    StillImageSource * image = new StillImageSource;
+    _source = image;
+    image->loadImage(input);
+  }
+  if (!_source->width() || !_source->height()) {
+    std::cerr << "[ZArt] Error: Cannot read input " << input.toLocal8Bit().constData() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool HeadlessRunner::loadCommand(const QString & preset, const QString & presetsFile)
+{
+  if (preset.isEmpty()) {
+    return true; // The input is copied as is
+  }
+  QString filename = presetsFile;
+  if (filename.isEmpty()) {
+    QSettings settings;
+    filename = (settings.value("Presets", QString("Built-in")).toString() == "File") ? settings.value("PresetsFile").toString() : QString(":/presets.xml");
+  }
+  QFile file(filename);
+  QDomDocument presets;
+  if (!file.open(QIODevice::ReadOnly) || !presets.setContent(&file, false)) {
+    std::cerr << "[ZArt] Error: Cannot read presets file " << filename.toLocal8Bit().constData() << std::endl;
+    return false;
+  }
+  // A preset is given either by its name or by its path, like "Artistic/Cartoon"
+  QDomNodeList list = presets.elementsByTagName("preset");
+  for (int i = 0; i < list.count(); ++i) {
+    QDomNode node = list.at(i);
+    if (node.attributes().namedItem("name").nodeValue() == preset || presetPath(node) == preset) {
+      _command = node.namedItem("command").firstChild().toText().data().trimmed();
+      _arguments = presetArguments(node);
+      return true;
+    }
+  }
+  std::cerr << "[ZArt] Error: No preset named " << preset.toLocal8Bit().constData() << std::endl;
+  return false;
+}
+
+bool HeadlessRunner::writeFrame(const QImage & image)
+{
+  if (_output.isEmpty()) {
+    return true;
+  }
+  if (image.isNull()) {
+    return false;
+  }
+  if (_recorder) {
+    // Already queued by the bus: with --record-policy wait, the next frame waits for the encoder
+    _recorder->throttle();
+    return !_recorder->hasFailed();
+  }
+  // A printf-style pattern gives one file per frame, otherwise the file keeps the last one
+  QString filename = _output;
+  QRegExp number("%(0?)(\\d*)d");
+  if (number.indexIn(filename) != -1) {
+    const int width = number.cap(1).isEmpty() ? 0 : number.cap(2).toInt();
+    filename.replace(number.pos(), number.matchedLength(), QString("%1").arg(_frames, width, 10, QChar('0')));
+  }
+  if (!image.save(filename)) {
+    std::cerr << "[ZArt] Error: Cannot write image file " << filename.toLocal8Bit().constData() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void HeadlessRunner::printStatistics()
+{
+  const qint64 elapsed = std::max(qint64(1), _runTime.elapsed());
+  std::cout << "[ZArt] " << _frames << " frame(s) in " << elapsed / 1000.0 << " s: " << (_frames * 1000.0) / elapsed << " fps, " << (_frames ? double(elapsed) / _frames : 0.0)
+            << " ms per frame on average, " << _longestFrame << " ms at most" << std::endl;
+  const QString timings = _frameTimings.summary();
+  if (!timings.isEmpty()) {
+    std::cout << "[ZArt] Frame stages (p50/p95/max): " << timings.toLocal8Bit().constData() << std::endl;
+  }
+  if (_failures) {
+    std::cout << "[ZArt] Output failed, stopped early." << std::endl;
+  }
+}
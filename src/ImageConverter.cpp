@@ -45,14 +45,42 @@
  */
 #include "ImageConverter.h"
 #include <QImage>
-#include <QMutex>
 #include <QPainter>
 #include <cassert>
 #include <iostream>
 #include "Common.h"
+#include "ImageSource.h"
 
 cv::Mat * ImageConverter::_image = 0;
 
+namespace
+{
+inline float clampByte(float value)
+{
+  return (value < 0.0f) ? 0.0f : ((value > 255.0f) ? 255.0f : value);
+}
+
+// Rounded, as the renderings stored by RenderCache
+inline unsigned char roundByte(float value)
+{
+  return static_cast<unsigned char>(clampByte(value) + 0.5f);
+}
+
+// ITU-R BT.601 limited range, as used by cv::COLOR_YUV2BGR_*
+inline float lumaFromY(float y)
+{
+  return clampByte(1.164f * (y - 16.0f));
+}
+
+inline void rgbFromYUV(float y, float u, float v, float & r, float & g, float & b)
+{
+  const float c = 1.164f * (y - 16.0f);
+  r = clampByte(c + 1.596f * v);
+  g = clampByte(c - 0.813f * v - 0.391f * u);
+  b = clampByte(c + 2.018f * u);
+}
+} // namespace
+
 void ImageConverter::convert(const cv::Mat * in, QImage * out)
 {
   if (!in || !out) {
@@ -132,16 +160,16 @@ void ImageConverter::convert(const cimg_library::CImg<float> & in, QImage * out)
   while (height--) {
     endSrcR += width;
     while (srcR != endSrcR) {
-      dst[0] = static_cast<unsigned char>(*srcR++);
-      dst[1] = static_cast<unsigned char>(*srcG++);
-      dst[2] = static_cast<unsigned char>(*srcB++);
+      dst[0] = roundByte(*srcR++);
+      dst[1] = roundByte(*srcG++);
+      dst[2] = roundByte(*srcB++);
       dst += 3;
     }
     dst += offset;
   }
 }
 
-void ImageConverter::merge(cv::Mat * cvImage, const cimg_library::CImg<float> & cimgImage, QImage * out, QMutex * imageMutex, MergeDirection direction)
+void ImageConverter::merge(cv::Mat * cvImage, const cimg_library::CImg<float> & cimgImage, QImage * out, MergeDirection direction)
 {
   if (!cvImage || !out) {
     return;
@@ -158,9 +186,7 @@ void ImageConverter::merge(cv::Mat * cvImage, const cimg_library::CImg<float> &
   }
   QSize size(cimgImage.width(), cimgImage.height());
   if (out->size() != size) {
-    imageMutex->lock();
     *out = QImage(size, QImage::Format_RGB888);
-    imageMutex->unlock();
   }
   switch (direction) {
   case MergeTop:
@@ -202,9 +228,9 @@ void ImageConverter::mergeTop(cv::Mat * cvImage, const cimg_library::CImg<float>
   while (lines--) {
     endDst = dst + 3 * width;
     while (dst != endDst) {
-      dst[0] = static_cast<unsigned char>(*srcR++);
-      dst[1] = static_cast<unsigned char>(*srcG++);
-      dst[2] = static_cast<unsigned char>(*srcB++);
+      dst[0] = roundByte(*srcR++);
+      dst[1] = roundByte(*srcG++);
+      dst[2] = roundByte(*srcB++);
       dst += 3;
     }
     dst += qiOffset;
@@ -247,9 +273,9 @@ void ImageConverter::mergeLeft(cv::Mat * cvImage, const cimg_library::CImg<float
   while (height--) {
     endDst = dst + 3 * firstHalf;
     while (dst != endDst) {
-      dst[0] = static_cast<unsigned char>(*srcR++);
-      dst[1] = static_cast<unsigned char>(*srcG++);
-      dst[2] = static_cast<unsigned char>(*srcB++);
+      dst[0] = roundByte(*srcR++);
+      dst[1] = roundByte(*srcG++);
+      dst[2] = roundByte(*srcB++);
       dst += 3;
     }
     srcR += secondHalf;
@@ -305,9 +331,9 @@ void ImageConverter::mergeBottom(cv::Mat * cvImage, const cimg_library::CImg<flo
   while (lines--) {
     endDst = dst + 3 * width;
     while (dst != endDst) {
-      dst[0] = static_cast<unsigned char>(*srcR++);
-      dst[1] = static_cast<unsigned char>(*srcG++);
-      dst[2] = static_cast<unsigned char>(*srcB++);
+      dst[0] = roundByte(*srcR++);
+      dst[1] = roundByte(*srcG++);
+      dst[2] = roundByte(*srcB++);
       dst += 3;
     }
     dst += qiOffset;
@@ -348,9 +374,9 @@ void ImageConverter::mergeRight(cv::Mat * cvImage, const cimg_library::CImg<floa
     // Second half from cimgImage
     endDst = dst + 3 * secondHalf;
     while (dst != endDst) {
-      dst[0] = static_cast<unsigned char>(*srcR++);
-      dst[1] = static_cast<unsigned char>(*srcG++);
-      dst[2] = static_cast<unsigned char>(*srcB++);
+      dst[0] = roundByte(*srcR++);
+      dst[1] = roundByte(*srcG++);
+      dst[2] = roundByte(*srcB++);
       dst += 3;
     }
     srcR += firstHalf;
@@ -385,3 +411,80 @@ void ImageConverter::convert(const cv::Mat * in, cimg_library::CImg<float> & out
     src += iplOffset;
   }
 }
+
+void ImageConverter::convert(const ImageSource & source, cimg_library::CImg<float> & out, bool lumaOnly)
+{
+  const int width = source.width();
+  const int height = source.height();
+  if (!out.is_sameXYZC(width, height, 1, lumaOnly ? 1 : 3)) {
+    out.assign(width, height, 1, lumaOnly ? 1 : 3);
+  }
+  const unsigned char * data = source.rawData();
+  const ImageSource::PixelFormat format = data ? source.pixelFormat() : ImageSource::BGR24;
+  if (format == ImageSource::BGR24 && !lumaOnly) {
+    convert(source.image(), out);
+    return;
+  }
+  // Single pass from the source pixels to the planar float buffer, row by row
+  const cv::Mat * bgr = (format == ImageSource::BGR24) ? source.image() : nullptr;
+  const int stride = bgr ? static_cast<int>(bgr->step) : source.rawStride();
+  const unsigned char * pixels = bgr ? reinterpret_cast<const unsigned char *>(bgr->ptr()) : data;
+  const unsigned char * uvPlane = pixels + static_cast<size_t>(stride) * height; // NV12 only
+  cimg_pragma_openmp(parallel for cimg_openmp_if(width * height >= 65536))
+  for (int y = 0; y < height; ++y) {
+    const unsigned char * src = pixels + static_cast<size_t>(y) * stride;
+    float * dstR = out.data(0, y, 0, 0);
+    if (lumaOnly) {
+      switch (format) {
+      case ImageSource::BGR24:
+        for (int x = 0; x < width; ++x, src += 3) {
+          dstR[x] = 0.114f * src[0] + 0.587f * src[1] + 0.299f * src[2];
+        }
+        break;
+      case ImageSource::YUYV:
+        for (int x = 0; x < width; ++x) {
+          dstR[x] = lumaFromY(src[2 * x]);
+        }
+        break;
+      case ImageSource::NV12:
+        for (int x = 0; x < width; ++x) {
+          dstR[x] = lumaFromY(src[x]);
+        }
+        break;
+      case ImageSource::BGRX32:
+        for (int x = 0; x < width; ++x, src += 4) {
+          dstR[x] = 0.114f * src[0] + 0.587f * src[1] + 0.299f * src[2];
+        }
+        break;
+      }
+      continue;
+    }
+    float * dstG = out.data(0, y, 0, 1);
+    float * dstB = out.data(0, y, 0, 2);
+    if (format == ImageSource::YUYV) {
+      for (int x = 0; x + 1 < width; x += 2, src += 4) {
+        const float u = src[1] - 128.0f;
+        const float v = src[3] - 128.0f;
+        rgbFromYUV(src[0], u, v, dstR[x], dstG[x], dstB[x]);
+        rgbFromYUV(src[2], u, v, dstR[x + 1], dstG[x + 1], dstB[x + 1]);
+      }
+      if (width & 1) {
+        // Last column, alone in its macropixel: its V is there only if the line was padded
+        const float v = (2 * width + 2 <= stride) ? src[3] - 128.0f : 0.0f;
+        rgbFromYUV(src[0], src[1] - 128.0f, v, dstR[width - 1], dstG[width - 1], dstB[width - 1]);
+      }
+    } else if (format == ImageSource::BGRX32) {
+      for (int x = 0; x < width; ++x, src += 4) {
+        dstR[x] = src[2];
+        dstG[x] = src[1];
+        dstB[x] = src[0];
+      }
+    } else { // NV12
+      const unsigned char * uv = uvPlane + static_cast<size_t>(y / 2) * stride;
+      for (int x = 0; x < width; ++x) {
+        const int c = x & ~1;
+        rgbFromYUV(src[x], uv[c] - 128.0f, uv[c + 1] - 128.0f, dstR[x], dstG[x], dstB[x]);
+      }
+    }
+  }
+}
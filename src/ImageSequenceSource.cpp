@@ -0,0 +1,411 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   ImageSequenceSource.cpp
+ * @date   Oct 2026
+ * @brief  Implementation of the class ImageSequenceSource
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "ImageSequenceSource.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QPair>
+#include <QRegExp>
+#include <QSettings>
+#include <QThread>
+#include <algorithm>
+#include <iostream>
+#include "Common.h"
+
+namespace
+{
+const char * ImageFilters[] = {"*.png", "*.jpg", "*.jpeg", "*.bmp", "*.tif", "*.tiff", "*.ppm", "*.pgm", "*.webp"};
+
+bool readFile(const QString & filename, std::vector<uchar> & data)
+{
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  data.resize(static_cast<size_t>(file.size()));
+  return data.empty() || file.read(reinterpret_cast<char *>(data.data()), file.size()) == file.size();
+}
+
+bool decodeFile(const QString & filename, std::vector<uchar> & data, cv::Mat & image)
+{
+  if (!readFile(filename, data) || data.empty()) {
+    return false;
+  }
+  try {
+    cv::imdecode(data, cv::IMREAD_COLOR, &image);
+  } catch (cv::Exception & e) {
+    std::cerr << "OpenCV says: " << e.what() << std::endl;
+    return false;
+  }
+  return !image.empty();
+}
+
+// Files of folder whose names match prefix + number + suffix, sorted by number
+QStringList numberedFiles(const QDir & dir, const QString & prefix, int width, const QString & suffix)
+{
+  const QString digits = width ? QString("(\\d{%1})").arg(width) : QString("(\\d+)");
+  QRegExp re(QRegExp::escape(prefix) + digits + QRegExp::escape(suffix));
+  QList<QPair<qlonglong, QString>> matches;
+  for (const QString & name : dir.entryList(QDir::Files)) {
+    if (re.exactMatch(name)) {
+      matches.push_back(qMakePair(re.cap(1).toLongLong(), dir.absoluteFilePath(name)));
+    }
+  }
+  std::sort(matches.begin(), matches.end());
+  QStringList files;
+  for (const QPair<qlonglong, QString> & match : matches) {
+    files << match.second;
+  }
+  return files;
+}
+} // namespace
+
+ImageSequenceSource::ImageSequenceSource()
+{
+  _next = 0;
+  _scheduled = 0;
+  _generation = 0;
+  _heldSlot = -1;
+  _position = -1;
+  _loop = true;
+  _continue = false;
+}
+
+ImageSequenceSource::~ImageSequenceSource()
+{
+  close();
+}
+
+bool ImageSequenceSource::isSequence(const QString & path)
+{
+  return QFileInfo(path).isDir() || QFileInfo(path).fileName().contains('%');
+}
+
+QStringList ImageSequenceSource::sequenceFiles(const QString & path)
+{
+  QFileInfo info(path);
+  if (info.isDir()) {
+    QDir dir(path);
+    QStringList filters;
+    for (const char * filter : ImageFilters) {
+      filters << filter;
+    }
+    QStringList files;
+    for (const QString & name : dir.entryList(filters, QDir::Files, QDir::Name)) {
+      files << dir.absoluteFilePath(name);
+    }
+    return files;
+  }
+  const QString name = info.fileName();
+  QRegExp printfPattern("^(.*)%(0?)(\\d*)d(.*)$");
+  if (printfPattern.exactMatch(name)) {
+    const int width = printfPattern.cap(2).isEmpty() ? 0 : printfPattern.cap(3).toInt();
+    return numberedFiles(info.dir(), printfPattern.cap(1), width, printfPattern.cap(4));
+  }
+  // One file of a numbered sequence: its last run of digits is the frame number
+  QRegExp numbered("^(.*\\D)?(\\d+)(\\D*)$");
+  if (info.isFile() && numbered.exactMatch(name)) {
+    const QString digits = numbered.cap(2);
+    const int width = digits.startsWith('0') ? digits.length() : 0;
+    return numberedFiles(info.dir(), numbered.cap(1), width, numbered.cap(3));
+  }
+  return info.isFile() ? QStringList(info.absoluteFilePath()) : QStringList();
+}
+
+bool ImageSequenceSource::open(const QString & path)
+{
+  close();
+  QStringList files = sequenceFiles(path);
+  // The first readable frame gives the frame size, hence the number of buffers
+  std::vector<uchar> data;
+  cv::Mat first;
+  while (!files.isEmpty() && !decodeFile(files.front(), data, first)) {
+    std::cerr << "[ZArt] Skipping unreadable image " << files.front().toLocal8Bit().constData() << std::endl;
+    files.pop_front();
+  }
+  if (files.isEmpty()) {
+    setWidth(0);
+    setHeight(0);
+    setImage(nullptr);
+    return false;
+  }
+  _files = files;
+  _filename = QFileInfo(path).fileName();
+  _filePath = QFileInfo(path).absolutePath();
+  setWidth(first.cols);
+  setHeight(first.rows);
+
+  QSettings settings;
+  const qint64 budget = qint64(settings.value("ImageSequenceSource/PrefetchMB", DefaultPrefetchMB).toInt()) << 20;
+  const qint64 frameBytes = std::max<qint64>(1, qint64(first.total() * first.elemSize()));
+  const int slotCount = int(std::max<qint64>(2, std::min<qint64>(MaximumSlots, budget / frameBytes)));
+  int threads = settings.value("ImageSequenceSource/DecoderThreads", QThread::idealThreadCount()).toInt();
+  threads = std::max(1, std::min(threads, slotCount - 1));
+
+  _slots.resize(slotCount);
+  for (Slot & slot : _slots) {
+    slot.ticket = -1;
+    slot.generation = 0;
+    slot.state = Free;
+  }
+  _slots[0].image = first;
+  _slots[0].ticket = 0;
+  _slots[0].state = Ready;
+  _next = 0;
+  _scheduled = 1;
+  _generation = 0;
+  _heldSlot = -1;
+  _position = -1;
+  _continue = true;
+  for (int i = 0; i < threads; ++i) {
+    _decoders.emplace_back(&ImageSequenceSource::decodeFrames, this);
+  }
+  std::cout << "[ZArt] Image sequence: " << _files.size() << " frames, " << slotCount << " buffers, " << threads << " decoder threads" << std::endl;
+  return true;
+}
+
+void ImageSequenceSource::close()
+{
+  {
+    QMutexLocker locker(&_mutex);
+    _continue = false;
+    _slotFreed.wakeAll();
+    _slotReady.wakeAll();
+  }
+  for (std::thread & decoder : _decoders) {
+    decoder.join();
+  }
+  _decoders.clear();
+  setImage(nullptr);
+  _slots.clear();
+  _files.clear();
+  _heldSlot = -1;
+}
+
+void ImageSequenceSource::decodeFrames()
+{
+  std::vector<uchar> data; // File contents, reused from one frame to the next
+  QMutexLocker locker(&_mutex);
+  while (_continue) {
+    const int index = freeSlot();
+    if (index == -1 || (!_loop && _scheduled >= _files.size())) {
+      _slotFreed.wait(&_mutex);
+      continue;
+    }
+    Slot & slot = _slots[index];
+    slot.ticket = _scheduled++;
+    slot.generation = _generation;
+    slot.state = Decoding;
+    const QString filename = _files[slot.ticket % _files.size()];
+    locker.unlock();
+    // The slot belongs to this thread while it is in the Decoding state
+    const bool ok = decodeFile(filename, data, slot.image);
+    locker.relock();
+    if (slot.generation != _generation || slot.ticket < _next) {
+      slot.state = Free; // Skipped or seeked away while decoding
+      _slotFreed.wakeAll();
+    } else {
+      slot.state = ok ? Ready : Failed;
+      _slotReady.wakeAll();
+    }
+  }
+}
+
+int ImageSequenceSource::slotFor(int ticket) const
+{
+  for (int i = 0; i < _slots.size(); ++i) {
+    const Slot & slot = _slots[i];
+    if (slot.ticket == ticket && slot.generation == _generation && (slot.state == Ready || slot.state == Failed)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int ImageSequenceSource::freeSlot() const
+{
+  for (int i = 0; i < _slots.size(); ++i) {
+    if (_slots[i].state == Free) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void ImageSequenceSource::releaseSlots(bool all)
+{
+  for (Slot & slot : _slots) {
+    if ((slot.state == Ready || slot.state == Failed) && (all || slot.ticket < _next)) {
+      slot.state = Free;
+    }
+  }
+  _slotFreed.wakeAll();
+}
+
+void ImageSequenceSource::capture()
+{
+  QMutexLocker locker(&_mutex);
+  if (_files.isEmpty()) {
+    return;
+  }
+  int failures = 0;
+  while (_continue) {
+    if (!_loop && _next >= _files.size()) {
+      // End of the sequence: the next playback starts over
+      setImage(nullptr);
+      _next = 0;
+      _scheduled = 0;
+      ++_generation;
+      releaseSlots(true);
+      return;
+    }
+    const int index = slotFor(_next);
+    if (index == -1) {
+      _slotReady.wait(&_mutex);
+      continue;
+    }
+    Slot & slot = _slots[index];
+    if (slot.state == Failed) {
+      std::cerr << "[ZArt] Skipping unreadable image " << _files[slot.ticket % _files.size()].toLocal8Bit().constData() << std::endl;
+      slot.state = Free;
+      ++_next;
+      _slotFreed.wakeAll();
+      if (++failures >= _files.size()) {
+        setImage(nullptr);
+        return;
+      }
+      continue;
+    }
+    // The source image shares the slot data, which is held until the next frame replaces it
+    setImage(new cv::Mat(slot.image));
+    setFrameInfo(frameInfo().timestamp, static_cast<quint64>(slot.ticket));
+    _position = slot.ticket % _files.size();
+    if (_heldSlot != -1) {
+      _slots[_heldSlot].state = Free;
+    }
+    slot.state = Held;
+    _heldSlot = index;
+    ++_next;
+    _slotFreed.wakeAll();
+    return;
+  }
+}
+
+void ImageSequenceSource::skipFrames(int count)
+{
+  QMutexLocker locker(&_mutex);
+  if (count <= 0 || _files.isEmpty()) {
+    return;
+  }
+  _next += count;
+  if (!_loop) {
+    _next = std::min(_next, _files.size());
+  }
+  _scheduled = std::max(_scheduled, _next);
+  releaseSlots(false);
+}
+
+void ImageSequenceSource::seek(int frame)
+{
+  QMutexLocker locker(&_mutex);
+  if (_files.isEmpty()) {
+    return;
+  }
+  frame = std::max(0, std::min(frame, _files.size() - 1));
+  // Tickets keep increasing when looping, so that frames already decoded ahead remain usable
+  int ticket = frame;
+  if (_loop) {
+    ticket += (_next / _files.size()) * _files.size();
+    if (ticket < _next) {
+      ticket += _files.size();
+    }
+  }
+  if (ticket >= _next && ticket < _scheduled) {
+    _next = ticket;
+    releaseSlots(false);
+    return;
+  }
+  _next = ticket;
+  _scheduled = ticket;
+  ++_generation;
+  releaseSlots(true);
+}
+
+const QString & ImageSequenceSource::filename() const
+{
+  return _filename;
+}
+
+const QString & ImageSequenceSource::filePath() const
+{
+  return _filePath;
+}
+
+int ImageSequenceSource::frameCount() const
+{
+  QMutexLocker locker(&_mutex);
+  return _files.size();
+}
+
+int ImageSequenceSource::position() const
+{
+  QMutexLocker locker(&_mutex);
+  return _position;
+}
+
+void ImageSequenceSource::setLoop(bool on)
+{
+  QMutexLocker locker(&_mutex);
+  if (_loop && !on && !_files.isEmpty()) {
+    // Back to plain frame numbers
+    _next %= _files.size();
+    _scheduled = _next;
+    ++_generation;
+    releaseSlots(true);
+  }
+  _loop = on;
+  _slotFreed.wakeAll();
+}
@@ -44,13 +44,27 @@
  * knowledge of the CeCILL license and that you accept its terms.
  */
 #include "ImageSource.h"
+#include <QAtomicInt>
+#include <chrono>
 #include <opencv2/opencv.hpp>
 
+namespace
+{
+QAtomicInt sourceCount;
+}
+
 ImageSource::ImageSource()
 {
   _width = 0;
   _height = 0;
   _image = nullptr;
+  _pixelFormat = BGR24;
+  _rawData = nullptr;
+  _rawStride = 0;
+  _generation = 0;
+  _frameInfo.timestamp = 0;
+  _frameInfo.sequence = 0;
+  _frameInfo.sourceId = sourceCount.fetchAndAddRelaxed(1);
 }
 
 ImageSource::~ImageSource()
@@ -60,9 +74,43 @@ ImageSource::~ImageSource()
 
 cv::Mat * ImageSource::image() const
 {
+  // A raw (YUV, BGRX) frame is converted to BGR only if someone asks for it
+  if (!_image && _rawData) {
+    _image = new cv::Mat;
+    if (_pixelFormat == YUYV) {
+      cv::Mat frame(_height, _width, CV_8UC2, const_cast<unsigned char *>(_rawData), _rawStride);
+      cv::cvtColor(frame, *_image, cv::COLOR_YUV2BGR_YUYV);
+    } else if (_pixelFormat == NV12) {
+      cv::Mat frame(_height + _height / 2, _width, CV_8UC1, const_cast<unsigned char *>(_rawData), _rawStride);
+      cv::cvtColor(frame, *_image, cv::COLOR_YUV2BGR_NV12);
+    } else if (_pixelFormat == BGRX32) {
+      cv::Mat frame(_height, _width, CV_8UC4, const_cast<unsigned char *>(_rawData), _rawStride);
+      cv::cvtColor(frame, *_image, cv::COLOR_BGRA2BGR);
+    }
+  }
   return _image;
 }
 
+bool ImageSource::hasImage() const
+{
+  return _image || _rawData;
+}
+
+ImageSource::PixelFormat ImageSource::pixelFormat() const
+{
+  return _pixelFormat;
+}
+
+const unsigned char * ImageSource::rawData() const
+{
+  return _rawData;
+}
+
+int ImageSource::rawStride() const
+{
+  return _rawStride;
+}
+
 void ImageSource::setWidth(int width)
 {
   _width = width;
@@ -77,6 +125,11 @@ void ImageSource::setImage(cv::Mat * image)
 {
   delete _image;
   _image = image;
+  _pixelFormat = BGR24;
+  _rawData = nullptr;
+  _rawStride = 0;
+  ++_generation;
+  stampFrame();
   if (_image) {
     _width = image->cols;
     _height = image->rows;
@@ -86,6 +139,54 @@ void ImageSource::setImage(cv::Mat * image)
   }
 }
 
+void ImageSource::setRawFrame(PixelFormat format, const unsigned char * data, int stride, int width, int height)
+{
+  delete _image;
+  _image = nullptr;
+  _pixelFormat = format;
+  _rawData = data;
+  _rawStride = stride;
+  _width = width;
+  _height = height;
+  ++_generation;
+  stampFrame();
+}
+
+void ImageSource::setFrameInfo(qint64 timestamp, quint64 sequence)
+{
+  _frameInfo.timestamp = timestamp;
+  _frameInfo.sequence = sequence;
+}
+
+void ImageSource::stampFrame()
+{
+  _frameInfo.timestamp = monotonicTime();
+  ++_frameInfo.sequence;
+}
+
+void ImageSource::skipFrames(int count)
+{
+  while (count-- > 0) {
+    capture();
+  }
+}
+
+bool ImageSource::isFrameIntact() const
+{
+  return true;
+}
+
+const ImageSource::FrameInfo & ImageSource::frameInfo() const
+{
+  return _frameInfo;
+}
+
+qint64 ImageSource::monotonicTime()
+{
+  // CLOCK_MONOTONIC on Linux, as V4L2 buffer timestamps
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 int ImageSource::width() const
 {
   return _width;
@@ -100,3 +201,8 @@ QSize ImageSource::size() const
 {
   return QSize(_width, _height);
 }
+
+unsigned int ImageSource::generation() const
+{
+  return _generation;
+}
@@ -48,14 +48,15 @@
 #include <QFrame>
 #include <QLayout>
 #include <QMouseEvent>
-#include <QMutexLocker>
 #include <QPainter>
 #include <QRect>
 #include <QThread>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include "Common.h"
 #include "OverrideCursor.h"
+#include "Tracing.h"
 
 ImageView::ImageView(QWidget * parent) : QWidget(parent)
 {
@@ -68,6 +69,27 @@ ImageView::ImageView(QWidget * parent) : QWidget(parent)
   _scaleFactor = 1.0;
   _zoomOriginal = false;
   _movedKeypointIndex = -1;
+  _frameCounterVisible = false;
+  _frameInfo = ImageSource::FrameInfo();
+}
+
+void ImageView::setFrameCounterVisible(bool on)
+{
+  _frameCounterVisible = on;
+  update();
+}
+
+void ImageView::setFrameInfo(const ImageSource::FrameInfo & frame)
+{
+  _frameInfo = frame;
+}
+
+void ImageView::setPerformanceOverlay(const QStringList & lines)
+{
+  if (lines != _performanceLines) {
+    _performanceLines = lines;
+    update();
+  }
 }
 
 void ImageView::setImageSize(int width, int height)
@@ -82,12 +104,15 @@ void ImageView::setBackgroundColor(QColor color)
 
 void ImageView::paintEvent(QPaintEvent *)
 {
+  Tracing::Span span("paint");
   QPainter painter(this);
-  QMutexLocker locker(&_imageMutex);
+  Tracing::Locker locker(&_imageMutex, "image mutex");
   if (_image.size() == size()) {
     painter.drawImage(0, 0, _image);
     _imagePosition = rect();
     _scaleFactor = 1.0;
+    paintFrameCounter(painter);
+    paintPerformanceOverlay(painter);
     return;
   }
   if (_backgroundColor.isValid()) {
@@ -108,6 +133,8 @@ void ImageView::paintEvent(QPaintEvent *)
     painter.drawImage(_imagePosition.topLeft(), scaled);
   }
   paintKeypoints(painter);
+  paintFrameCounter(painter);
+  paintPerformanceOverlay(painter);
 }
 
 void ImageView::mousePressEvent(QMouseEvent * e)
@@ -117,6 +144,7 @@ void ImageView::mousePressEvent(QMouseEvent * e)
     if (index != -1) {
       _movedKeypointIndex = index;
       _keypointTimestamp.start();
+      emit interactionChanged(true);
       if (!_keypoints[index].keepOpacityWhenSelected) {
         update();
       }
@@ -140,6 +168,8 @@ void ImageView::mouseReleaseEvent(QMouseEvent * e)
       KeypointList::Keypoint & kp = _keypoints[_movedKeypointIndex];
       kp.setPosition(p);
       _movedKeypointIndex = -1;
+      // Interaction ends first, so that the final position is rendered at full quality
+      emit interactionChanged(false);
       emit keypointPositionsChanged();
     }
     e->accept();
@@ -258,6 +288,48 @@ QRect ImageView::imagePosition()
   return _imagePosition;
 }
 
+void ImageView::paintFrameCounter(QPainter & painter)
+{
+  if (!_frameCounterVisible) {
+    return;
+  }
+  // With the camera filming the screen, the clock shown in the filtered image lags
+  // behind the live one by the glass to glass latency.
+  const qint64 now = ImageSource::monotonicTime();
+  QString text = QString("#%1  %2 ms").arg(_frameInfo.sequence).arg((now / 1000) % 100000, 5, 10, QChar('0'));
+  if (_frameInfo.timestamp) {
+    text += QString("  +%1 ms").arg((now - _frameInfo.timestamp) / 1000);
+  }
+  QFont font = painter.font();
+  font.setPixelSize(std::max(16, height() / 15));
+  font.setBold(true);
+  painter.setFont(font);
+  QRect box = painter.fontMetrics().boundingRect(text).adjusted(-6, -4, 6, 4);
+  box.moveTopLeft(QPoint(8, 8));
+  painter.fillRect(box, Qt::black);
+  painter.setPen(Qt::white);
+  painter.drawText(box, Qt::AlignCenter, text);
+}
+
+void ImageView::paintPerformanceOverlay(QPainter & painter)
+{
+  if (_performanceLines.isEmpty()) {
+    return;
+  }
+  QFont font = painter.font();
+  font.setFamily("monospace");
+  font.setStyleHint(QFont::TypeWriter);
+  font.setPixelSize(std::max(11, height() / 40));
+  font.setBold(false);
+  painter.setFont(font);
+  const QString text = _performanceLines.join("\n");
+  QRect box = painter.fontMetrics().boundingRect(QRect(0, 0, width(), height()), Qt::AlignLeft | Qt::AlignTop, text).adjusted(-6, -4, 6, 4);
+  box.moveTopRight(QPoint(width() - 8, 8));
+  painter.fillRect(box, QColor(0, 0, 0, 180));
+  painter.setPen(Qt::white);
+  painter.drawText(box.adjusted(6, 4, -6, -4), Qt::AlignLeft | Qt::AlignTop, text);
+}
+
 void ImageView::paintKeypoints(QPainter & painter)
 {
   QPen pen;
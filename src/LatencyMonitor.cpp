@@ -0,0 +1,108 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   LatencyMonitor.cpp
+ * @date   Oct 2026
+ * @brief  Definition of the class LatencyMonitor
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "LatencyMonitor.h"
+#include <algorithm>
+
+LatencyMonitor::LatencyMonitor()
+{
+  reset();
+}
+
+void LatencyMonitor::reset()
+{
+  _latencies.clear();
+  _latencies.reserve(WindowSize);
+  _next = 0;
+  _hasLastFrame = false;
+  _dropped = 0;
+  _duplicated = 0;
+}
+
+void LatencyMonitor::frameDisplayed(const ImageSource::FrameInfo & frame, qint64 displayTime, int frameSkip)
+{
+  if (!frame.timestamp) {
+    return;
+  }
+  if (_hasLastFrame && frame.sourceId == _lastFrame.sourceId) {
+    if (frame.sequence == _lastFrame.sequence) {
+      // Same frame again (e.g. progressive rendering): its latency is already known
+      ++_duplicated;
+      return;
+    }
+    // A lower sequence number means the source was restarted
+    const quint64 expected = _lastFrame.sequence + 1 + static_cast<quint64>(std::max(0, frameSkip));
+    if (frame.sequence > expected) {
+      _dropped += frame.sequence - expected;
+    }
+  }
+  _lastFrame = frame;
+  _hasLastFrame = true;
+  const float latency = (displayTime - frame.timestamp) / 1000.0f;
+  if (_latencies.size() < WindowSize) {
+    _latencies.push_back(latency);
+  } else {
+    _latencies[_next] = latency;
+  }
+  _next = (_next + 1) % WindowSize;
+}
+
+LatencyMonitor::Statistics LatencyMonitor::statistics() const
+{
+  Statistics stats;
+  stats.frames = _latencies.size();
+  stats.dropped = _dropped;
+  stats.duplicated = _duplicated;
+  stats.p50 = stats.p95 = stats.p99 = 0.0f;
+  if (_latencies.isEmpty()) {
+    return stats;
+  }
+  QVector<float> sorted = _latencies;
+  std::sort(sorted.begin(), sorted.end());
+  const int last = sorted.size() - 1;
+  stats.p50 = sorted[std::min(last, static_cast<int>(0.50f * sorted.size()))];
+  stats.p95 = sorted[std::min(last, static_cast<int>(0.95f * sorted.size()))];
+  stats.p99 = sorted[std::min(last, static_cast<int>(0.99f * sorted.size()))];
+  return stats;
+}
@@ -43,6 +43,7 @@
  * The fact that you are presently reading this means that you have had
  * knowledge of the CeCILL license and that you accept its terms.
  */
+#include <algorithm>
 #include <iostream>
 
 #include <QAction>
@@ -60,6 +61,7 @@
 #include <QKeySequence>
 #include <QLabel>
 #include <QList>
+#include <QMenu>
 #include <QMessageBox>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
@@ -76,11 +78,16 @@
 #include "DialogAbout.h"
 #include "DialogLicense.h"
 #include "FilterThread.h"
+#include "FrameSink.h"
 #include "FullScreenWidget.h"
 #include "ImageConverter.h"
 #include "ImageView.h"
 #include "MainWindow.h"
+#include "MetricsReporter.h"
+#include "MjpegServer.h"
 #include "OutputWindow.h"
+#include "Recorder.h"
+#include "Tracing.h"
 #include "TreeWidgetPresetItem.h"
 #include "WebcamSource.h"
 
@@ -90,7 +97,7 @@
 #define CURRENTDATA(CBOX) (CBOX->itemData(CBOX->currentIndex()))
 #endif
 
-MainWindow::MainWindow(QWidget * parent) : QMainWindow(parent), _filterThread(nullptr), _source(Webcam), _currentSource(&_webcam), _currentDir("."), _zeroFPS(false), _presetsCount(0)
+MainWindow::MainWindow(QWidget * parent) : QMainWindow(parent), _filterThread(nullptr), _source(Webcam), _currentSource(&_webcam), _currentDir("."), _interacting(false), _pendingParameters(false), _mouseX(-1), _mouseY(-1), _mouseButtons(0), _forceCameraListUpdate(false), _openWebcamWhenProbed(false), _zeroFPS(false), _presetsCount(0)
 {
   setupUi(this);
 
@@ -117,10 +124,28 @@ MainWindow::MainWindow(QWidget * parent) : QMainWindow(parent), _filterThread(nu
   connect(_fullScreenWidget, SIGNAL(escapePressed()), this, SLOT(toggleFullScreenMode()));
   connect(_fullScreenWidget->imageView(), SIGNAL(keypointPositionsChanged()), this, SLOT(onFullScreenKeypointsEvent()));
   connect(_fullScreenWidget->imageView(), SIGNAL(resized(QSize)), this, SLOT(fullScreenImageViewResized(QSize)));
+  connect(_fullScreenWidget->imageView(), SIGNAL(interactionChanged(bool)), this, SLOT(onInteractionChanged(bool)));
 
   _displayMode = InWindow;
 
   QSettings settings;
+  _renderCache.setMaximumSize(static_cast<size_t>(settings.value("RenderCache/MaximumSizeMB", static_cast<int>(RenderCache::DefaultMaximumBytes >> 20)).toInt()) << 20);
+
+  // While a parameter or a keypoint is dragged, frames are rendered at a reduced scale
+  // until the interaction ends or stays idle for a while.
+  _interactionIdleTimer.setSingleShot(true);
+  _interactionIdleTimer.setInterval(settings.value("Interaction/IdleDelay", 300).toInt());
+  connect(&_interactionIdleTimer, SIGNAL(timeout()), this, SLOT(onInteractionIdle()));
+
+  // Parameter and mouse changes are coalesced into at most one render request per event loop iteration
+  _renderRequestTimer.setSingleShot(true);
+  _renderRequestTimer.setInterval(0);
+  connect(&_renderRequestTimer, SIGNAL(timeout()), this, SLOT(flushRenderRequest()));
+
+  _latencyReportTimer.setInterval(1000);
+  connect(&_latencyReportTimer, SIGNAL(timeout()), this, SLOT(showLatencyStatistics()));
+  connect(&_latencyReportTimer, SIGNAL(timeout()), this, SLOT(updatePerformanceOverlay()));
+  _performanceOverlay = false;
 
   // Menu and actions
   QMenu * menu;
@@ -134,6 +159,34 @@ MainWindow::MainWindow(QWidget * parent) : QMainWindow(parent), _filterThread(nu
   menu->addAction(action);
   connect(action, SIGNAL(triggered()), this, SLOT(savePresetsFile()));
 
+  menu->addSeparator();
+  _recorder = nullptr;
+  _frameSink = nullptr;
+  _displaySubscription = _frameBus.subscribe(FrameBus::Output, 1, FrameBus::DropOldest);
+  _recordAction = new QAction("&Record output...", this);
+  _recordAction->setShortcut(QKeySequence("Ctrl+Shift+R"));
+  _recordAction->setCheckable(true);
+#if QT_VERSION >= 0x040600
+  _recordAction->setIcon(QIcon::fromTheme("media-record"));
+#endif
+  connect(_recordAction, SIGNAL(toggled(bool)), this, SLOT(onRecordAction(bool)));
+  menu->addAction(_recordAction);
+  _recordCodecMenu = menu->addMenu("Recording &codec");
+  connect(_recordCodecMenu, SIGNAL(aboutToShow()), this, SLOT(updateRecordMenus()));
+  connect(_recordCodecMenu, SIGNAL(triggered(QAction *)), this, SLOT(onRecordCodecChosen(QAction *)));
+  _recordPolicyMenu = menu->addMenu("When the &encoder falls behind");
+  connect(_recordPolicyMenu, SIGNAL(aboutToShow()), this, SLOT(updateRecordMenus()));
+  connect(_recordPolicyMenu, SIGNAL(triggered(QAction *)), this, SLOT(onRecordPolicyChosen(QAction *)));
+  _mjpegServer = nullptr;
+  _mjpegRate = 0.0; // From the settings unless given on the command line
+  _mjpegQuality = -1;
+  _metricsReporter = nullptr;
+  _mjpegAction = new QAction("Serve output over &HTTP (MJPEG)...", this);
+  _mjpegAction->setCheckable(true);
+  connect(_mjpegAction, SIGNAL(toggled(bool)), this, SLOT(onMjpegAction(bool)));
+  menu->addAction(_mjpegAction);
+  menu->addSeparator();
+
   action = new QAction("&Quit", this);
   action->setShortcut(QKeySequence::Quit);
 #if QT_VERSION >= 0x040600
@@ -155,10 +208,12 @@ MainWindow::MainWindow(QWidget * parent) : QMainWindow(parent), _filterThread(nu
 
   connect(_tbCamResolutionsRefresh, SIGNAL(clicked(bool)), this, SLOT(onRefreshCameraResolutions()));
 
-  // Find available cameras, and setup the default one
-  QList<int> cameras = WebcamSource::getWebcamList();
-  int firstUnused = WebcamSource::getFirstUnusedWebcam();
-  initGUIFromCameraList(cameras, firstUnused);
+  // Cameras are detected in the background (see onCamerasDiscovered()), and again whenever a device is plugged or unplugged.
+  initGUIFromCameraList(WebcamSource::getCachedWebcamList(), -1);
+  connect(&_cameraDiscovery, SIGNAL(camerasDiscovered()), this, SLOT(onCamerasDiscovered()));
+  connect(&_cameraDiscovery, SIGNAL(backendsProbed()), this, SLOT(onBackendsProbed()));
+  _cameraDiscovery.setHotplugEnabled(true);
+  _cameraDiscovery.discover();
 
   QSize cameraSize = CURRENTDATA(_comboCamResolution).toSize();
   if (!cameraSize.isValid()) {
@@ -185,8 +240,34 @@ MainWindow::MainWindow(QWidget * parent) : QMainWindow(parent), _filterThread(nu
   connect(_outputWindowAction, SIGNAL(toggled(bool)), this, SLOT(onOutputWindow(bool)));
   menu->addAction(_outputWindowAction);
 
+  action = menu->addAction("&Greyscale input", this, SLOT(onLumaOnlyInput(bool)));
+  action->setCheckable(true);
+  action->setChecked(settings.value("LumaOnlyInput", false).toBool());
+
+  action = menu->addAction("Frame coun&ter overlay", this, SLOT(onFrameCounterOverlay(bool)));
+  action->setCheckable(true);
+  action->setChecked(settings.value("FrameCounterOverlay", false).toBool());
+  onFrameCounterOverlay(action->isChecked());
+
+  action = menu->addAction("Per&formance overlay", this, SLOT(onPerformanceOverlay(bool)), QKeySequence("Ctrl+I"));
+  action->setCheckable(true);
+  action->setChecked(settings.value("PerformanceOverlay", false).toBool());
+  onPerformanceOverlay(action->isChecked());
+
+  // Already started by --trace
+  action = menu->addAction("Record a &trace", this, SLOT(onTraceAction(bool)));
+  action->setCheckable(true);
+  action->setChecked(Tracing::isEnabled());
+
   menu->addSeparator();
   action = menu->addAction("Detect &cameras", this, SLOT(onDetectCameras()));
+  // Both are filled for the current camera when shown
+  _captureBackendMenu = menu->addMenu("Capture &backend");
+  connect(_captureBackendMenu, SIGNAL(aboutToShow()), this, SLOT(updateCaptureMenus()));
+  connect(_captureBackendMenu, SIGNAL(triggered(QAction *)), this, SLOT(onCaptureBackendChosen(QAction *)));
+  _bufferSizeMenu = menu->addMenu("Driver b&uffers");
+  connect(_bufferSizeMenu, SIGNAL(aboutToShow()), this, SLOT(updateCaptureMenus()));
+  connect(_bufferSizeMenu, SIGNAL(triggered(QAction *)), this, SLOT(onBufferSizeChosen(QAction *)));
   menu->addSeparator();
 
   // Presets
@@ -278,6 +359,8 @@ MainWindow::MainWindow(QWidget * parent) : QMainWindow(parent), _filterThread(nu
 
   connect(_imageView, SIGNAL(keypointPositionsChanged()), this, SLOT(onImageViewKeypointsEvent()));
 
+  connect(_imageView, SIGNAL(interactionChanged(bool)), this, SLOT(onInteractionChanged(bool)));
+
   connect(_imageView, SIGNAL(resized(QSize)), this, SLOT(imageViewResized(QSize)));
 
   connect(_treeGPresets, SIGNAL(itemClicked(QTreeWidgetItem *, int)), this, SLOT(presetClicked(QTreeWidgetItem *, int)));
@@ -303,11 +386,27 @@ MainWindow::MainWindow(QWidget * parent) : QMainWindow(parent), _filterThread(nu
 
   _cbVideoFileLoop->setChecked(true);
   _videoFile.setLoop(true);
+  _imageSequence.setLoop(true);
   connect(_cbVideoFileLoop, SIGNAL(toggled(bool)), this, SLOT(onVideoFileLoop(bool)));
 
+  _cbVideoPlaybackClock->setChecked(settings.value("VideoFileSource/PlaybackClock", false).toBool());
+  onVideoPlaybackClock(_cbVideoPlaybackClock->isChecked());
+  connect(_cbVideoPlaybackClock, SIGNAL(toggled(bool)), this, SLOT(onVideoPlaybackClock(bool)));
+
+  _sliderVideoPosition->setRange(0, 0);
+  connect(_sliderVideoPosition, SIGNAL(valueChanged(int)), this, SLOT(onVideoPositionChanged(int)));
+  connect(_sliderVideoPosition, SIGNAL(sliderReleased()), this, SLOT(onVideoPositionReleased()));
+  _videoSeekTimer.setSingleShot(true);
+  _videoSeekTimer.setInterval(100);
+  connect(&_videoSeekTimer, SIGNAL(timeout()), this, SLOT(seekVideo()));
+  _videoPositionTimer.setInterval(250);
+  connect(&_videoPositionTimer, SIGNAL(timeout()), this, SLOT(updateVideoPosition()));
+  _videoPositionTimer.start();
+
   _webcamParamsWidget->setVisible(_source == Webcam);
   _imageParamsWidget->setVisible(_source == StillImage);
-  _videoParamsWidget->setVisible(_source == Video);
+  _videoParamsWidget->setVisible(_source == Video || _source == ImageSequence);
+  _cbVideoPlaybackClock->setVisible(_source == Video);
 
   connect(_pbOpenImageFile, SIGNAL(clicked()), this, SLOT(onOpenImageFile()));
   connect(_pbOpenVideoFile, SIGNAL(clicked()), this, SLOT(onOpenVideoFile()));
@@ -338,17 +437,12 @@ MainWindow::MainWindow(QWidget * parent) : QMainWindow(parent), _filterThread(nu
 
   connect(_commandParamsWidget, SIGNAL(valueChanged()), this, SLOT(onCommandParametersChanged()));
   connect(_fullScreenWidget->commandParamsWidget(), SIGNAL(valueChanged()), this, SLOT(onCommandParametersChangedFullScreen()));
+  connect(_commandParamsWidget, SIGNAL(interactionChanged(bool)), this, SLOT(onInteractionChanged(bool)));
+  connect(_fullScreenWidget->commandParamsWidget(), SIGNAL(interactionChanged(bool)), this, SLOT(onInteractionChanged(bool)));
 
   if (!settings.value("showRightPanel", true).toBool())
     _rightPanel->hide();
 
-  if (_comboWebcam->count()) {
-    _webcam.setCameraIndex(CURRENTDATA(_comboWebcam).toInt());
-    // Update actual source capture size
-    _webcam.start();
-    _webcam.stop();
-  }
-
   // Favorites
 #if QT_VERSION >= 0x040600
   _tbAddFave->setIcon(QIcon::fromTheme("list-add", QIcon(":/images/list-add.png")));
@@ -384,10 +478,7 @@ MainWindow::MainWindow(QWidget * parent) : QMainWindow(parent), _filterThread(nu
 MainWindow::~MainWindow()
 {
   QSettings settings;
-  for (int i = 0; i < _cameraDefaultResolutionsIndexes.size(); ++i) {
-    const int index = _cameraDefaultResolutionsIndexes[i];
-    settings.setValue(QString("WebcamSource/DefaultResolutionCam%1").arg(i), (index == -1) ? QSize() : WebcamSource::webcamResolutions(i).at(index));
-  }
+  saveCameraDefaultResolutions();
   settings.remove("Faves");
   settings.setValue("Faves/Count", _cbFaves->count());
   for (int i = 0; i < _cbFaves->count(); ++i) {
@@ -399,6 +490,10 @@ MainWindow::~MainWindow()
     _filterThread->wait();
     delete _filterThread;
   }
+  stopRecording();
+  delete _mjpegServer;
+  delete _metricsReporter;
+  delete _frameSink;
   delete _fullScreenWidget;
   if (_outputWindow) {
     delete _outputWindow;
@@ -417,6 +512,9 @@ void MainWindow::setCurrentPreset(QDomNode node)
     _commandEditor->setPlainText(text);
   }
   _currentPresetNode = node;
+  if (_metricsReporter) {
+    _metricsReporter->setPreset(node.attributes().namedItem("name").nodeValue());
+  }
   if (_displayMode == FullScreen) {
     _fullScreenWidget->commandParamsWidget()->saveValuesInDOM();
     _fullScreenWidget->commandParamsWidget()->build(node);
@@ -432,7 +530,7 @@ void MainWindow::showOneSourceImage()
   _currentSource->capture();
   cv::Mat * image = _currentSource->image();
   if (image) {
-    _imageView->imageMutex().lock();
+    Tracing::lock(_imageView->imageMutex(), "image mutex");
     QSize size(image->cols, image->rows);
     if (_imageView->image().size() != size) {
       _imageView->image() = QImage(size, QImage::Format_RGB888);
@@ -497,6 +595,33 @@ void MainWindow::updateKeypointsInViews()
 
 void MainWindow::onImageAvailable()
 {
+  // Frames published while the views were busy are skipped
+  const FrameBus::FramePtr frame = _displaySubscription->takeLatest();
+  if (!frame) {
+    return;
+  }
+  Tracing::Span span("display");
+  const qint64 paintStart = ImageSource::monotonicTime();
+  _frameTimings.record(FrameTimings::QueueWait, paintStart - frame->published);
+  ImageView * viewA = (_displayMode == InWindow) ? _imageView : _fullScreenWidget->imageView();
+  ImageView * viewB = nullptr;
+  if (_outputWindow && _outputWindow->isVisible() && _outputWindowAction->isChecked()) {
+    viewB = _outputWindow->imageView();
+  }
+  // Shared with the other consumers of the frame
+  Tracing::lock(viewA->imageMutex(), "image mutex");
+  viewA->image() = frame->image;
+  viewA->imageMutex().unlock();
+  if (viewB) {
+    Tracing::lock(viewB->imageMutex(), "image mutex");
+    viewB->image() = frame->image;
+    viewB->imageMutex().unlock();
+  }
+  _imageView->setFrameInfo(frame->info);
+  _fullScreenWidget->imageView()->setFrameInfo(frame->info);
+  if (_outputWindow) {
+    _outputWindow->imageView()->setFrameInfo(frame->info);
+  }
   if (_displayMode == InWindow) {
     _imageView->checkSize();
     _imageView->repaint();
@@ -505,39 +630,110 @@ void MainWindow::onImageAvailable()
     _fullScreenWidget->imageView()->checkSize();
     _fullScreenWidget->imageView()->repaint();
   }
-  if (_outputWindow && _outputWindow->isVisible() && _outputWindowAction->isChecked()) {
-    _outputWindow->imageView()->checkSize();
-    _outputWindow->imageView()->repaint();
+  if (viewB) {
+    viewB->checkSize();
+    viewB->repaint();
+  }
+  _frameTimings.record(FrameTimings::Paint, ImageSource::monotonicTime() - paintStart);
+  if (_source == StillImage) {
+    showRenderCacheStatistics();
+  } else {
+    // repaint() returns once the views are drawn
+    _latencyMonitor.frameDisplayed(frame->info, ImageSource::monotonicTime(), _filterThread ? _filterThread->frameSkip() : 0);
+  }
+  if (_recorder) {
+    if (_recorder->hasFailed()) {
+      stopRecording();
+    }
+  }
+}
+
+void MainWindow::showLatencyStatistics()
+{
+  if (_source == StillImage || !_filterThread) {
+    return;
+  }
+  const LatencyMonitor::Statistics stats = _latencyMonitor.statistics();
+  if (stats.frames) {
+    QString message = QString("Capture to display: %1 / %2 / %3 ms (p50/p95/p99), %4 dropped, %5 duplicated")
+                          .arg(stats.p50, 0, 'f', 1)
+                          .arg(stats.p95, 0, 'f', 1)
+                          .arg(stats.p99, 0, 'f', 1)
+                          .arg(stats.dropped)
+                          .arg(stats.duplicated);
+    // Where the time goes: source, filter or display
+    const FrameTimings::Stage slowest = _frameTimings.slowestStage();
+    if (slowest != FrameTimings::StageCount) {
+      message += QString(", slowest stage: %1 %2 ms").arg(FrameTimings::stageName(slowest)).arg(_frameTimings.statistics(slowest).p50, 0, 'f', 1);
+    }
+    statusBar()->showMessage(message);
+  }
+}
+
+void MainWindow::updatePerformanceOverlay()
+{
+  const QStringList lines = _performanceOverlay ? _frameTimings.table() : QStringList();
+  _imageView->setPerformanceOverlay(lines);
+  _fullScreenWidget->imageView()->setPerformanceOverlay(lines);
+  if (_outputWindow) {
+    _outputWindow->imageView()->setPerformanceOverlay(lines);
   }
 }
 
+void MainWindow::showRenderCacheStatistics()
+{
+  RenderCache::Statistics stats = _renderCache.statistics();
+  statusBar()->showMessage(QString("Render cache: %1 hit(s), %2 miss(es), %3 image(s), %4/%5 MB")
+                               .arg(stats.hits)
+                               .arg(stats.misses)
+                               .arg(stats.entries)
+                               .arg(stats.bytes >> 20)
+                               .arg(stats.maximumBytes >> 20));
+}
+
 void MainWindow::play()
 {
   int pm = _cbPreviewMode->itemData(_cbPreviewMode->currentIndex()).toInt();
   FilterThread::PreviewMode previewMode = static_cast<FilterThread::PreviewMode>(pm);
-  ImageView * viewA = (_displayMode == InWindow) ? _imageView : _fullScreenWidget->imageView();
-  ImageView * viewB = nullptr;
-  if (_outputWindow && _outputWindow->isVisible() && _outputWindowAction->isChecked()) {
-    viewB = _outputWindow->imageView();
-  }
 
   switch (_source) {
   case Webcam:
-    _filterThread = new FilterThread(_webcam, _commandEditor->toPlainText(), &viewA->image(), &viewA->imageMutex(), (viewB) ? &viewB->image() : nullptr, (viewB) ? &viewB->imageMutex() : nullptr,
-                                     previewMode, _sliderWebcamSkipFrames->value(), -1, nullptr);
+    _filterThread = new FilterThread(_webcam, _commandEditor->toPlainText(), _frameBus, previewMode, _sliderWebcamSkipFrames->value(), -1, nullptr);
     break;
   case StillImage:
-    _filterThread = new FilterThread(_stillImage, _commandEditor->toPlainText(), &viewA->image(), &viewA->imageMutex(), (viewB) ? &viewB->image() : nullptr, (viewB) ? &viewB->imageMutex() : nullptr,
-                                     previewMode, 0, _sliderImageFPS->value(), &_filterThreadSemaphore);
+    _filterThread = new FilterThread(_stillImage, _commandEditor->toPlainText(), _frameBus, previewMode, 0, _sliderImageFPS->value(), &_filterThreadSemaphore);
+    _filterThread->setRenderCache(&_renderCache);
+    _filterThread->setProgressiveRendering(QSettings().value("ProgressiveRendering", true).toBool());
     break;
   case Video:
-    _filterThread = new FilterThread(_videoFile, _commandEditor->toPlainText(), &viewA->image(), &viewA->imageMutex(), (viewB) ? &viewB->image() : nullptr, (viewB) ? &viewB->imageMutex() : nullptr,
-                                     previewMode, _sliderVideoSkipFrames->value(), _sliderVideoFPS->value(), nullptr);
+    // The playback clock starts with the first frame rendered
+    _videoFile.pauseClock();
+    if (_cbVideoPlaybackClock->isChecked()) {
+      _filterThread = new FilterThread(_videoFile, _commandEditor->toPlainText(), _frameBus, previewMode, 0, 0, nullptr);
+    } else {
+      _filterThread = new FilterThread(_videoFile, _commandEditor->toPlainText(), _frameBus, previewMode, _sliderVideoSkipFrames->value(), _sliderVideoFPS->value(), nullptr);
+    }
+    break;
+  case ImageSequence:
+    _filterThread = new FilterThread(_imageSequence, _commandEditor->toPlainText(), _frameBus, previewMode, _sliderVideoSkipFrames->value(), _sliderVideoFPS->value(), nullptr);
+    break;
+  case Stream:
+    // Paced by the producer, as a webcam
+    _filterThread = new FilterThread(_rawStream, _commandEditor->toPlainText(), _frameBus, previewMode, 0, -1, nullptr);
+    break;
+  case Screen:
+    // Paced by the source, at its own frame rate
+    _filterThread = new FilterThread(_screen, _commandEditor->toPlainText(), _frameBus, previewMode, 0, -1, nullptr);
     break;
   }
   connect(_filterThread, SIGNAL(imageAvailable()), this, SLOT(onImageAvailable()));
   connect(_filterThread, SIGNAL(finished()), this, SLOT(onFilterThreadFinished()));
   connect(_filterThread, SIGNAL(endOfCapture()), this, SLOT(onEndOfSource()));
+  _filterThread->setInteractionScale(QSettings().value("Interaction/Scale", 0.5).toFloat());
+  _filterThread->setLumaOnly(QSettings().value("LumaOnlyInput", false).toBool());
+  if (_recorder) {
+    _filterThread->setOutputThrottle(_recorder->throttlingSubscription());
+  }
   if (_displayMode == FullScreen) {
     _filterThread->setArguments(_fullScreenWidget->commandParamsWidget()->valueString());
   } else {
@@ -547,10 +743,18 @@ void MainWindow::play()
   if (_outputWindow && _outputWindow->isVisible()) {
     outputWindowImageViewResized(_outputWindow->imageView()->size());
   }
-  if (_source == StillImage) {
-    _filterThreadSemaphore.release();
-  }
+  _filterThread->setMousePosition(_mouseX, _mouseY, _mouseButtons);
+  // Requests and frames left by a previous thread are obsolete
+  _filterThreadSemaphore.tryAcquire(_filterThreadSemaphore.available());
+  _displaySubscription->clear();
+  _latencyMonitor.reset();
+  _frameTimings.reset();
+  _filterThread->setFrameTimings(&_frameTimings);
+  _latencyReportTimer.start();
   updateKeypointsInViews();
+  if (_metricsReporter) {
+    _metricsReporter->setFilterThread(_filterThread);
+  }
   _filterThread->start();
 }
 
@@ -560,8 +764,24 @@ void MainWindow::stop()
     _filterThread->stop();
     _filterThreadSemaphore.release();
     _filterThread->wait();
+    if (_metricsReporter) {
+      // Deleted once its finished() signal is handled
+      _metricsReporter->setFilterThread(nullptr);
+    }
     _filterThread = nullptr;
   }
+  _videoFile.pauseClock();
+  _latencyReportTimer.stop();
+  const LatencyMonitor::Statistics stats = _latencyMonitor.statistics();
+  if (stats.frames) {
+    std::cout << "[ZArt] Capture to display latency over the last " << stats.frames << " frame(s): p50 " << stats.p50 << " ms, p95 " << stats.p95 << " ms, p99 " << stats.p99 << " ms, "
+              << stats.dropped << " dropped, " << stats.duplicated << " duplicated" << std::endl;
+    _latencyMonitor.reset();
+  }
+  const QString timings = _frameTimings.summary();
+  if (!timings.isEmpty()) {
+    std::cout << "[ZArt] Frame stages (p50/p95/max): " << timings.toLocal8Bit().constData() << std::endl;
+  }
 }
 
 void MainWindow::onEndOfSource()
@@ -576,34 +796,92 @@ void MainWindow::onFilterThreadFinished()
 
 void MainWindow::onCommandParametersChanged()
 {
-  if (_filterThread) {
-    _filterThread->setArguments(_commandParamsWidget->valueString());
-    if (_source == StillImage && _zeroFPS)
-      _filterThreadSemaphore.release();
+  if (_interacting) {
+    setInteractionLOD(true);
+    _interactionIdleTimer.start();
+  }
+  if (_displayMode == InWindow) {
+    _pendingParameters = true;
+    requestRender();
   }
-  updateKeypointsInViews();
 }
 
 void MainWindow::onCommandParametersChangedFullScreen()
 {
+  if (_interacting) {
+    setInteractionLOD(true);
+    _interactionIdleTimer.start();
+  }
+  if (_displayMode == FullScreen) {
+    _pendingParameters = true;
+    requestRender();
+  }
+}
+
+void MainWindow::requestRender()
+{
+  if (!_renderRequestTimer.isActive()) {
+    _renderRequestTimer.start();
+  }
+}
+
+void MainWindow::flushRenderRequest()
+{
+  // Only the latest parameters and mouse state matter, whatever the number
+  // of events received since the previous flush.
+  if (_pendingParameters) {
+    _pendingParameters = false;
+    if (_filterThread) {
+      CommandParamsWidget * params = (_displayMode == FullScreen) ? _fullScreenWidget->commandParamsWidget() : _commandParamsWidget;
+      _filterThread->setArguments(params->valueString());
+    }
+    updateKeypointsInViews();
+  }
   if (_filterThread) {
-    if (_displayMode == FullScreen) {
-      _filterThread->setArguments(_fullScreenWidget->commandParamsWidget()->valueString());
-      if (_source == StillImage && _zeroFPS)
-        _filterThreadSemaphore.release();
+    _filterThread->setMousePosition(_mouseX, _mouseY, _mouseButtons);
+    if (_source == StillImage && _zeroFPS && !_filterThreadSemaphore.available()) {
+      _filterThreadSemaphore.release();
     }
   }
-  updateKeypointsInViews();
+}
+
+void MainWindow::onInteractionChanged(bool active)
+{
+  _interacting = active;
+  if (active) {
+    setInteractionLOD(true);
+    _interactionIdleTimer.start();
+  } else {
+    _interactionIdleTimer.stop();
+    setInteractionLOD(false);
+  }
+}
+
+void MainWindow::onInteractionIdle()
+{
+  setInteractionLOD(false);
+}
+
+void MainWindow::setInteractionLOD(bool on)
+{
+  if (!_filterThread || _filterThread->isInteractive() == on) {
+    return;
+  }
+  _filterThread->setInteractive(on);
+  // Leaving the interaction mode requires one more (full quality) frame
+  if (!on) {
+    requestRender();
+  }
 }
 
 void MainWindow::toggleFullScreenMode()
 {
-  bool running = _filterThread && _filterThread->isRunning();
+  // The filter thread keeps running (and the G'MIC state is preserved): only its outputs are retargeted.
   if (_displayMode == FullScreen) {
     TreeWidgetPresetItem * item = dynamic_cast<TreeWidgetPresetItem *>(_fullScreenWidget->treeWidget()->currentItem());
     _fullScreenWidget->close();
     _displayMode = InWindow;
-    stop();
+    updateFilterThreadOutputs();
     _fullScreenWidget->commandParamsWidget()->saveValuesInDOM();
     _commandParamsWidget->build(_currentPresetNode);
     if (item) {
@@ -612,9 +890,11 @@ void MainWindow::toggleFullScreenMode()
   } else { // InWindow to FullScreen mode
     TreeWidgetPresetItem * item = dynamic_cast<TreeWidgetPresetItem *>(_treeGPresets->currentItem());
     _displayMode = FullScreen;
-    stop();
+    updateFilterThreadOutputs();
     _commandParamsWidget->saveValuesInDOM();
+    Tracing::lock(_fullScreenWidget->imageView()->imageMutex(), "image mutex");
     _fullScreenWidget->imageView()->image() = _imageView->image();
+    _fullScreenWidget->imageView()->imageMutex().unlock();
     _fullScreenWidget->imageView()->zoomFitBest();
     _fullScreenWidget->commandParamsWidget()->build(_currentPresetNode);
     _fullScreenWidget->showFullScreen();
@@ -623,8 +903,27 @@ void MainWindow::toggleFullScreenMode()
       tw->setCurrentItem(findPresetItem(tw, item->path()));
     }
   }
-  if (running) {
-    play();
+  // Arguments are taken from the parameters widget which is now visible
+  _pendingParameters = true;
+  requestRender();
+}
+
+void MainWindow::updateFilterThreadOutputs()
+{
+  if (!_filterThread) {
+    return;
+  }
+  ImageView * viewA = (_displayMode == InWindow) ? _imageView : _fullScreenWidget->imageView();
+  ImageView * viewB = nullptr;
+  if (_outputWindow && _outputWindow->isVisible() && _outputWindowAction->isChecked()) {
+    viewB = _outputWindow->imageView();
+  }
+  if (viewB) {
+    outputWindowImageViewResized(viewB->size());
+  } else if (_displayMode == FullScreen) {
+    fullScreenImageViewResized(viewA->size());
+  } else {
+    imageViewResized(viewA->size());
   }
 }
 
@@ -633,19 +932,31 @@ void MainWindow::onPlayAction(bool on)
   if (!on && _filterThread) {
     stop();
     if (_source == Webcam) {
-      _webcam.stop();
+      releaseWebcamIfIdle();
     }
     changePlayButtonAppearence(false);
     return;
   }
   if (on && !_filterThread) {
-    if ((_source == Video && _videoFile.filename().isEmpty()) || (_source == StillImage && _stillImage.filename().isEmpty())) {
+    if (_source == Stream && !_rawStream.isOpen()) {
+      // Ended by its producer, or never opened
+      onOpenStream();
+    }
+    if (_source == Screen && !_screen.isOpen()) {
+      onOpenScreen();
+    }
+    if ((_source == Stream && !_rawStream.isOpen()) || (_source == Screen && !_screen.isOpen()) || (_source == Video && _videoFile.filename().isEmpty()) ||
+        (_source == StillImage && _stillImage.filename().isEmpty()) || (_source == ImageSequence && !_imageSequence.frameCount())) {
       QMessageBox::information(this, "Information", "No input file.\nPlease select one first.");
       _tabParams->setCurrentIndex(0);
       _startStopAction->setChecked(false);
     } else {
       if (_source == Webcam) {
+        const bool reopened = !_webcam.isStarted();
         _webcam.start();
+        if (reopened && _webcam.timeToFirstFrame() >= 0) {
+          statusBar()->showMessage(QString("Camera ready after %1 ms").arg(_webcam.timeToFirstFrame()), 3000);
+        }
       }
       play();
       changePlayButtonAppearence(true);
@@ -674,16 +985,41 @@ void MainWindow::onComboSourceChanged(int i)
     _currentSource = &_videoFile;
     _webcam.stop();
     break;
+  case ImageSequence:
+    _currentSource = &_imageSequence;
+    _webcam.stop();
+    break;
+  case Stream:
+    _currentSource = &_rawStream;
+    _webcam.stop();
+    break;
+  case Screen:
+    _currentSource = &_screen;
+    _webcam.stop();
+    break;
   }
   _webcamParamsWidget->setVisible(_source == Webcam);
   _imageParamsWidget->setVisible(_source == StillImage);
-  _videoParamsWidget->setVisible(_source == Video);
+  _videoParamsWidget->setVisible(_source == Video || _source == ImageSequence);
+  _cbVideoPlaybackClock->setVisible(_source == Video);
+  if (_recorder) {
+    _recorder->setTimestamps(_source != StillImage);
+  }
   updateWindowTitle();
   if (_source == StillImage && _stillImage.filename().isEmpty() && (!firstRun || WebcamSource::getCachedWebcamList().size())) {
     onOpenImageFile();
   }
   if (_source == Video && _videoFile.filename().isEmpty())
     onOpenVideoFile();
+  if (_source == ImageSequence && !_imageSequence.frameCount())
+    onOpenImageSequence();
+  if (_source == Stream && !_rawStream.isOpen() && !firstRun)
+    onOpenStream();
+  if (_source == Screen && !_screen.isOpen() && !firstRun)
+    onOpenScreen();
+  // The playback clock only applies to video files
+  _sliderVideoFPS->setEnabled(_source != Video || !_cbVideoPlaybackClock->isChecked());
+  _sliderVideoSkipFrames->setEnabled(_source != Video || !_cbVideoPlaybackClock->isChecked());
   if (running) {
     if (_source == Webcam) {
       _webcam.start();
@@ -705,6 +1041,43 @@ void MainWindow::setInputVideo(QString filepath)
   _videoFile.loadVideoFile(filepath);
 }
 
+void MainWindow::setInputSequence(QString path)
+{
+  if (_imageSequence.open(path)) {
+    _source = ImageSequence;
+    _currentSource = &_imageSequence;
+    int index = _comboSource->findData(QVariant(ImageSequence));
+    if (index != -1) {
+      _comboSource->setCurrentIndex(index);
+    }
+  }
+}
+
+void MainWindow::setInputStream(const QString & spec, const QSize & rawSize, const QString & rawFormat)
+{
+  if (_rawStream.open(spec, rawSize, rawFormat)) {
+    _source = Stream;
+    _currentSource = &_rawStream;
+    int index = _comboSource->findData(QVariant(Stream));
+    if (index != -1) {
+      _comboSource->setCurrentIndex(index);
+    }
+  }
+}
+
+void MainWindow::setInputScreen(const QString & spec)
+{
+  _screen.setFrameRate(QSettings().value("ScreenSource/FrameRate", ScreenSource::DefaultFrameRate).toDouble());
+  if (_screen.open(spec)) {
+    _source = Screen;
+    _currentSource = &_screen;
+    int index = _comboSource->findData(QVariant(Screen));
+    if (index != -1) {
+      _comboSource->setCurrentIndex(index);
+    }
+  }
+}
+
 void MainWindow::onOpenImageFile()
 {
   QString filename;
@@ -729,6 +1102,10 @@ void MainWindow::onOpenImageFile()
 
 void MainWindow::onOpenVideoFile()
 {
+  if (_source == ImageSequence) {
+    onOpenImageSequence();
+    return;
+  }
   QString filename;
   filename = QFileDialog::getOpenFileName(this, "Select a video file", _videoFile.filePath().isEmpty() ? _stillImage.filePath() : _videoFile.filePath(),
                                           "Video files (*.avi *.mpg *.mpeg *.flv *.mov *.mp4 *.webm *.mkv *.ts)");
@@ -749,6 +1126,82 @@ void MainWindow::onOpenVideoFile()
   }
 }
 
+void MainWindow::onOpenImageSequence()
+{
+  // Any file of a numbered sequence stands for the whole sequence
+  QString filename;
+  filename = QFileDialog::getOpenFileName(this, "Select one image of the sequence", _imageSequence.filePath().isEmpty() ? _stillImage.filePath() : _imageSequence.filePath(),
+                                          "Image files (*.png *.jpg *.jpeg *.bmp *.tif *.tiff *.ppm *.pgm *.webp)");
+  if (filename.isEmpty())
+    return;
+  if (_source == ImageSequence && _filterThread) {
+    stop();
+    if (_imageSequence.open(filename)) {
+      updateWindowTitle();
+      play();
+    }
+  } else {
+    if (_imageSequence.open(filename)) {
+      updateWindowTitle();
+      showOneSourceImage();
+    }
+  }
+}
+
+void MainWindow::onOpenStream()
+{
+  // Plain video without headers (--raw-size) is only read from the command line
+  QSettings settings;
+  bool ok = false;
+  const QString spec = QInputDialog::getText(this, "Open a stream", "Frames from another process (shm:<name>, fifo:<path> or stdin):", QLineEdit::Normal,
+                                             _rawStream.spec().isEmpty() ? settings.value("RawFrameSource/Spec", "shm:/zart-input").toString() : _rawStream.spec(), &ok);
+  if (!ok || spec.isEmpty()) {
+    return;
+  }
+  const bool running = (_source == Stream) && _filterThread;
+  if (running) {
+    stop();
+  }
+  if (!_rawStream.open(spec)) {
+    QMessageBox::warning(this, "Error", QString("Cannot open %1").arg(spec));
+    return;
+  }
+  settings.setValue("RawFrameSource/Spec", spec);
+  updateWindowTitle();
+  if (running) {
+    play();
+  } else if (_source == Stream) {
+    showOneSourceImage();
+  }
+}
+
+void MainWindow::onOpenScreen()
+{
+  QSettings settings;
+  bool ok = false;
+  const QString spec = QInputDialog::getText(this, "Capture the screen", "Region (screen: for the whole screen, screen:WxH+X+Y or screen:window=<id> as given by xwininfo):",
+                                             QLineEdit::Normal, _screen.spec().isEmpty() ? settings.value("ScreenSource/Spec", "screen:640x480+0+0").toString() : _screen.spec(), &ok);
+  if (!ok || spec.isEmpty()) {
+    return;
+  }
+  const bool running = (_source == Screen) && _filterThread;
+  if (running) {
+    stop();
+  }
+  _screen.setFrameRate(settings.value("ScreenSource/FrameRate", ScreenSource::DefaultFrameRate).toDouble());
+  if (!ScreenSource::isScreen(spec) || !_screen.open(spec)) {
+    QMessageBox::warning(this, "Error", QString("Cannot capture %1").arg(spec));
+    return;
+  }
+  settings.setValue("ScreenSource/Spec", spec);
+  updateWindowTitle();
+  if (running) {
+    play();
+  } else if (_source == Screen) {
+    showOneSourceImage();
+  }
+}
+
 void MainWindow::updateWindowTitle()
 {
   QString name;
@@ -770,12 +1223,96 @@ void MainWindow::updateWindowTitle()
     else
       setWindowTitle(QString("ZArt %1 (%2 %3x%4)").arg(ZART_VERSION_STRING).arg(name).arg(_currentSource->width()).arg(_currentSource->height()));
     break;
+  case ImageSequence:
+    if (!_imageSequence.frameCount())
+      setWindowTitle(QString("ZArt %1 (No input file)").arg(ZART_VERSION_STRING));
+    else
+      setWindowTitle(QString("ZArt %1 (%2, %3 frames %4x%5)")
+                         .arg(ZART_VERSION_STRING)
+                         .arg(_imageSequence.filename())
+                         .arg(_imageSequence.frameCount())
+                         .arg(_currentSource->width())
+                         .arg(_currentSource->height()));
+    break;
+  case Stream:
+    if (!_rawStream.isOpen())
+      setWindowTitle(QString("ZArt %1 (No input stream)").arg(ZART_VERSION_STRING));
+    else
+      setWindowTitle(QString("ZArt %1 (%2 %3x%4)").arg(ZART_VERSION_STRING).arg(_rawStream.spec()).arg(_currentSource->width()).arg(_currentSource->height()));
+    break;
+  case Screen:
+    if (!_screen.isOpen())
+      setWindowTitle(QString("ZArt %1 (No screen region)").arg(ZART_VERSION_STRING));
+    else
+      setWindowTitle(QString("ZArt %1 (%2 %3x%4)").arg(ZART_VERSION_STRING).arg(_screen.spec()).arg(_currentSource->width()).arg(_currentSource->height()));
+    break;
   }
 }
 
 void MainWindow::onVideoFileLoop(bool on)
 {
   _videoFile.setLoop(on);
+  _imageSequence.setLoop(on);
+}
+
+void MainWindow::onVideoPlaybackClock(bool on)
+{
+  QSettings().setValue("VideoFileSource/PlaybackClock", on);
+  _videoFile.setClockMode(on);
+  // Timestamps decide of both
+  _sliderVideoFPS->setEnabled(!on);
+  _sliderVideoSkipFrames->setEnabled(!on);
+  if (_filterThread && _source == Video) {
+    _filterThread->setFPS(on ? 0 : _sliderVideoFPS->value());
+    _filterThread->setFrameSkip(on ? 0 : _sliderVideoSkipFrames->value());
+  }
+}
+
+void MainWindow::onVideoPositionChanged(int)
+{
+  if (!_sliderVideoPosition->isSliderDown()) {
+    // Clicked or keyboard: a single position
+    seekVideo();
+  } else if (!_videoSeekTimer.isActive()) {
+    // Dragged: at most one seek per interval, performed by the decoding threads
+    _videoSeekTimer.start();
+  }
+}
+
+void MainWindow::onVideoPositionReleased()
+{
+  _videoSeekTimer.stop();
+  seekVideo();
+}
+
+void MainWindow::seekVideo()
+{
+  const int position = _sliderVideoPosition->value();
+  if (_source == ImageSequence) {
+    _imageSequence.seek(position);
+  } else {
+    _videoFile.seek(position);
+  }
+  if ((_source == Video || _source == ImageSequence) && !_filterThread && !_sliderVideoPosition->isSliderDown()) {
+    // Not playing: shows the frame once the slider is released, capture() waits for it
+    showOneSourceImage();
+  }
+}
+
+void MainWindow::updateVideoPosition()
+{
+  if ((_source != Video && _source != ImageSequence) || _sliderVideoPosition->isSliderDown()) {
+    return;
+  }
+  _sliderVideoPosition->blockSignals(true);
+  if (_source == ImageSequence) {
+    _sliderVideoPosition->setRange(0, std::max(0, _imageSequence.frameCount() - 1));
+    _sliderVideoPosition->setValue(std::max(0, _imageSequence.position()));
+  } else {
+    _sliderVideoPosition->setRange(0, static_cast<int>(std::max(qint64(0), _videoFile.frameCount() - 1)));
+    _sliderVideoPosition->setValue(static_cast<int>(std::max(qint64(0), _videoFile.position())));
+  }
+  _sliderVideoPosition->blockSignals(false);
 }
 
 void MainWindow::changePlayButtonAppearence(bool on)
@@ -809,12 +1346,10 @@ void MainWindow::imageViewMouseEvent(QMouseEvent * event)
   if (event->buttons() & Qt::MidButton) {
     buttons |= 4;
   }
-  if (_filterThread) {
-    _filterThread->setMousePosition(event->x(), event->y(), buttons);
-  }
-  if (_source == StillImage && _zeroFPS) {
-    _filterThreadSemaphore.release();
-  }
+  _mouseX = event->x();
+  _mouseY = event->y();
+  _mouseButtons = buttons;
+  requestRender();
 }
 
 void MainWindow::imageViewResized(QSize size)
@@ -878,7 +1413,7 @@ void MainWindow::snapshot()
     QFileInfo info(filename);
     _currentDir = info.filePath();
     QImageWriter writer(filename);
-    _imageView->imageMutex().lock();
+    Tracing::lock(_imageView->imageMutex(), "image mutex");
     writer.write(_imageView->image());
     _imageView->imageMutex().unlock();
   }
@@ -909,7 +1444,7 @@ void MainWindow::setImageFPS(int fps)
   if (_filterThread) {
     _filterThread->setFPS(fps);
   }
-  if (_source == StillImage && _zeroFPS) {
+  if (_source == StillImage && _zeroFPS && !_filterThreadSemaphore.available()) {
     _filterThreadSemaphore.release();
   }
   _zeroFPS = !fps;
@@ -947,19 +1482,271 @@ void MainWindow::onWebcamResolutionComboChanged(int i)
   int currentCam = _comboWebcam->currentIndex();
   _cameraDefaultResolutionsIndexes[currentCam] = i;
   QSize resolution = CURRENTDATA(_comboCamResolution).toSize();
-  if (_source == Webcam && _filterThread && _filterThread->isRunning()) {
-    stop();
-    _webcam.setCaptureSize(resolution);
-    play();
-  } else {
-    _webcam.setCaptureSize(resolution);
+  _webcam.setCaptureSize(resolution);
+  // A running capture switches to the new size by itself, between two frames
+  if (!(_source == Webcam && _filterThread && _filterThread->isRunning())) {
     // Update actual source capture size
     _webcam.start();
-    _webcam.stop();
+    _webcam.capture();
+    releaseWebcamIfIdle();
   }
   updateWindowTitle();
 }
 
+void MainWindow::releaseWebcamIfIdle()
+{
+  // Reopening a camera may take a second: by default it is kept streaming
+  if (!QSettings().value("WebcamSource/KeepOpen", true).toBool()) {
+    _webcam.stop();
+  }
+}
+
+void MainWindow::reopenWebcam()
+{
+  const bool running = (_source == Webcam) && _filterThread && _filterThread->isRunning();
+  if (running) {
+    stop();
+  }
+  _webcam.stop();
+  if (_source == Webcam) {
+    _webcam.start();
+    if (running) {
+      play();
+    } else {
+      releaseWebcamIfIdle();
+    }
+  }
+}
+
+void MainWindow::updateCaptureMenus()
+{
+  _captureBackendMenu->clear();
+  _bufferSizeMenu->clear();
+  if (_webcam.cameraIndex() == -1) {
+    _captureBackendMenu->addAction("No camera")->setEnabled(false);
+    _bufferSizeMenu->addAction("No camera")->setEnabled(false);
+    return;
+  }
+  const QString identity = WebcamSource::webcamIdentity(WebcamSource::getCachedWebcamList().indexOf(_webcam.cameraIndex()));
+  if (identity.isEmpty()) {
+    // Could not be told apart from another camera after a hotplug
+    _captureBackendMenu->addAction("Not kept for this camera")->setEnabled(false);
+    _bufferSizeMenu->addAction("Not kept for this camera")->setEnabled(false);
+    return;
+  }
+  QSettings settings;
+
+  const QString choice = settings.value(WebcamSource::settingsKey(identity, "Backend")).toString();
+  QAction * action = _captureBackendMenu->addAction(QString("&Recommended (%1)").arg(WebcamSource::backendName(WebcamSource::recommendedBackend(identity))));
+  action->setCheckable(true);
+  action->setChecked(choice.isEmpty());
+  QList<WebcamSource::Backend> backends;
+  backends << WebcamSource::AnyBackend << WebcamSource::probedBackends();
+  for (WebcamSource::Backend backend : backends) {
+    const QString name = WebcamSource::backendName(backend);
+    action = _captureBackendMenu->addAction(name);
+    action->setData(name);
+    action->setCheckable(true);
+    action->setChecked(!choice.isEmpty() && WebcamSource::backendFromName(choice) == backend);
+  }
+  // Measured when the camera was first detected (see --probe-backends)
+  const QStringList report = settings.value(WebcamSource::settingsKey(identity, "BackendProbe")).toStringList();
+  if (!report.isEmpty()) {
+    _captureBackendMenu->addSeparator();
+    for (const QString & line : report) {
+      _captureBackendMenu->addAction(line)->setEnabled(false);
+    }
+  }
+
+  const int bufferSize = WebcamSource::cameraBufferSize(identity);
+  for (int size = 0; size <= 4; ++size) {
+    action = _bufferSizeMenu->addAction(size ? QString("%1 frame(s)").arg(size) : QString("Driver default"));
+    action->setData(size);
+    action->setCheckable(true);
+    action->setChecked(size == bufferSize);
+  }
+}
+
+void MainWindow::onCaptureBackendChosen(QAction * action)
+{
+  const QString identity = WebcamSource::webcamIdentity(WebcamSource::getCachedWebcamList().indexOf(_webcam.cameraIndex()));
+  const QString key = WebcamSource::settingsKey(identity, "Backend");
+  if (action->data().toString().isEmpty()) {
+    QSettings().remove(key);
+  } else {
+    QSettings().setValue(key, action->data().toString());
+  }
+  reopenWebcam();
+}
+
+void MainWindow::onBufferSizeChosen(QAction * action)
+{
+  const QString identity = WebcamSource::webcamIdentity(WebcamSource::getCachedWebcamList().indexOf(_webcam.cameraIndex()));
+  QSettings().setValue(WebcamSource::settingsKey(identity, "BufferSize"), action->data().toInt());
+  reopenWebcam();
+}
+
+void MainWindow::setRecordFile(QString filename)
+{
+  _recordFile = filename;
+  _recordAction->setChecked(true);
+}
+
+void MainWindow::setFrameSink(FrameSink * sink)
+{
+  delete _frameSink;
+  _frameSink = sink;
+  if (_frameSink) {
+    _frameSink->attach(_frameBus);
+  }
+}
+
+void MainWindow::setMjpegAddress(QString address, double fps, int quality)
+{
+  _mjpegAddress = address;
+  _mjpegRate = fps;
+  _mjpegQuality = quality;
+  _mjpegAction->setChecked(true);
+}
+
+void MainWindow::setMetrics(const QString & socketPath, const QString & logFile, int interval)
+{
+  delete _metricsReporter;
+  _metricsReporter = MetricsReporter::create(_frameBus, _frameTimings, socketPath, logFile, interval);
+  if (_metricsReporter) {
+    _metricsReporter->setFilterThread(_filterThread);
+    _metricsReporter->setPreset(_currentPresetNode.attributes().namedItem("name").nodeValue());
+  }
+}
+
+void MainWindow::onMjpegAction(bool on)
+{
+  if (!on) {
+    delete _mjpegServer;
+    _mjpegServer = nullptr;
+    return;
+  }
+  if (_mjpegServer) {
+    return;
+  }
+  QSettings settings;
+  QString address = _mjpegAddress;
+  _mjpegAddress.clear();
+  if (address.isEmpty()) {
+    bool ok = false;
+    address = QInputDialog::getText(this, "Serve output over HTTP", "Address ([host:]port, use *:port to accept other machines):", QLineEdit::Normal,
+                                    settings.value("MjpegServer/Address", QString("localhost:%1").arg(MjpegServer::DefaultPort)).toString(), &ok);
+    if (!ok || address.isEmpty()) {
+      _mjpegAction->setChecked(false);
+      return;
+    }
+  }
+  _mjpegServer = MjpegServer::create(_frameBus, address, _mjpegRate, _mjpegQuality);
+  if (!_mjpegServer) {
+    QMessageBox::warning(this, "Error", QString("Cannot serve the output on %1").arg(address));
+    _mjpegAction->setChecked(false);
+    return;
+  }
+  settings.setValue("MjpegServer/Address", address);
+  statusBar()->showMessage(QString("Output served on %1").arg(_mjpegServer->url()), 5000);
+}
+
+void MainWindow::onRecordAction(bool on)
+{
+  if (!on) {
+    stopRecording();
+    return;
+  }
+  if (_recorder) {
+    return;
+  }
+  QString filename = _recordFile;
+  _recordFile.clear();
+  if (filename.isEmpty()) {
+    filename = QFileDialog::getSaveFileName(this, "Record output as...", _currentDir, "Video files (*.avi *.mp4 *.mkv *.mov *.webm)");
+  }
+  if (filename.isEmpty()) {
+    _recordAction->setChecked(false);
+    return;
+  }
+  if (QFileInfo(filename).suffix().isEmpty()) {
+    filename += ".avi";
+  }
+  QSettings settings;
+  // Frames are queued by the frame bus, the filter thread never waits for the encoder
+  _recorder = new Recorder(filename, settings.value("Recorder/Codec").toString(), settings.value("Recorder/FrameRate", 30.0).toDouble(),
+                           Recorder::policyFromName(settings.value("Recorder/Policy", "Drop").toString()), settings.value("Recorder/QueueSize", Recorder::DefaultQueueSize).toInt());
+  // Renderings of a still image have no capture time, they are recorded one after the other
+  _recorder->setTimestamps(_source != StillImage);
+  _recorder->attach(_frameBus);
+  if (_filterThread) {
+    // With WaitForEncoder, the filter thread waits for the encoder, not the GUI
+    _filterThread->setOutputThrottle(_recorder->throttlingSubscription());
+  }
+  statusBar()->showMessage(QString("Recording to %1").arg(filename), 3000);
+}
+
+void MainWindow::stopRecording()
+{
+  if (!_recorder) {
+    return;
+  }
+  if (_filterThread) {
+    _filterThread->setOutputThrottle(FrameBus::SubscriptionPtr());
+  }
+  _recorder->finish();
+  _recorder->wait();
+  if (_recorder->hasFailed()) {
+    statusBar()->showMessage(QString("Could not record to %1").arg(_recorder->filename()), 5000);
+  } else {
+    statusBar()->showMessage(QString("Recorded %1 frame(s) to %2, %3 dropped").arg(_recorder->framesWritten()).arg(_recorder->filename()).arg(_recorder->framesDropped()), 5000);
+  }
+  delete _recorder;
+  _recorder = nullptr;
+  _recordAction->setChecked(false);
+}
+
+void MainWindow::updateRecordMenus()
+{
+  QSettings settings;
+  _recordCodecMenu->clear();
+  const QString codec = settings.value("Recorder/Codec").toString();
+  QAction * action = _recordCodecMenu->addAction("&Automatic (from the file type)");
+  action->setCheckable(true);
+  action->setChecked(codec.isEmpty());
+  for (const QString & name : Recorder::codecs()) {
+    action = _recordCodecMenu->addAction(name);
+    action->setData(name);
+    action->setCheckable(true);
+    action->setChecked(name == codec);
+  }
+
+  _recordPolicyMenu->clear();
+  const Recorder::Policy policy = Recorder::policyFromName(settings.value("Recorder/Policy", "Drop").toString());
+  action = _recordPolicyMenu->addAction("&Drop frames");
+  action->setData(Recorder::policyName(Recorder::DropFrames));
+  action->setCheckable(true);
+  action->setChecked(policy == Recorder::DropFrames);
+  action = _recordPolicyMenu->addAction("&Wait for the encoder (slows the display down)");
+  action->setData(Recorder::policyName(Recorder::WaitForEncoder));
+  action->setCheckable(true);
+  action->setChecked(policy == Recorder::WaitForEncoder);
+}
+
+void MainWindow::onRecordCodecChosen(QAction * action)
+{
+  if (action->data().toString().isEmpty()) {
+    QSettings().remove("Recorder/Codec");
+  } else {
+    QSettings().setValue("Recorder/Codec", action->data().toString());
+  }
+}
+
+void MainWindow::onRecordPolicyChosen(QAction * action)
+{
+  QSettings().setValue("Recorder/Policy", action->data().toString());
+}
+
 void MainWindow::setPresets(const QDomElement & domE)
 {
   _treeGPresets->clear();
@@ -1067,6 +1854,51 @@ void MainWindow::onPreviewModeChanged(int index)
     _filterThread->setPreviewMode(static_cast<FilterThread::PreviewMode>(mode));
 }
 
+void MainWindow::onFrameCounterOverlay(bool on)
+{
+  QSettings().setValue("FrameCounterOverlay", on);
+  _imageView->setFrameCounterVisible(on);
+  _fullScreenWidget->imageView()->setFrameCounterVisible(on);
+  if (_outputWindow) {
+    _outputWindow->imageView()->setFrameCounterVisible(on);
+  }
+}
+
+void MainWindow::onPerformanceOverlay(bool on)
+{
+  QSettings().setValue("PerformanceOverlay", on);
+  _performanceOverlay = on;
+  updatePerformanceOverlay();
+}
+
+void MainWindow::onTraceAction(bool on)
+{
+  if (on) {
+    Tracing::start();
+    statusBar()->showMessage("Recording a trace of the threads", 3000);
+    return;
+  }
+  Tracing::stop();
+  const QString filename = QFileDialog::getSaveFileName(this, "Save trace as...", _currentDir, "Chrome trace (*.json)", nullptr, QFileDialog::Options());
+  if (!filename.isEmpty()) {
+    _currentDir = QFileInfo(filename).path();
+    if (Tracing::save(filename)) {
+      statusBar()->showMessage(QString("Trace saved in %1 (open it in chrome://tracing or ui.perfetto.dev)").arg(filename), 5000);
+    } else {
+      QMessageBox::warning(this, "Trace", QString("Cannot write %1").arg(filename));
+    }
+  }
+}
+
+void MainWindow::onLumaOnlyInput(bool on)
+{
+  QSettings().setValue("LumaOnlyInput", on);
+  if (_filterThread) {
+    _filterThread->setLumaOnly(on);
+    requestRender();
+  }
+}
+
 void MainWindow::onRightPanel(bool on)
 {
   if (on && !_rightPanel->isVisible()) {
@@ -1089,7 +1921,12 @@ void MainWindow::updateCameraResolutionCombo()
   const QList<QSize> & resolutions = WebcamSource::webcamResolutions(index);
   QList<QSize>::const_iterator it = resolutions.begin();
   while (it != resolutions.end()) {
-    _comboCamResolution->addItem(QString("%1 x %2").arg(it->width()).arg(it->height()), *it);
+    QString text = QString("%1 x %2").arg(it->width()).arg(it->height());
+    const WebcamSource::CaptureMode mode = WebcamSource::bestCaptureMode(index, *it);
+    if (mode.fps > 0.0f) {
+      text += QString(" (%1 fps, %2)").arg(mode.fps, 0, 'g', 3).arg(WebcamSource::pixelFormatName(mode.pixelFormat));
+    }
+    _comboCamResolution->addItem(text, *it);
     ++it;
   }
   const int defaultResIndex = index >= 0 ? _cameraDefaultResolutionsIndexes[index] : -1;
@@ -1165,24 +2002,120 @@ void MainWindow::onRefreshCameraResolutions()
 
 void MainWindow::onDetectCameras()
 {
-  if (_source == Webcam && _filterThread) {
-    stop();
-    _webcam.stop();
-  }
-  centralWidget()->setEnabled(false);
   statusBar()->showMessage("Updating camera resolutions list...");
-  menuBar()->setEnabled(false);
-  QList<int> camList = WebcamSource::getWebcamList();
-  int firstUnused = WebcamSource::getFirstUnusedWebcam();
-  WebcamSource::retrieveWebcamResolutions(camList, nullptr, statusBar());
-  initGUIFromCameraList(camList, firstUnused);
-  statusBar()->showMessage(QString());
-  centralWidget()->setEnabled(true);
-  menuBar()->setEnabled(true);
+  _forceCameraListUpdate = true;
+  _cameraDiscovery.discover();
+}
+
+void MainWindow::onCamerasDiscovered()
+{
+  const QList<WebcamSource::CameraInfo> & cameras = _cameraDiscovery.cameras();
+  if (!_forceCameraListUpdate && !WebcamSource::camerasDiffer(cameras)) {
+    return;
+  }
+  _forceCameraListUpdate = false;
+  // Device numbers may change when other devices come and go
+  const QString currentCamera = _webcam.cameraIdentity();
+  saveCameraDefaultResolutions();
+  WebcamSource::setCameras(cameras);
+  updateCameraList(WebcamSource::getCachedWebcamList(), currentCamera);
+  statusBar()->showMessage(QString("%1 camera(s) detected").arg(cameras.size()), 3000);
+}
+
+void MainWindow::onBackendsProbed()
+{
+  if (!_openWebcamWhenProbed) {
+    return;
+  }
+  _openWebcamWhenProbed = false;
+  if (_comboWebcam->count() && !_webcam.isStarted()) {
+    _webcam.start();
+    releaseWebcamIfIdle();
+  }
+}
+
+void MainWindow::saveCameraDefaultResolutions()
+{
+  QSettings settings;
+  for (int i = 0; i < _cameraDefaultResolutionsIndexes.size(); ++i) {
+    const int index = _cameraDefaultResolutionsIndexes[i];
+    if (WebcamSource::webcamIdentity(i).isEmpty()) {
+      continue;
+    }
+    settings.setValue(WebcamSource::settingsKey(WebcamSource::webcamIdentity(i), "DefaultResolution"), (index == -1) ? QSize() : WebcamSource::webcamResolutions(i).at(index));
+  }
 }
 
 void MainWindow::initGUIFromCameraList(const QList<int> & camList, int firstUnused)
 {
+  fillCameraCombos(camList);
+  if (_comboWebcam->count()) {
+    _comboWebcam->setCurrentIndex(std::max(0, _comboWebcam->findData(QVariant(firstUnused))));
+    connect(_comboWebcam, SIGNAL(currentIndexChanged(int)), this, SLOT(onWebcamComboChanged(int)));
+    onWebcamComboChanged(_comboWebcam->currentIndex());
+  }
+  const int sourceIndex = keptSourceIndex();
+  _comboSource->setCurrentIndex(sourceIndex);
+  connect(_comboSource, SIGNAL(currentIndexChanged(int)), this, SLOT(onComboSourceChanged(int)));
+  onComboSourceChanged(sourceIndex);
+}
+
+void MainWindow::updateCameraList(const QList<int> & camList, const QString & currentCamera)
+{
+  // A running pipeline is only stopped, or switched, if its camera is gone
+  const bool firstCameras = !_comboWebcam->count() && !camList.isEmpty();
+  const Source previousSource = _source; // Changed if the webcam is gone
+  fillCameraCombos(camList);
+  if (_comboWebcam->count()) {
+    int cameraIndex = -1;
+    for (int i = 0; i < _comboWebcam->count() && !currentCamera.isEmpty(); ++i) {
+      if (WebcamSource::webcamIdentity(camList.indexOf(_comboWebcam->itemData(i).toInt())) == currentCamera) {
+        cameraIndex = i;
+      }
+    }
+    const bool cameraGone = (cameraIndex == -1);
+    if (cameraGone) {
+      cameraIndex = std::max(0, _comboWebcam->findData(QVariant(WebcamSource::getFirstUnusedWebcam())));
+    }
+    _comboWebcam->setCurrentIndex(cameraIndex);
+    connect(_comboWebcam, SIGNAL(currentIndexChanged(int)), this, SLOT(onWebcamComboChanged(int)));
+    if (cameraGone) {
+      onWebcamComboChanged(cameraIndex);
+    } else {
+      updateCameraResolutionCombo();
+    }
+    if (firstCameras && !(_source == Webcam && _filterThread && _filterThread->isRunning())) {
+      // Update actual source capture size, once the backends of the camera are measured
+      if (_cameraDiscovery.isBusy()) {
+        _openWebcamWhenProbed = true;
+      } else {
+        _webcam.start();
+        releaseWebcamIfIdle();
+      }
+    }
+  }
+  const int sourceIndex = keptSourceIndex();
+  _comboSource->setCurrentIndex(sourceIndex);
+  connect(_comboSource, SIGNAL(currentIndexChanged(int)), this, SLOT(onComboSourceChanged(int)));
+  if (_comboSource->itemData(sourceIndex).toInt() != previousSource) {
+    onComboSourceChanged(sourceIndex);
+  }
+}
+
+int MainWindow::keptSourceIndex()
+{
+  // The current source, unless it is gone or an empty image
+  const int index = _comboSource->findData(QVariant(_source));
+  if (index == -1 || (_source == StillImage && _stillImage.filename().isEmpty()) || (_source == ImageSequence && !_imageSequence.frameCount()) ||
+      (_source == Stream && !_rawStream.isOpen()) || (_source == Screen && !_screen.isOpen())) {
+    return 0;
+  }
+  return index;
+}
+
+void MainWindow::fillCameraCombos(const QList<int> & camList)
+{
+  // Filled without notifying the handlers
   disconnect(_comboWebcam, SIGNAL(currentIndexChanged(int)), this, nullptr);
   disconnect(_comboSource, SIGNAL(currentIndexChanged(int)), this, nullptr);
 
@@ -1194,9 +2127,19 @@ void MainWindow::initGUIFromCameraList(const QList<int> & camList, int firstUnus
     _tabParams->setCurrentIndex(0);
     _comboSource->addItem("Image", QVariant(StillImage));
     _comboSource->addItem("Video file", QVariant(Video));
+    _comboSource->addItem("Image sequence", QVariant(ImageSequence));
+    _comboSource->addItem("Stream (shared memory, pipe)", QVariant(Stream));
+#ifdef HAS_XSHM
+    _comboSource->addItem("Screen region", QVariant(Screen));
+#endif
 #if QT_VERSION >= 0x040600
     _comboSource->setItemIcon(0, QIcon::fromTheme("image-x-generic"));
     _comboSource->setItemIcon(1, QIcon::fromTheme("video-x-generic"));
+    _comboSource->setItemIcon(2, QIcon::fromTheme("folder-pictures"));
+    _comboSource->setItemIcon(3, QIcon::fromTheme("network-wired"));
+#ifdef HAS_XSHM
+    _comboSource->setItemIcon(4, QIcon::fromTheme("video-display"));
+#endif
 #endif
     if (_source == Webcam) {
       _source = StillImage;
@@ -1207,10 +2150,20 @@ void MainWindow::initGUIFromCameraList(const QList<int> & camList, int firstUnus
     _comboSource->addItem("Webcam", QVariant(Webcam));
     _comboSource->addItem("Image", QVariant(StillImage));
     _comboSource->addItem("Video file", QVariant(Video));
+    _comboSource->addItem("Image sequence", QVariant(ImageSequence));
+    _comboSource->addItem("Stream (shared memory, pipe)", QVariant(Stream));
+#ifdef HAS_XSHM
+    _comboSource->addItem("Screen region", QVariant(Screen));
+#endif
 #if QT_VERSION >= 0x040600
     _comboSource->setItemIcon(0, QIcon::fromTheme("camera-web"));
     _comboSource->setItemIcon(1, QIcon::fromTheme("image-x-generic"));
     _comboSource->setItemIcon(2, QIcon::fromTheme("video-x-generic"));
+    _comboSource->setItemIcon(3, QIcon::fromTheme("folder-pictures"));
+    _comboSource->setItemIcon(4, QIcon::fromTheme("network-wired"));
+#ifdef HAS_XSHM
+    _comboSource->setItemIcon(5, QIcon::fromTheme("video-display"));
+#endif
 #endif
     _comboWebcam->setEnabled(camList.size() > 1);
     _cameraDefaultResolutionsIndexes.clear();
@@ -1220,19 +2173,14 @@ void MainWindow::initGUIFromCameraList(const QList<int> & camList, int firstUnus
         continue;
       }
       _comboWebcam->addItem(QString("Webcam %1").arg(camList[iCam]), QVariant(camList[iCam]));
-      QSize size = settings.value(QString("WebcamSource/DefaultResolutionCam%1").arg(iCam), QSize()).toSize();
+      QSize size = settings.value(WebcamSource::settingsKey(WebcamSource::webcamIdentity(iCam), "DefaultResolution"), QSize()).toSize();
       if (size.isValid() && WebcamSource::webcamResolutions(iCam).contains(size)) {
         _cameraDefaultResolutionsIndexes.push_back(WebcamSource::webcamResolutions(iCam).indexOf(size));
       } else {
         _cameraDefaultResolutionsIndexes.push_back(WebcamSource::webcamResolutions(iCam).size() - 1);
       }
     }
-    _comboWebcam->setCurrentIndex((firstUnused == -1) ? 0 : firstUnused);
-    connect(_comboWebcam, SIGNAL(currentIndexChanged(int)), this, SLOT(onWebcamComboChanged(int)));
-    onWebcamComboChanged(0);
   }
-  connect(_comboSource, SIGNAL(currentIndexChanged(int)), this, SLOT(onComboSourceChanged(int)));
-  onComboSourceChanged(0);
 }
 
 void MainWindow::onOutputWindow(bool on)
@@ -1243,20 +2191,21 @@ void MainWindow::onOutputWindow(bool on)
       connect(_outputWindow, SIGNAL(aboutToClose()), this, SLOT(onOutputWindowClosing()));
       connect(_outputWindow->imageView(), SIGNAL(keypointPositionsChanged()), this, SLOT(onOutputWindowKeypointsEvent()));
       connect(_outputWindow->imageView(), SIGNAL(resized(QSize)), this, SLOT(outputWindowImageViewResized(QSize)));
+      connect(_outputWindow->imageView(), SIGNAL(interactionChanged(bool)), this, SLOT(onInteractionChanged(bool)));
+      _outputWindow->imageView()->setFrameCounterVisible(QSettings().value("FrameCounterOverlay", false).toBool());
     }
     if (!_outputWindow->isVisible()) {
-      bool running = _filterThread && _filterThread->isRunning();
-      stop();
       _outputWindow->show();
-      if (running) {
-        play();
-      }
+      updateFilterThreadOutputs();
+      requestRender();
     }
   }
   if (!on && _outputWindow && _outputWindow->isVisible()) {
     _outputWindow->onShowFullscreen(false);
     _outputWindow->close();
-    imageViewResized(_imageView->size());
+  }
+  if (!on) {
+    updateFilterThreadOutputs();
   }
 }
 
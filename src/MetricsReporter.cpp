@@ -0,0 +1,278 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   MetricsReporter.cpp
+ * @date   Oct 2026
+ * @brief  Definition of the class MetricsReporter
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "MetricsReporter.h"
+#include <QDateTime>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSettings>
+#include <QStringList>
+#include <algorithm>
+#include <iostream>
+#include "FilterThread.h"
+#include "FrameTimings.h"
+#if defined(_IS_UNIX_)
+#include <unistd.h>
+#endif
+
+namespace
+{
+QString jsonString(const QString & str)
+{
+  QString result;
+  for (const QChar c : str) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if (c == '\n') {
+      result += "\\n";
+    } else if (c == '\t') {
+      result += "\\t";
+    } else if (c.unicode() < 0x20) {
+      result += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+    } else {
+      result += c;
+    }
+  }
+  return QString("\"%1\"").arg(result);
+}
+
+QString jsonNumber(float value)
+{
+  return QString::number(value, 'f', 2);
+}
+} // namespace
+
+MetricsReporter::MetricsReporter(FrameBus & bus, FrameTimings & timings, QObject * parent)
+    : QObject(parent), _bus(bus), _timings(timings), _server(nullptr), _filterThread(nullptr), _capturedBase(0), _droppedBase(0), _errorsBase(0), _sampledIn(0), _sampledOut(0), _fpsIn(0.0f),
+      _fpsOut(0.0f)
+{
+  _uptime.start();
+  _sampleTime.start();
+  _sampleTimer.setInterval(1000);
+  connect(&_sampleTimer, SIGNAL(timeout()), this, SLOT(onSample()));
+  _sampleTimer.start();
+  connect(&_logTimer, SIGNAL(timeout()), this, SLOT(onLogTimer()));
+}
+
+MetricsReporter::~MetricsReporter()
+{
+  if (_server) {
+    _server->close(); // The socket file is removed
+  }
+}
+
+MetricsReporter * MetricsReporter::create(FrameBus & bus, FrameTimings & timings, const QString & socketPath, const QString & logFile, int interval)
+{
+  QSettings settings;
+  const QString path = socketPath.isEmpty() ? settings.value("Metrics/Socket").toString() : socketPath;
+  const QString log = logFile.isEmpty() ? settings.value("Metrics/Log").toString() : logFile;
+  if (path.isEmpty() && log.isEmpty()) {
+    return nullptr;
+  }
+  MetricsReporter * reporter = new MetricsReporter(bus, timings);
+  if ((!path.isEmpty() && !reporter->listen(path)) || (!log.isEmpty() && !reporter->openLog(log, (interval > 0) ? interval : settings.value("Metrics/Interval", DefaultInterval).toInt()))) {
+    delete reporter;
+    return nullptr;
+  }
+  return reporter;
+}
+
+bool MetricsReporter::listen(const QString & path)
+{
+  if (!_server) {
+    _server = new QLocalServer(this);
+    connect(_server, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+  }
+  // Left by a previous instance which did not exit properly
+  QLocalServer::removeServer(path);
+  if (!_server->listen(path)) {
+    std::cerr << "[ZArt] Cannot listen on " << path.toLocal8Bit().constData() << ": " << _server->errorString().toLocal8Bit().constData() << std::endl;
+    return false;
+  }
+  std::cout << "[ZArt] Metrics available on " << _server->fullServerName().toLocal8Bit().constData() << std::endl;
+  return true;
+}
+
+bool MetricsReporter::openLog(const QString & filename, int interval)
+{
+  _log.close();
+  _log.setFileName(filename);
+  if (!_log.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+    std::cerr << "[ZArt] Cannot write metrics to " << filename.toLocal8Bit().constData() << std::endl;
+    return false;
+  }
+  _logTimer.start(1000 * std::max(1, interval));
+  return true;
+}
+
+void MetricsReporter::setFilterThread(FilterThread * thread)
+{
+  if (_filterThread) {
+    _capturedBase += _filterThread->capturedFrames();
+    _droppedBase += _filterThread->droppedFrames();
+    _errorsBase += _filterThread->gmicErrors();
+    const QString error = _filterThread->lastGmicError();
+    if (!error.isEmpty()) {
+      _lastError = error;
+    }
+  }
+  _filterThread = thread;
+}
+
+void MetricsReporter::setPreset(const QString & name)
+{
+  _preset = name;
+}
+
+QByteArray MetricsReporter::snapshot()
+{
+  QString lastError = _filterThread ? _filterThread->lastGmicError() : QString();
+  if (lastError.isEmpty()) {
+    lastError = _lastError;
+  }
+  const qint64 lastOutput = _bus.lastPublished(FrameBus::Output);
+  const qint64 rss = residentSetSize();
+  QStringList fields;
+  fields << QString("\"time\":%1").arg(QDateTime::currentMSecsSinceEpoch());
+  fields << QString("\"uptime\":%1").arg(_uptime.elapsed() / 1000);
+  fields << QString("\"running\":%1").arg(_filterThread ? "true" : "false");
+  fields << QString("\"preset\":%1").arg(jsonString(_preset));
+  fields << QString("\"fps_in\":%1").arg(jsonNumber(_fpsIn));
+  fields << QString("\"fps_out\":%1").arg(jsonNumber(_fpsOut));
+  fields << QString("\"frames_in\":%1").arg(capturedFrames());
+  fields << QString("\"frames_out\":%1").arg(_bus.published(FrameBus::Output));
+  fields << QString("\"frames_dropped\":%1").arg(droppedFrames());
+  // A frozen pipeline is one whose last output gets older
+  fields << QString("\"last_output_age_ms\":%1").arg((lastOutput < 0) ? QString("null") : QString::number((ImageSource::monotonicTime() - lastOutput) / 1000));
+  fields << QString("\"gmic_errors\":%1").arg(gmicErrors());
+  fields << QString("\"last_gmic_error\":%1").arg(lastError.isEmpty() ? QString("null") : jsonString(lastError.trimmed()));
+  fields << QString("\"rss_bytes\":%1").arg((rss < 0) ? QString("null") : QString::number(rss));
+
+  QStringList stages;
+  for (int stage = 0; stage < FrameTimings::StageCount; ++stage) {
+    const FrameTimings::Statistics stats = _timings.statistics(static_cast<FrameTimings::Stage>(stage));
+    const QString key = FrameTimings::stageName(static_cast<FrameTimings::Stage>(stage)).toLower().remove('\'').replace(' ', '_');
+    stages << QString("\"%1\":{\"samples\":%2,\"p50_ms\":%3,\"p95_ms\":%4,\"max_ms\":%5}").arg(key).arg(stats.samples).arg(jsonNumber(stats.p50)).arg(jsonNumber(stats.p95)).arg(jsonNumber(stats.max));
+  }
+  fields << QString("\"stages\":{%1}").arg(stages.join(","));
+
+  QStringList queues;
+  for (const FrameBus::SubscriptionPtr & subscription : _bus.subscriptions()) {
+    QStringList channels;
+    if (subscription->channels() & FrameBus::Input) {
+      channels << "input";
+    }
+    if (subscription->channels() & FrameBus::Output) {
+      channels << "output";
+    }
+    queues << QString("{\"channels\":\"%1\",\"pending\":%2,\"depth\":%3,\"received\":%4,\"dropped\":%5}")
+                  .arg(channels.join("+"))
+                  .arg(subscription->pending())
+                  .arg(subscription->depth())
+                  .arg(subscription->received())
+                  .arg(subscription->dropped());
+  }
+  fields << QString("\"queues\":[%1]").arg(queues.join(","));
+  return QString("{%1}").arg(fields.join(",")).toUtf8();
+}
+
+qint64 MetricsReporter::residentSetSize()
+{
+#if defined(_IS_UNIX_)
+  // "size resident shared ...", in pages
+  QFile file("/proc/self/statm");
+  if (file.open(QIODevice::ReadOnly)) {
+    const QList<QByteArray> fields = file.readLine().split(' ');
+    if (fields.size() > 1) {
+      return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+    }
+  }
+#endif
+  return -1;
+}
+
+void MetricsReporter::onNewConnection()
+{
+  while (QLocalSocket * socket = _server->nextPendingConnection()) {
+    connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    socket->write(snapshot() + '\n');
+    // Once the snapshot is sent
+    socket->disconnectFromServer();
+  }
+}
+
+void MetricsReporter::onSample()
+{
+  const quint64 in = capturedFrames();
+  const quint64 out = _bus.published(FrameBus::Output);
+  const qint64 elapsed = _sampleTime.restart();
+  if (elapsed > 0) {
+    _fpsIn = (in - _sampledIn) * 1000.0f / elapsed;
+    _fpsOut = (out - _sampledOut) * 1000.0f / elapsed;
+  }
+  _sampledIn = in;
+  _sampledOut = out;
+}
+
+void MetricsReporter::onLogTimer()
+{
+  _log.write(snapshot() + '\n');
+  _log.flush();
+}
+
+quint64 MetricsReporter::capturedFrames() const
+{
+  return _capturedBase + (_filterThread ? _filterThread->capturedFrames() : 0);
+}
+
+quint64 MetricsReporter::droppedFrames() const
+{
+  return _droppedBase + (_filterThread ? _filterThread->droppedFrames() : 0);
+}
+
+quint64 MetricsReporter::gmicErrors() const
+{
+  return _errorsBase + (_filterThread ? _filterThread->gmicErrors() : 0);
+}
@@ -0,0 +1,431 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   MjpegServer.cpp
+ * @date   Oct 2026
+ * @brief  Implementation of the classes MjpegServer and MjpegEncoder
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "MjpegServer.h"
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QTcpSocket>
+#include <algorithm>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "Tracing.h"
+
+namespace
+{
+const char * const Boundary = "zartframe";
+
+const char * const IndexPage = "<!DOCTYPE html>\n"
+                               "<html><head><title>ZArt</title></head>\n"
+                               "<body style=\"margin:0;background:#000\">"
+                               "<img src=\"/stream\" style=\"display:block;margin:auto;max-width:100%;max-height:100vh\" alt=\"ZArt output\">"
+                               "</body></html>\n";
+} // namespace
+
+MjpegEncoder::MjpegEncoder(QObject * receiver)
+    : _receiver(receiver), _quality(MjpegServer::DefaultQuality), _maximumRate(MjpegServer::DefaultMaximumRate), _encoded(0), _bgr(new cv::Mat)
+{
+}
+
+MjpegEncoder::~MjpegEncoder()
+{
+  stop();
+  wait();
+  delete _bgr;
+}
+
+void MjpegEncoder::setQuality(int quality)
+{
+  QMutexLocker locker(&_mutex);
+  _quality = std::min(100, std::max(1, quality));
+}
+
+void MjpegEncoder::setMaximumRate(double fps)
+{
+  QMutexLocker locker(&_mutex);
+  _maximumRate = fps;
+}
+
+void MjpegEncoder::attach(FrameBus & bus)
+{
+  wait(); // A previous run may still be finishing its last image
+  _mutex.lock();
+  _jpeg.clear();
+  _mutex.unlock();
+  // Only the newest frame is worth encoding
+  _subscription = bus.subscribe(FrameBus::Output, 1, FrameBus::DropOldest);
+  start();
+}
+
+void MjpegEncoder::stop()
+{
+  if (_subscription) {
+    _subscription->close();
+  }
+}
+
+QByteArray MjpegEncoder::latestImage()
+{
+  QMutexLocker locker(&_mutex);
+  return _jpeg;
+}
+
+quint64 MjpegEncoder::framesEncoded()
+{
+  QMutexLocker locker(&_mutex);
+  return _encoded;
+}
+
+void MjpegEncoder::run()
+{
+  QElapsedTimer clock;
+  clock.start();
+  qint64 lastFrame = -1;
+  while (FrameBus::FramePtr frame = _subscription->take()) {
+    _mutex.lock();
+    const qint64 interval = (_maximumRate > 0.0) ? qint64(1000.0 / _maximumRate) : 0;
+    _mutex.unlock();
+    if (lastFrame >= 0 && clock.elapsed() - lastFrame < interval) {
+      // Too early: the frame to encode is the most recent one once it is time
+      msleep(static_cast<unsigned long>(interval - (clock.elapsed() - lastFrame)));
+      FrameBus::FramePtr newer = _subscription->takeLatest();
+      if (newer) {
+        frame = newer;
+      }
+    }
+    lastFrame = clock.elapsed();
+    if (encode(frame->image)) {
+      QMetaObject::invokeMethod(_receiver, "onFrameEncoded", Qt::QueuedConnection);
+    }
+  }
+}
+
+bool MjpegEncoder::encode(const QImage & image)
+{
+  if (image.isNull()) {
+    return false;
+  }
+  Tracing::Span span("JPEG encode");
+  const QImage rgb = (image.format() == QImage::Format_RGB888) ? image : image.convertToFormat(QImage::Format_RGB888);
+  const cv::Mat pixels(rgb.height(), rgb.width(), CV_8UC3, const_cast<uchar *>(rgb.constBits()), rgb.bytesPerLine());
+  cv::cvtColor(pixels, *_bgr, cv::COLOR_RGB2BGR);
+  _mutex.lock();
+  const std::vector<int> parameters = {cv::IMWRITE_JPEG_QUALITY, _quality};
+  _mutex.unlock();
+  if (!cv::imencode(".jpg", *_bgr, _buffer, parameters)) {
+    return false;
+  }
+  // The only copy: viewers share these bytes
+  const QByteArray jpeg(reinterpret_cast<const char *>(_buffer.data()), int(_buffer.size()));
+  QMutexLocker locker(&_mutex);
+  _jpeg = jpeg;
+  ++_encoded;
+  return true;
+}
+
+MjpegServer::MjpegServer(FrameBus & bus, QObject * parent)
+    : QObject(parent), _bus(bus), _host(QHostAddress::LocalHost), _encoder(this), _maximumClients(DefaultMaximumClients), _viewers(0)
+{
+  connect(&_server, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+}
+
+MjpegServer::~MjpegServer()
+{
+  close();
+}
+
+MjpegServer * MjpegServer::create(FrameBus & bus, const QString & address, double fps, int quality)
+{
+  QSettings settings;
+  MjpegServer * server = new MjpegServer(bus);
+  server->setMaximumRate((fps > 0.0) ? fps : settings.value("MjpegServer/MaximumRate", DefaultMaximumRate).toDouble());
+  server->setQuality((quality >= 0) ? quality : settings.value("MjpegServer/Quality", DefaultQuality).toInt());
+  server->setMaximumClients(settings.value("MjpegServer/MaximumClients", DefaultMaximumClients).toInt());
+  if (!server->listen(address)) {
+    delete server;
+    return nullptr;
+  }
+  return server;
+}
+
+bool MjpegServer::listen(const QString & address)
+{
+  // "port", "host:port", "*:port" or "[::1]:port"
+  QString host = "localhost";
+  QString port = address;
+  const int colon = address.lastIndexOf(':');
+  if (colon != -1) {
+    host = address.left(colon);
+    port = address.mid(colon + 1);
+    if (host.startsWith('[') && host.endsWith(']')) {
+      host = host.mid(1, host.size() - 2);
+    }
+  }
+  bool ok = false;
+  const int number = port.isEmpty() ? int(DefaultPort) : port.toInt(&ok);
+  if (!port.isEmpty() && (!ok || number <= 0 || number > 65535)) {
+    std::cerr << "[ZArt] Invalid MJPEG server port: " << address.toLocal8Bit().constData() << std::endl;
+    return false;
+  }
+  if (host.isEmpty() || host == "localhost") {
+    _host = QHostAddress(QHostAddress::LocalHost);
+  } else if (host == "*" || host == "any") {
+    _host = QHostAddress(QHostAddress::Any);
+  } else if (!_host.setAddress(host)) {
+    std::cerr << "[ZArt] Invalid MJPEG server address: " << host.toLocal8Bit().constData() << std::endl;
+    return false;
+  }
+  if (!_server.listen(_host, quint16(number))) {
+    std::cerr << "[ZArt] Cannot serve MJPEG on " << address.toLocal8Bit().constData() << ": " << _server.errorString().toLocal8Bit().constData() << std::endl;
+    return false;
+  }
+  std::cout << "[ZArt] MJPEG preview on " << url().toLocal8Bit().constData() << std::endl;
+  return true;
+}
+
+void MjpegServer::close()
+{
+  _server.close();
+  while (!_clients.isEmpty()) {
+    Client * client = _clients.front();
+    client->socket->disconnect(this);
+    client->socket->abort();
+    removeClient(client);
+  }
+  _encoder.stop();
+  _encoder.wait();
+}
+
+bool MjpegServer::isListening() const
+{
+  return _server.isListening();
+}
+
+QString MjpegServer::url() const
+{
+  QString host = (_host == QHostAddress(QHostAddress::Any)) ? QString("0.0.0.0") : _host.toString();
+  if (host.contains(':')) {
+    host = QString("[%1]").arg(host);
+  }
+  return QString("http://%1:%2/").arg(host).arg(_server.serverPort());
+}
+
+void MjpegServer::setQuality(int quality)
+{
+  _encoder.setQuality(quality);
+}
+
+void MjpegServer::setMaximumRate(double fps)
+{
+  _encoder.setMaximumRate(fps);
+}
+
+void MjpegServer::setMaximumClients(int count)
+{
+  _maximumClients = std::max(1, count);
+}
+
+int MjpegServer::viewerCount() const
+{
+  return _viewers;
+}
+
+void MjpegServer::onNewConnection()
+{
+  while (QTcpSocket * socket = _server.nextPendingConnection()) {
+    Client * client = new Client;
+    client->socket = socket;
+    client->peer = socket->peerAddress().toString();
+    client->streaming = false;
+    client->sent = 0;
+    client->dropped = 0;
+    _clients.push_back(client);
+    connect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+    connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(onBytesWritten()));
+    connect(socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+    if (_clients.size() > _maximumClients) {
+      reply(client, "503 Service Unavailable", "text/plain", "Too many viewers\n");
+    }
+  }
+}
+
+void MjpegServer::onReadyRead()
+{
+  Client * c = client(qobject_cast<QTcpSocket *>(sender()));
+  if (!c) {
+    return;
+  }
+  if (c->streaming) {
+    c->socket->readAll(); // Nothing more is expected from a viewer
+    return;
+  }
+  c->request += c->socket->readAll();
+  if (c->request.contains("\r\n\r\n") || c->request.contains("\n\n")) {
+    respond(c);
+  } else if (c->request.size() > MaximumRequestSize) {
+    reply(c, "431 Request Header Fields Too Large", "text/plain", "Request too large\n");
+  }
+}
+
+void MjpegServer::onBytesWritten()
+{
+  Client * c = client(qobject_cast<QTcpSocket *>(sender()));
+  if (c && c->streaming && !c->pending.isEmpty() && !c->socket->bytesToWrite()) {
+    const QByteArray jpeg = c->pending;
+    c->pending.clear();
+    sendFrame(c, jpeg);
+  }
+}
+
+void MjpegServer::onDisconnected()
+{
+  Client * c = client(qobject_cast<QTcpSocket *>(sender()));
+  if (c) {
+    removeClient(c);
+  }
+}
+
+void MjpegServer::onFrameEncoded()
+{
+  const QByteArray jpeg = _encoder.latestImage();
+  if (jpeg.isEmpty()) {
+    return;
+  }
+  for (Client * client : _clients) {
+    if (!client->streaming) {
+      continue;
+    }
+    if (client->socket->bytesToWrite()) {
+      // Still sending the previous frame: this one waits, replacing any other
+      if (!client->pending.isEmpty()) {
+        ++client->dropped;
+      }
+      client->pending = jpeg;
+    } else {
+      sendFrame(client, jpeg);
+    }
+  }
+}
+
+MjpegServer::Client * MjpegServer::client(QTcpSocket * socket)
+{
+  for (Client * client : _clients) {
+    if (client->socket == socket) {
+      return client;
+    }
+  }
+  return nullptr;
+}
+
+void MjpegServer::respond(Client * client)
+{
+  const QList<QByteArray> requestLine = client->request.left(client->request.indexOf('\n')).trimmed().split(' ');
+  client->request.clear();
+  if (requestLine.size() < 2 || requestLine[0] != "GET") {
+    reply(client, "405 Method Not Allowed", "text/plain", "Only GET is supported\n");
+    return;
+  }
+  QByteArray path = requestLine[1];
+  const int query = path.indexOf('?');
+  if (query != -1) {
+    path.truncate(query);
+  }
+  if (path == "/" || path == "/index.html") {
+    reply(client, "200 OK", "text/html", IndexPage);
+    return;
+  }
+  if (path != "/stream" && path != "/stream.mjpg") {
+    reply(client, "404 Not Found", "text/plain", "Not found\n");
+    return;
+  }
+  client->socket->write(QByteArray("HTTP/1.0 200 OK\r\n"
+                                   "Content-Type: multipart/x-mixed-replace; boundary=") +
+                        Boundary +
+                        "\r\n"
+                        "Cache-Control: no-cache, no-store, must-revalidate\r\n"
+                        "Pragma: no-cache\r\n"
+                        "Connection: close\r\n\r\n");
+  client->streaming = true;
+  if (++_viewers == 1) {
+    // First viewer: frames are taken from the bus from now on
+    _encoder.attach(_bus);
+  } else {
+    const QByteArray jpeg = _encoder.latestImage();
+    if (!jpeg.isEmpty()) {
+      sendFrame(client, jpeg);
+    }
+  }
+  std::cout << "[ZArt] MJPEG viewer connected from " << client->peer.toLocal8Bit().constData() << " (" << _viewers << " watching)" << std::endl;
+}
+
+void MjpegServer::reply(Client * client, const QByteArray & status, const QByteArray & type, const QByteArray & body)
+{
+  client->socket->write("HTTP/1.0 " + status + "\r\nContent-Type: " + type + "\r\nContent-Length: " + QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n" + body);
+  // Closed once written
+  client->socket->disconnectFromHost();
+}
+
+void MjpegServer::sendFrame(Client * client, const QByteArray & jpeg)
+{
+  client->socket->write(QByteArray("--") + Boundary + "\r\nContent-Type: image/jpeg\r\nContent-Length: " + QByteArray::number(jpeg.size()) + "\r\n\r\n");
+  client->socket->write(jpeg);
+  client->socket->write("\r\n");
+  ++client->sent;
+}
+
+void MjpegServer::removeClient(Client * client)
+{
+  _clients.removeAll(client);
+  if (client->streaming) {
+    std::cout << "[ZArt] MJPEG viewer " << client->peer.toLocal8Bit().constData() << " left: " << client->sent << " frame(s) sent, " << client->dropped << " dropped"
+              << std::endl;
+    if (--_viewers == 0) {
+      // Nobody is watching: the filter thread no longer publishes for the encoder
+      _encoder.stop();
+    }
+  }
+  client->socket->disconnect(this);
+  client->socket->deleteLater();
+  delete client;
+}
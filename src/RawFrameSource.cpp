@@ -0,0 +1,449 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   RawFrameSource.cpp
+ * @date   Oct 2026
+ * @brief  Implementation of the class RawFrameSource
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "RawFrameSource.h"
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QThread>
+#include <cstring>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "FrameSink.h"
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+// Larger frames are certainly garbage read from a stream out of sync
+const size_t MaximumFrameBytes = 256 * 1024 * 1024;
+
+bool isValidFrame(const RawFrame::FrameHeader & header, size_t capacity)
+{
+  if (header.format < RawFrame::RGB24 || header.format > RawFrame::Gray8 || !header.width || !header.height) {
+    return false;
+  }
+  const size_t stride = header.stride;
+  return stride >= size_t(header.width) * RawFrame::bytesPerPixel(header.format) && stride * header.height <= header.size && header.size <= capacity;
+}
+
+// A BGR copy of the pixels, as all other sources provide
+cv::Mat * convertedImage(const RawFrame::FrameHeader & header, uchar * pixels)
+{
+  cv::Mat * image = new cv::Mat;
+  if (header.format == RawFrame::Gray8) {
+    cv::Mat frame(header.height, header.width, CV_8UC1, pixels, header.stride);
+    cv::cvtColor(frame, *image, cv::COLOR_GRAY2BGR);
+  } else {
+    cv::Mat frame(header.height, header.width, CV_8UC3, pixels, header.stride);
+    if (header.format == RawFrame::RGB24) {
+      cv::cvtColor(frame, *image, cv::COLOR_RGB2BGR);
+    } else {
+      frame.copyTo(*image);
+    }
+  }
+  return image;
+}
+} // namespace
+
+RawFrameSource::RawFrameSource()
+    : _kind(InvalidKind), _ring(nullptr), _lastFrame(0), _heldSlot(nullptr), _heldLock(0), _tornFrames(0), _fd(-1), _headers(true), _endOfStream(false)
+{
+  memset(&_rawHeader, 0, sizeof(_rawHeader));
+}
+
+RawFrameSource::~RawFrameSource()
+{
+  close();
+}
+
+RawFrameSource::Kind RawFrameSource::kindFromSpec(const QString & spec, QString * target)
+{
+  if (spec == "stdin" || spec == "-") {
+    return StandardInput;
+  }
+  const int colon = spec.indexOf(':');
+  if (colon == -1 || colon + 1 == spec.size()) {
+    return InvalidKind;
+  }
+  const QString kind = spec.left(colon);
+  if (target) {
+    *target = spec.mid(colon + 1);
+    if (kind == "shm" && !target->startsWith('/')) {
+      target->prepend('/');
+    }
+  }
+  if (kind == "shm") {
+    return SharedMemory;
+  }
+  if (kind == "fifo") {
+    return Fifo;
+  }
+  return InvalidKind;
+}
+
+bool RawFrameSource::isStream(const QString & spec)
+{
+  return kindFromSpec(spec) != InvalidKind;
+}
+
+QSize RawFrameSource::sizeFromString(const QString & text)
+{
+  const QStringList values = text.split('x');
+  if (values.size() != 2 || values[0].toInt() <= 0 || values[1].toInt() <= 0) {
+    return QSize();
+  }
+  return QSize(values[0].toInt(), values[1].toInt());
+}
+
+bool RawFrameSource::open(const QString & spec, const QSize & rawSize, const QString & rawFormat)
+{
+  close();
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+  _kind = kindFromSpec(spec, &_target);
+#endif
+  if (_kind == InvalidKind) {
+    std::cerr << "[ZArt] Unsupported frame input: " << spec.toLocal8Bit().constData() << std::endl;
+    return false;
+  }
+  _spec = spec;
+  if (_kind == SharedMemory) {
+    _ring = new SharedFrameRing;
+    if (!_ring->open(_target)) {
+      std::cerr << "[ZArt] Cannot open frame ring " << _target.toLocal8Bit().constData() << std::endl;
+      close();
+      return false;
+    }
+  } else {
+    // Plain video has no header: its geometry must be given
+    _headers = rawSize.isEmpty();
+    if (!_headers) {
+      const RawFrame::PixelFormat format = FrameSink::pixelFormatFromName(rawFormat.isEmpty() ? QString("bgr24") : rawFormat);
+      _rawHeader.magic = RawFrame::FrameMagic;
+      _rawHeader.format = format;
+      _rawHeader.width = rawSize.width();
+      _rawHeader.height = rawSize.height();
+      _rawHeader.stride = rawSize.width() * RawFrame::bytesPerPixel(format);
+      _rawHeader.size = _rawHeader.stride * rawSize.height();
+    }
+    if (!openPipe()) {
+      std::cerr << "[ZArt] Cannot open " << _target.toLocal8Bit().constData() << ": " << strerror(errno) << std::endl;
+      close();
+      return false;
+    }
+  }
+  // The first frame gives the size of the source, the producer may be starting
+  for (int wait = 0; wait < ReconnectTimeout && !hasImage() && !_endOfStream; wait += WaitTimeout) {
+    capture();
+  }
+  return true;
+}
+
+void RawFrameSource::close()
+{
+  if (hasImage()) {
+    setImage(nullptr); // It may point to the ring
+  }
+  delete _ring;
+  _ring = nullptr;
+  closePipe();
+  _kind = InvalidKind;
+  _lastFrame = 0;
+  _heldSlot = nullptr;
+  _headers = true;
+  _endOfStream = false;
+}
+
+bool RawFrameSource::isOpen() const
+{
+  return _kind != InvalidKind && !_endOfStream;
+}
+
+const QString & RawFrameSource::spec() const
+{
+  return _spec;
+}
+
+quint64 RawFrameSource::tornFrames() const
+{
+  return _tornFrames;
+}
+
+void RawFrameSource::capture()
+{
+  if (_kind == InvalidKind || _endOfStream) {
+    return;
+  }
+  if (_kind == SharedMemory) {
+    captureFromRing();
+  } else {
+    captureFromPipe();
+  }
+}
+
+void RawFrameSource::skipFrames(int count)
+{
+  // The latest frame of a ring is always taken
+  if (_kind != SharedMemory) {
+    ImageSource::skipFrames(count);
+  }
+}
+
+bool RawFrameSource::isFrameIntact() const
+{
+  if (!_heldSlot || SharedFrameRing::isIntact(_heldSlot, _heldLock)) {
+    return true;
+  }
+  if (!_tornFrames) {
+    std::cerr << "[ZArt] Frames of " << _spec.toLocal8Bit().constData() << " are overwritten while being read, the producer should use more slots" << std::endl;
+  }
+  ++_tornFrames;
+  return false;
+}
+
+void RawFrameSource::endOfStream()
+{
+  _endOfStream = true;
+  _heldSlot = nullptr;
+  setImage(nullptr);
+}
+
+void RawFrameSource::captureFromRing()
+{
+  if (_ring->isClosedByProducer() && !reopenRing()) {
+    endOfStream();
+    return;
+  }
+  quint64 frames = _ring->frames();
+  if (frames == _lastFrame) {
+    _ring->waitForFrames(_lastFrame, WaitTimeout);
+    frames = _ring->frames();
+    if (frames == _lastFrame) {
+      if (_ring->isClosedByProducer()) {
+        captureFromRing();
+      }
+      return; // The previous frame is used again
+    }
+  }
+  // The producer may be writing the slot of the latest frame again: retry a few times
+  for (int attempt = 0; attempt < 3; ++attempt, frames = _ring->frames()) {
+    const RawFrame::SlotHeader * slot = _ring->slot(frames - 1);
+    const quint64 lock = slot->lock.load(std::memory_order_acquire);
+    const RawFrame::FrameHeader header = slot->frame;
+    if ((lock & 1) || !isValidFrame(header, _ring->frameCapacity())) {
+      continue;
+    }
+    uchar * pixels = _ring->pixels(slot);
+    cv::Mat * image;
+    if (header.format == RawFrame::BGR24) {
+      image = new cv::Mat(header.height, header.width, CV_8UC3, pixels, header.stride); // Shares the slot
+    } else {
+      image = convertedImage(header, pixels);
+    }
+    if (!SharedFrameRing::isIntact(slot, lock)) {
+      delete image;
+      continue;
+    }
+    setImage(image);
+    setFrameInfo(header.timestamp, header.sequence);
+    _lastFrame = frames;
+    _heldSlot = (header.format == RawFrame::BGR24) ? slot : nullptr;
+    _heldLock = lock;
+    return;
+  }
+}
+
+bool RawFrameSource::reopenRing()
+{
+  // The mapping of the previous ring goes away: keep a copy of its frame until the next one
+  if (image() && _heldSlot) {
+    setImage(new cv::Mat(image()->clone()));
+  }
+  _heldSlot = nullptr;
+  _lastFrame = 0;
+  QElapsedTimer timer;
+  timer.start();
+  while (timer.elapsed() < ReconnectTimeout) {
+    if (_ring->open(_target) && !_ring->isClosedByProducer()) {
+      std::cout << "[ZArt] Frame ring " << _target.toLocal8Bit().constData() << " reopened" << std::endl;
+      return true;
+    }
+    QThread::msleep(50);
+  }
+  std::cout << "[ZArt] Frame ring " << _target.toLocal8Bit().constData() << " closed by its producer" << std::endl;
+  return false;
+}
+
+void RawFrameSource::captureFromPipe()
+{
+  RawFrame::FrameHeader header = _rawHeader;
+  ReadStatus status = ReadDone;
+  if (_headers) {
+    status = readAll(&header, sizeof(header), true);
+    if (status == ReadDone && (header.magic != RawFrame::FrameMagic || !isValidFrame(header, MaximumFrameBytes))) {
+      std::cerr << "[ZArt] " << _spec.toLocal8Bit().constData() << ": Invalid frame header (a raw size should be given for plain video)" << std::endl;
+      status = ReadEnd;
+    }
+  }
+  if (status == ReadTimeout) {
+    return; // The previous frame is used again
+  }
+  if (status == ReadEnd) {
+    endOfStream();
+    return;
+  }
+  cv::Mat * image = nullptr;
+  if (header.format == RawFrame::BGR24 && header.size == header.stride * header.height && header.stride == header.width * 3) {
+    // Read in place
+    image = new cv::Mat(header.height, header.width, CV_8UC3);
+    status = readAll(image->data, header.size, !_headers);
+  } else {
+    _buffer.resize(header.size);
+    status = readAll(_buffer.data(), header.size, !_headers);
+    if (status == ReadDone) {
+      image = convertedImage(header, _buffer.data());
+    }
+  }
+  if (status == ReadTimeout) {
+    delete image;
+    return;
+  }
+  if (status == ReadEnd) {
+    delete image;
+    endOfStream();
+    return;
+  }
+  setImage(image);
+  if (_headers) {
+    setFrameInfo(header.timestamp, header.sequence);
+  }
+}
+
+bool RawFrameSource::openPipe()
+{
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+  if (_kind == StandardInput) {
+    _fd = STDIN_FILENO;
+  } else {
+    // Does not wait for a writer, see readAll()
+    _fd = ::open(_target.toLocal8Bit().constData(), O_RDONLY | O_NONBLOCK);
+  }
+#endif
+  return _fd != -1;
+}
+
+void RawFrameSource::closePipe()
+{
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+  if (_fd != -1 && _fd != STDIN_FILENO) {
+    ::close(_fd);
+  }
+#endif
+  _fd = -1;
+}
+
+RawFrameSource::ReadStatus RawFrameSource::readAll(void * data, size_t size, bool waitForStart)
+{
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+  uchar * position = static_cast<uchar *>(data);
+  uchar * end = position + size;
+  bool reconnecting = false;
+  QElapsedTimer timer;
+  timer.start();
+  while (position != end) {
+    // A frame once started must come in full, or the stream is lost
+    const int timeout = (waitForStart && position == data && !reconnecting) ? WaitTimeout : ReconnectTimeout;
+    const int remaining = timeout - static_cast<int>(timer.elapsed());
+    if (remaining <= 0) {
+      if (reconnecting) {
+        std::cout << "[ZArt] " << _spec.toLocal8Bit().constData() << " closed by its writer" << std::endl;
+        return ReadEnd;
+      }
+      if (position == data) {
+        return ReadTimeout;
+      }
+      std::cerr << "[ZArt] " << _spec.toLocal8Bit().constData() << ": Incomplete frame" << std::endl;
+      return ReadEnd;
+    }
+    struct pollfd pfd;
+    pfd.fd = _fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    const int ready = poll(&pfd, 1, remaining);
+    if (ready == -1 && errno != EINTR) {
+      return ReadEnd;
+    }
+    if (ready <= 0) {
+      continue;
+    }
+    const ssize_t count = ::read(_fd, position, end - position);
+    if (count > 0) {
+      position += count;
+      reconnecting = false;
+      timer.restart();
+    } else if (count == 0) {
+      // The writer has gone: a FIFO waits a while for another one, from the start of a frame
+      if (_kind != Fifo || position != data || reconnecting) {
+        return ReadEnd;
+      }
+      closePipe();
+      if (!openPipe()) {
+        return ReadEnd;
+      }
+      reconnecting = true;
+      timer.restart();
+    } else if (errno != EINTR && errno != EAGAIN) {
+      return ReadEnd;
+    }
+  }
+  return ReadDone;
+#else
+  Q_UNUSED(data)
+  Q_UNUSED(size)
+  Q_UNUSED(waitForStart)
+  return ReadEnd;
+#endif
+}
@@ -0,0 +1,229 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   Recorder.cpp
+ * @date   Oct 2026
+ * @brief  Implementation of the class Recorder
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "Recorder.h"
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "ImageConverter.h"
+#include "Tracing.h"
+
+#if CV_MAJOR_VERSION >= 3
+#define ZART_CV_FOURCC(a, b, c, d) cv::VideoWriter::fourcc(a, b, c, d)
+#else
+#define ZART_CV_FOURCC(a, b, c, d) CV_FOURCC(a, b, c, d)
+#endif
+
+Recorder::Recorder(const QString & filename, const QString & codec, double fps, Policy policy, int queueSize)
+    : _filename(filename), _codec(codec.isEmpty() ? defaultCodec(filename) : codec), _fps(fps > 0.0 ? fps : 25.0), _policy(policy), _queueSize(std::max(1, queueSize)), _timestamps(true),
+      _failed(false), _written(0), _dropped(0)
+{
+}
+
+Recorder::~Recorder()
+{
+  finish();
+  wait();
+}
+
+void Recorder::attach(FrameBus & bus)
+{
+  // Queued frames are kept, the newest ones are dropped
+  _subscription = bus.subscribe(FrameBus::Output, _queueSize, FrameBus::DropNewest);
+  start();
+}
+
+void Recorder::setTimestamps(bool on)
+{
+  QMutexLocker locker(&_mutex);
+  _timestamps = on;
+}
+
+void Recorder::throttle()
+{
+  if (_policy == WaitForEncoder && _subscription) {
+    _subscription->waitForRoom();
+  }
+}
+
+FrameBus::SubscriptionPtr Recorder::throttlingSubscription() const
+{
+  return (_policy == WaitForEncoder) ? _subscription : FrameBus::SubscriptionPtr();
+}
+
+void Recorder::finish()
+{
+  if (_subscription) {
+    _subscription->close(); // Queued frames are still encoded
+  }
+}
+
+bool Recorder::hasFailed()
+{
+  QMutexLocker locker(&_mutex);
+  return _failed;
+}
+
+quint64 Recorder::framesWritten()
+{
+  QMutexLocker locker(&_mutex);
+  return _written;
+}
+
+quint64 Recorder::framesDropped()
+{
+  QMutexLocker locker(&_mutex);
+  return _dropped + (_subscription ? _subscription->dropped() : 0);
+}
+
+const QString & Recorder::filename() const
+{
+  return _filename;
+}
+
+QStringList Recorder::codecs()
+{
+  return QStringList() << "MJPG"
+                       << "mp4v"
+                       << "XVID"
+                       << "H264"
+                       << "VP80"
+                       << "FFV1";
+}
+
+QString Recorder::defaultCodec(const QString & filename)
+{
+  const QString suffix = QFileInfo(filename).suffix().toLower();
+  if (suffix == "mp4" || suffix == "m4v" || suffix == "mov") {
+    return "mp4v";
+  }
+  if (suffix == "webm") {
+    return "VP80";
+  }
+  return "MJPG";
+}
+
+Recorder::Policy Recorder::policyFromName(const QString & name)
+{
+  return (name == "Wait") ? WaitForEncoder : DropFrames;
+}
+
+QString Recorder::policyName(Policy policy)
+{
+  return (policy == WaitForEncoder) ? "Wait" : "Drop";
+}
+
+void Recorder::run()
+{
+  const QByteArray fourcc = _codec.toLatin1().leftJustified(4, ' ', true);
+  cv::VideoWriter writer;
+  cv::Size size;
+  qint64 firstTimestamp = -1;
+  qint64 nextIndex = 0; // Position of the next frame in the output
+  while (true) {
+    FrameBus::FramePtr frame = _subscription->take();
+    if (!frame) {
+      break;
+    }
+    _mutex.lock();
+    const qint64 timestamp = _timestamps ? frame->info.timestamp : -1;
+    _mutex.unlock();
+    cv::Mat * image = nullptr;
+    if (frame->image.format() == QImage::Format_RGB888) {
+      ImageConverter::convert(frame->image, &image);
+    } else {
+      ImageConverter::convert(frame->image.convertToFormat(QImage::Format_RGB888), &image);
+    }
+    frame.reset(); // Back to the pool
+    bool ok = true;
+    if (!writer.isOpened()) {
+      size = cv::Size(image->cols, image->rows);
+      ok = writer.open(_filename.toLocal8Bit().constData(), ZART_CV_FOURCC(fourcc[0], fourcc[1], fourcc[2], fourcc[3]), _fps, size);
+      if (!ok) {
+        std::cerr << "[ZArt] Error: Cannot record " << _filename.toLocal8Bit().constData() << " with codec " << fourcc.constData() << std::endl;
+      }
+    }
+    qint64 repeats = 1;
+    if (ok && timestamp >= 0) {
+      if (firstTimestamp < 0) {
+        firstTimestamp = timestamp;
+      }
+      qint64 index = std::llround((timestamp - firstTimestamp) * _fps / 1e6);
+      if (index - nextIndex > MaximumGap * _fps) {
+        // A pause: not filled, the time line goes on right after the previous frame
+        firstTimestamp = timestamp - static_cast<qint64>(nextIndex * 1e6 / _fps);
+        index = nextIndex;
+      }
+      repeats = index - nextIndex + 1;
+      nextIndex = std::max(nextIndex, index + 1);
+    }
+    if (ok && repeats > 0) {
+      Tracing::Span span("video encode");
+      if (image->cols != size.width || image->rows != size.height) {
+        cv::resize(*image, *image, size);
+      }
+      for (qint64 i = 0; i < repeats; ++i) {
+        writer.write(*image);
+      }
+    }
+    delete image;
+
+    QMutexLocker locker(&_mutex);
+    if (!ok) {
+      _failed = true;
+      _subscription->close();
+      _subscription->clear();
+      break;
+    }
+    if (repeats > 0) {
+      _written += repeats;
+    } else {
+      ++_dropped; // Closer than a frame period to the previous one
+    }
+  }
+  writer.release();
+}
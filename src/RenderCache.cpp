@@ -0,0 +1,138 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   RenderCache.cpp
+ * @date   Oct 2026
+ * @brief  Definition of the methods of the class RenderCache
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "RenderCache.h"
+#include <QMutexLocker>
+
+RenderCache::RenderCache(size_t maximumBytes) : _bytes(0), _maximumBytes(maximumBytes), _hits(0), _misses(0), _evictions(0) {}
+
+RenderCache::~RenderCache() {}
+
+void RenderCache::setMaximumSize(size_t bytes)
+{
+  QMutexLocker locker(&_mutex);
+  _maximumBytes = bytes;
+  evict(0);
+}
+
+size_t RenderCache::maximumSize() const
+{
+  QMutexLocker locker(&_mutex);
+  return _maximumBytes;
+}
+
+bool RenderCache::get(const QString & key, cimg_library::CImg<float> & image)
+{
+  QMutexLocker locker(&_mutex);
+  QHash<QString, EntryList::iterator>::iterator it = _index.find(key);
+  if (it == _index.end()) {
+    ++_misses;
+    return false;
+  }
+  // Move the entry to the front (most recently used)
+  _entries.splice(_entries.begin(), _entries, it.value());
+  image = _entries.front().image;
+  ++_hits;
+  return true;
+}
+
+void RenderCache::insert(const QString & key, const cimg_library::CImg<float> & image)
+{
+  const size_t bytes = image.size();
+  QMutexLocker locker(&_mutex);
+  if (!bytes || bytes > _maximumBytes || _index.contains(key)) {
+    return;
+  }
+  evict(bytes);
+  _entries.push_front(Entry());
+  Entry & entry = _entries.front();
+  entry.key = key;
+  entry.image.assign(image.width(), image.height(), image.depth(), image.spectrum());
+  const float * src = image.data();
+  const float * end = src + image.size();
+  unsigned char * dst = entry.image.data();
+  // Rounded as by ImageConverter: a cached rendering looks the same as a computed one
+  while (src != end) {
+    const float value = *src++;
+    *dst++ = (value <= 0.0f) ? 0 : ((value >= 255.0f) ? 255 : static_cast<unsigned char>(value + 0.5f));
+  }
+  _index.insert(key, _entries.begin());
+  _bytes += bytes;
+}
+
+void RenderCache::clear()
+{
+  QMutexLocker locker(&_mutex);
+  _entries.clear();
+  _index.clear();
+  _bytes = 0;
+}
+
+RenderCache::Statistics RenderCache::statistics() const
+{
+  QMutexLocker locker(&_mutex);
+  Statistics stats;
+  stats.hits = _hits;
+  stats.misses = _misses;
+  stats.evictions = _evictions;
+  stats.bytes = _bytes;
+  stats.maximumBytes = _maximumBytes;
+  stats.entries = _index.size();
+  return stats;
+}
+
+/*
+ * Private methods
+ */
+
+void RenderCache::evict(size_t requiredBytes)
+{
+  while (!_entries.empty() && (_bytes + requiredBytes > _maximumBytes)) {
+    Entry & last = _entries.back();
+    _bytes -= last.image.size();
+    _index.remove(last.key);
+    _entries.pop_back();
+    ++_evictions;
+  }
+}
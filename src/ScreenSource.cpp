@@ -0,0 +1,378 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   ScreenSource.cpp
+ * @date   Oct 2026
+ * @brief  Implementation of the class ScreenSource
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "ScreenSource.h"
+#include <QRegExp>
+#include <QThread>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#ifdef HAS_XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+// Last, Xlib defines macros (Status, None, Bool...) used as names elsewhere
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+struct ScreenSource::Buffer {
+  XImage * image;
+  XShmSegmentInfo segment;
+  bool attached;
+};
+
+namespace
+{
+// X errors of a trapped display are kept instead of ending the program
+Display * trappedDisplay = nullptr;
+int trappedError = 0;
+bool handlerInstalled = false;
+XErrorHandler previousHandler = nullptr;
+
+int onXError(Display * display, XErrorEvent * event)
+{
+  if (display == trappedDisplay) {
+    trappedError = event->error_code;
+    return 0;
+  }
+  return previousHandler ? previousHandler(display, event) : 0;
+}
+
+void trapErrors(Display * display)
+{
+  if (!handlerInstalled) {
+    previousHandler = XSetErrorHandler(onXError);
+    handlerInstalled = true;
+  }
+  XSync(display, False);
+  trappedDisplay = display;
+  trappedError = 0;
+}
+
+int untrapErrors(Display * display)
+{
+  XSync(display, False);
+  trappedDisplay = nullptr;
+  return trappedError;
+}
+} // namespace
+#else
+struct ScreenSource::Buffer {
+};
+#endif
+
+ScreenSource::ScreenSource() : _display(nullptr), _window(0), _followWindow(false), _nextBuffer(0), _frameRate(DefaultFrameRate), _nextFrame(0), _failures(0) {}
+
+ScreenSource::~ScreenSource()
+{
+  close();
+}
+
+bool ScreenSource::isScreen(const QString & spec)
+{
+  return spec.startsWith("screen:");
+}
+
+bool ScreenSource::open(const QString & spec)
+{
+  close();
+#ifdef HAS_XSHM
+  const char * name = getenv("DISPLAY");
+  _display = XOpenDisplay(nullptr);
+  if (!_display) {
+    std::cerr << "[ZArt] Cannot open X display " << (name ? name : "(DISPLAY is not set)") << std::endl;
+    return false;
+  }
+  if (!XShmQueryExtension(_display)) {
+    std::cerr << "[ZArt] The X server has no MIT-SHM extension (a remote display?)" << std::endl;
+    close();
+    return false;
+  }
+  if (!parseSpec(spec)) {
+    close();
+    return false;
+  }
+  if (!updateWindowGeometry() || !allocateBuffers(_region.size())) {
+    std::cerr << "[ZArt] Cannot capture " << spec.toLocal8Bit().constData() << std::endl;
+    close();
+    return false;
+  }
+  _spec = spec;
+  _failures = 0;
+  _clock.start();
+  _nextFrame = 0;
+  capture();
+  if (!hasImage()) {
+    close();
+    return false;
+  }
+  return true;
+#else
+  std::cerr << "[ZArt] Screen capture (" << spec.toLocal8Bit().constData() << ") needs a build with the X11 libraries" << std::endl;
+  return false;
+#endif
+}
+
+void ScreenSource::close()
+{
+  if (hasImage()) {
+    setImage(nullptr); // Pixels of a segment
+  }
+  releaseBuffers();
+#ifdef HAS_XSHM
+  if (_display) {
+    XCloseDisplay(_display);
+  }
+#endif
+  _display = nullptr;
+  _spec.clear();
+}
+
+bool ScreenSource::isOpen() const
+{
+  return _display != nullptr;
+}
+
+const QString & ScreenSource::spec() const
+{
+  return _spec;
+}
+
+void ScreenSource::setFrameRate(double fps)
+{
+  _frameRate = fps;
+}
+
+double ScreenSource::frameRate() const
+{
+  return _frameRate;
+}
+
+void ScreenSource::skipFrames(int)
+{
+  // Nothing is queued, the next capture reads the current content
+}
+
+void ScreenSource::capture()
+{
+#ifdef HAS_XSHM
+  if (!_display) {
+    return;
+  }
+  // Paced on the frame rate, a late capture is not caught up
+  const qint64 now = _clock.elapsed();
+  if (_nextFrame > now) {
+    QThread::msleep(static_cast<unsigned long>(_nextFrame - now));
+  }
+  _nextFrame = std::max(_nextFrame, _clock.elapsed()) + ((_frameRate > 0.0) ? qint64(1000.0 / _frameRate) : 0);
+  if (_followWindow && !updateWindowGeometry()) {
+    if (!_failures++) {
+      std::cerr << "[ZArt] Captured window is gone or hidden, the last frame is kept" << std::endl;
+    }
+    return;
+  }
+  if (_buffers.isEmpty() || _buffers.front()->image->width != _region.width() || _buffers.front()->image->height != _region.height()) {
+    // A resized window: black until the segments are reallocated, if ever
+    if (hasImage()) {
+      setImage(new cv::Mat(cv::Mat::zeros(height(), width(), CV_8UC3)));
+    }
+    if (!allocateBuffers(_region.size())) {
+      return;
+    }
+  }
+  Buffer * buffer = _buffers[_nextBuffer];
+  trapErrors(_display);
+  const bool ok = XShmGetImage(_display, _window, buffer->image, _region.x(), _region.y(), AllPlanes);
+  if (untrapErrors(_display) || !ok) {
+    if (!_failures++) {
+      std::cerr << "[ZArt] Cannot read the screen region, the last frame is kept" << std::endl;
+    }
+    return;
+  }
+  _nextBuffer = (_nextBuffer + 1) % _buffers.size();
+  setRawFrame(BGRX32, reinterpret_cast<const unsigned char *>(buffer->image->data), buffer->image->bytes_per_line, buffer->image->width, buffer->image->height);
+#endif
+}
+
+bool ScreenSource::parseSpec(const QString & spec)
+{
+#ifdef HAS_XSHM
+  const QString region = spec.mid(QString("screen:").size());
+  _window = DefaultRootWindow(_display);
+  _followWindow = true;
+  if (region.isEmpty()) {
+    return true;
+  }
+  if (region.startsWith("window=")) {
+    bool ok = false;
+    _window = region.mid(7).toULong(&ok, 0); // Decimal, or hexadecimal as given by xwininfo
+    if (ok) {
+      return true;
+    }
+  } else {
+    // X geometry, like "640x480+100+50"
+    QRegExp geometry("(\\d+)x(\\d+)(\\+(\\d+)\\+(\\d+))?");
+    if (geometry.exactMatch(region)) {
+      _followWindow = false;
+      _region = QRect(geometry.cap(4).toInt(), geometry.cap(5).toInt(), geometry.cap(1).toInt(), geometry.cap(2).toInt());
+      return true;
+    }
+  }
+  std::cerr << "[ZArt] Invalid screen region " << spec.toLocal8Bit().constData() << " (screen:WxH+X+Y or screen:window=<id>)" << std::endl;
+#else
+  Q_UNUSED(spec);
+#endif
+  return false;
+}
+
+bool ScreenSource::updateWindowGeometry()
+{
+#ifdef HAS_XSHM
+  XWindowAttributes attributes;
+  trapErrors(_display);
+  const bool ok = XGetWindowAttributes(_display, _window, &attributes);
+  if (untrapErrors(_display) || !ok) {
+    std::cerr << "[ZArt] No window " << _window << " on the display" << std::endl;
+    return false;
+  }
+  if (attributes.map_state != IsViewable) {
+    return false; // Nothing on the screen to read
+  }
+  const QRect window(0, 0, attributes.width, attributes.height);
+  if (_followWindow) {
+    _region = window;
+  } else if (!window.contains(_region) || _region.isEmpty()) {
+    std::cerr << "[ZArt] The region is not within the screen (" << attributes.width << "x" << attributes.height << ")" << std::endl;
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool ScreenSource::allocateBuffers(const QSize & size)
+{
+  releaseBuffers();
+#ifdef HAS_XSHM
+  XWindowAttributes attributes;
+  if (!XGetWindowAttributes(_display, _window, &attributes)) {
+    return false;
+  }
+  for (int i = 0; i < BufferCount; ++i) {
+    Buffer * buffer = new Buffer;
+    buffer->attached = false;
+    buffer->segment.shmaddr = nullptr;
+    buffer->image = XShmCreateImage(_display, attributes.visual, attributes.depth, ZPixmap, nullptr, &buffer->segment, size.width(), size.height());
+    _buffers.push_back(buffer);
+    if (!buffer->image) {
+      break;
+    }
+    // Wrapped as is, a 24 bit visual stored on 32 bits in this order
+    const XImage * image = buffer->image;
+    if (image->bits_per_pixel != 32 || image->byte_order != LSBFirst || image->red_mask != 0xff0000 || image->green_mask != 0xff00 || image->blue_mask != 0xff) {
+      std::cerr << "[ZArt] Unsupported screen pixel format (depth " << attributes.depth << ", " << image->bits_per_pixel << " bits per pixel)" << std::endl;
+      break;
+    }
+    buffer->segment.shmid = shmget(IPC_PRIVATE, size_t(image->bytes_per_line) * image->height, IPC_CREAT | 0600);
+    if (buffer->segment.shmid == -1) {
+      break;
+    }
+    buffer->segment.shmaddr = static_cast<char *>(shmat(buffer->segment.shmid, nullptr, 0));
+    buffer->segment.readOnly = False;
+    if (buffer->segment.shmaddr == reinterpret_cast<char *>(-1)) {
+      buffer->segment.shmaddr = nullptr;
+      shmctl(buffer->segment.shmid, IPC_RMID, nullptr);
+      break;
+    }
+    buffer->image->data = buffer->segment.shmaddr;
+    trapErrors(_display);
+    XShmAttach(_display, &buffer->segment);
+    buffer->attached = !untrapErrors(_display);
+    // Destroyed once both sides have detached it, even if this process is killed
+    shmctl(buffer->segment.shmid, IPC_RMID, nullptr);
+    if (!buffer->attached) {
+      break;
+    }
+  }
+  if (_buffers.size() < BufferCount || !_buffers.back()->attached) {
+    std::cerr << "[ZArt] Cannot share memory with the X server for a " << size.width() << "x" << size.height() << " capture" << std::endl;
+    releaseBuffers();
+    return false;
+  }
+  _nextBuffer = 0;
+  return true;
+#else
+  Q_UNUSED(size);
+  return false;
+#endif
+}
+
+void ScreenSource::releaseBuffers()
+{
+#ifdef HAS_XSHM
+  bool detached = false;
+  for (Buffer * buffer : _buffers) {
+    if (buffer->attached) {
+      XShmDetach(_display, &buffer->segment);
+      detached = true;
+    }
+  }
+  if (detached) {
+    XSync(_display, False);
+  }
+  for (Buffer * buffer : _buffers) {
+    if (buffer->image) {
+      buffer->image->data = nullptr; // Not allocated by Xlib
+      XDestroyImage(buffer->image);
+    }
+    if (buffer->segment.shmaddr) {
+      shmdt(buffer->segment.shmaddr);
+    }
+    delete buffer;
+  }
+#endif
+  _buffers.clear();
+}
@@ -0,0 +1,286 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   SharedFrameRing.cpp
+ * @date   Oct 2026
+ * @brief  Implementation of the class SharedFrameRing
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "SharedFrameRing.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+namespace
+{
+size_t alignedSize(size_t size)
+{
+  return (size + 63) & ~size_t(63);
+}
+
+#if defined(__linux__)
+// The doorbell is shared between processes: no FUTEX_PRIVATE_FLAG
+void futexWake(std::atomic<quint32> * word)
+{
+  syscall(SYS_futex, reinterpret_cast<quint32 *>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+void futexWait(std::atomic<quint32> * word, quint32 value, int timeoutMs)
+{
+  struct timespec timeout;
+  timeout.tv_sec = timeoutMs / 1000;
+  timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+  syscall(SYS_futex, reinterpret_cast<quint32 *>(word), FUTEX_WAIT, value, &timeout, nullptr, 0);
+}
+#endif
+} // namespace
+
+SharedFrameRing::SharedFrameRing() : _owner(false), _memory(nullptr), _size(0), _header(nullptr)
+{
+  static_assert(sizeof(RawFrame::RingHeader) <= RawFrame::RingHeaderSize, "RingHeader does not fit");
+  static_assert(sizeof(RawFrame::SlotHeader) <= RawFrame::SlotHeaderSize, "SlotHeader does not fit");
+}
+
+SharedFrameRing::~SharedFrameRing()
+{
+  close();
+}
+
+bool SharedFrameRing::create(const QString & name, int slotCount, size_t frameBytes)
+{
+  close();
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+  const QByteArray path = name.toLocal8Bit();
+  const size_t slotSize = RawFrame::SlotHeaderSize + alignedSize(frameBytes);
+  slotCount = std::max(2, slotCount);
+  const size_t size = RawFrame::RingHeaderSize + slotCount * slotSize;
+  shm_unlink(path.constData()); // Left by a producer which did not exit cleanly
+  int fd = shm_open(path.constData(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd == -1) {
+    std::cerr << "[ZArt] Cannot create shared memory " << path.constData() << ": " << strerror(errno) << std::endl;
+    return false;
+  }
+  if (ftruncate(fd, static_cast<off_t>(size)) == -1) {
+    std::cerr << "[ZArt] Cannot size shared memory " << path.constData() << ": " << strerror(errno) << std::endl;
+    ::close(fd);
+    shm_unlink(path.constData());
+    return false;
+  }
+  void * memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (memory == MAP_FAILED) {
+    shm_unlink(path.constData());
+    return false;
+  }
+  _memory = static_cast<uchar *>(memory);
+  _size = size;
+  _name = name;
+  _owner = true;
+  _header = new (_memory) RawFrame::RingHeader;
+  _header->slotCount = static_cast<quint32>(slotCount);
+  _header->slotSize = static_cast<quint32>(slotSize);
+  _header->doorbell = 0;
+  _header->closed = 0;
+  _header->frames = 0;
+  for (int i = 0; i < slotCount; ++i) {
+    RawFrame::SlotHeader * slot = new (_memory + RawFrame::RingHeaderSize + i * slotSize) RawFrame::SlotHeader;
+    slot->lock = 0;
+  }
+  _header->version = RawFrame::Version;
+  std::atomic_thread_fence(std::memory_order_release);
+  _header->magic = RawFrame::RingMagic; // Last, consumers check it
+  return true;
+#else
+  Q_UNUSED(name)
+  Q_UNUSED(slotCount)
+  Q_UNUSED(frameBytes)
+  return false;
+#endif
+}
+
+bool SharedFrameRing::open(const QString & name)
+{
+  close();
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+  const QByteArray path = name.toLocal8Bit();
+  int fd = shm_open(path.constData(), O_RDONLY, 0);
+  if (fd == -1) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) == -1 || status.st_size < RawFrame::RingHeaderSize) {
+    ::close(fd);
+    return false;
+  }
+  // Read only, but the doorbell is waited on, which does not write to it
+  void * memory = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (memory == MAP_FAILED) {
+    return false;
+  }
+  _memory = static_cast<uchar *>(memory);
+  _size = static_cast<size_t>(status.st_size);
+  _header = reinterpret_cast<RawFrame::RingHeader *>(_memory);
+  if (_header->magic != RawFrame::RingMagic || _header->version != RawFrame::Version ||
+      RawFrame::RingHeaderSize + size_t(_header->slotCount) * _header->slotSize > _size || _header->slotSize <= RawFrame::SlotHeaderSize) {
+    std::cerr << "[ZArt] " << path.constData() << " is not a frame ring" << std::endl;
+    close();
+    return false;
+  }
+  _name = name;
+  _owner = false;
+  return true;
+#else
+  Q_UNUSED(name)
+  return false;
+#endif
+}
+
+void SharedFrameRing::close()
+{
+#if defined(_IS_UNIX_) || defined(_IS_MACOS_)
+  if (!_memory) {
+    return;
+  }
+  if (_owner) {
+    _header->closed = 1;
+    ++_header->doorbell;
+#if defined(__linux__)
+    futexWake(&_header->doorbell);
+#endif
+    shm_unlink(_name.toLocal8Bit().constData());
+  }
+  munmap(_memory, _size);
+#endif
+  _memory = nullptr;
+  _header = nullptr;
+  _size = 0;
+  _owner = false;
+}
+
+bool SharedFrameRing::isOpen() const
+{
+  return _header;
+}
+
+bool SharedFrameRing::isClosedByProducer() const
+{
+  return _header && _header->closed;
+}
+
+const QString & SharedFrameRing::name() const
+{
+  return _name;
+}
+
+size_t SharedFrameRing::frameCapacity() const
+{
+  return _header ? _header->slotSize - RawFrame::SlotHeaderSize : 0;
+}
+
+RawFrame::SlotHeader * SharedFrameRing::beginFrame()
+{
+  const quint64 sequence = _header->frames.load();
+  RawFrame::SlotHeader * slot = reinterpret_cast<RawFrame::SlotHeader *>(_memory + RawFrame::RingHeaderSize + (sequence % _header->slotCount) * _header->slotSize);
+  slot->lock.fetch_add(1); // Odd: being written
+  std::atomic_thread_fence(std::memory_order_release);
+  return slot;
+}
+
+void SharedFrameRing::publishFrame(RawFrame::SlotHeader * slot)
+{
+  slot->lock.fetch_add(1, std::memory_order_release);
+  ++_header->frames;
+  ++_header->doorbell;
+#if defined(__linux__)
+  futexWake(&_header->doorbell);
+#endif
+}
+
+quint64 SharedFrameRing::frames() const
+{
+  return _header ? _header->frames.load(std::memory_order_acquire) : 0;
+}
+
+bool SharedFrameRing::waitForFrames(quint64 known, int timeoutMs) const
+{
+  if (!_header) {
+    return false;
+  }
+  const quint32 doorbell = _header->doorbell.load();
+  if (_header->frames.load() != known || _header->closed) {
+    return true;
+  }
+#if defined(__linux__)
+  futexWait(&_header->doorbell, doorbell, timeoutMs);
+#else
+  Q_UNUSED(doorbell)
+  usleep(static_cast<useconds_t>(std::min(timeoutMs, 2) * 1000));
+#endif
+  return _header->frames.load() != known || _header->closed;
+}
+
+const RawFrame::SlotHeader * SharedFrameRing::slot(quint64 sequence) const
+{
+  return reinterpret_cast<const RawFrame::SlotHeader *>(_memory + RawFrame::RingHeaderSize + (sequence % _header->slotCount) * _header->slotSize);
+}
+
+bool SharedFrameRing::isIntact(const RawFrame::SlotHeader * slot, quint64 lock)
+{
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return !(lock & 1) && slot->lock.load() == lock;
+}
+
+uchar * SharedFrameRing::pixels(const RawFrame::SlotHeader * slot) const
+{
+  return const_cast<uchar *>(reinterpret_cast<const uchar *>(slot)) + RawFrame::SlotHeaderSize;
+}
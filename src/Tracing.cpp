@@ -0,0 +1,242 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   Tracing.cpp
+ * @date   Oct 2026
+ * @brief  Definition of the class Tracing
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "Tracing.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QList>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+#include <iostream>
+#include "ImageSource.h"
+
+QAtomicInt Tracing::_enabled(0);
+
+namespace
+{
+QMutex & buffersMutex()
+{
+  static QMutex mutex;
+  return mutex;
+}
+
+int lastThreadId = 0; // Guarded by buffersMutex()
+
+QString jsonString(const QString & str)
+{
+  QString result = str;
+  result.replace("\\", "\\\\").replace("\"", "\\\"");
+  return QString("\"%1\"").arg(result);
+}
+} // namespace
+
+void Tracing::start()
+{
+  QMutexLocker locker(&buffersMutex());
+  _enabled.storeRelease(0);
+  for (Buffer * buffer : buffers()) {
+    buffer->next.storeRelease(0);
+    buffer->size.storeRelease(0);
+  }
+  _enabled.storeRelease(1);
+}
+
+void Tracing::stop()
+{
+  _enabled.storeRelease(0);
+}
+
+void Tracing::record(const char * name, const char * category, qint64 start, qint64 duration)
+{
+  if (!isEnabled()) {
+    return;
+  }
+  // Only this thread writes into its buffer
+  Buffer * buffer = threadBuffer();
+  if (!buffer) {
+    return;
+  }
+  const int next = buffer->next.loadAcquire();
+  Event & event = buffer->events[next];
+  event.name = name;
+  event.category = category;
+  event.start = start;
+  event.duration = duration;
+  buffer->next.storeRelease((next + 1) % BufferSize);
+  const int size = buffer->size.loadAcquire();
+  if (size < BufferSize) {
+    buffer->size.storeRelease(size + 1);
+  }
+}
+
+void Tracing::lock(QMutex & mutex, const char * name)
+{
+  if (!isEnabled()) {
+    mutex.lock();
+    return;
+  }
+  // Uncontended locks are not worth a span
+  if (mutex.tryLock()) {
+    return;
+  }
+  const qint64 start = now();
+  mutex.lock();
+  record(name, "lock", start, now() - start);
+}
+
+bool Tracing::save(const QString & filename)
+{
+  QFile file(filename);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+    std::cerr << "[ZArt] Error: Cannot write the trace " << filename.toLocal8Bit().constData() << std::endl;
+    return false;
+  }
+  QMutexLocker locker(&buffersMutex());
+  QTextStream out(&file);
+  const qint64 pid = QCoreApplication::applicationPid();
+  int spans = 0;
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  out << QString("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%1,\"tid\":0,\"args\":{\"name\":\"ZArt\"}}").arg(pid);
+  for (const Buffer * buffer : buffers()) {
+    out << QString(",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%1,\"tid\":%2,\"args\":{\"name\":%3}}").arg(pid).arg(buffer->id).arg(jsonString(buffer->thread));
+    out << QString(",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":%1,\"tid\":%2,\"args\":{\"sort_index\":%2}}").arg(pid).arg(buffer->id);
+    // Oldest first. If the thread is still recording, the oldest spans may be replaced meanwhile.
+    const int size = buffer->size.loadAcquire();
+    const int first = (buffer->next.loadAcquire() - size + BufferSize) % BufferSize;
+    for (int i = 0; i < size; ++i) {
+      const Event & event = buffer->events[(first + i) % BufferSize];
+      out << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"ts\":" << event.start << ",\"dur\":" << event.duration << ",\"pid\":" << pid
+          << ",\"tid\":" << buffer->id << "}";
+    }
+    spans += size;
+  }
+  // Saved: the buffers of finished threads can be reused
+  for (Buffer * buffer : buffers()) {
+    if (buffer->finished.loadAcquire()) {
+      buffer->next.storeRelease(0);
+      buffer->size.storeRelease(0);
+    }
+  }
+  out << "\n]}\n";
+  out.flush();
+  if (file.error() != QFile::NoError) {
+    std::cerr << "[ZArt] Error: Cannot write the trace " << filename.toLocal8Bit().constData() << std::endl;
+    return false;
+  }
+  std::cout << "[ZArt] Trace: " << spans << " span(s) of " << buffers().size() << " thread(s) saved in " << filename.toLocal8Bit().constData() << std::endl;
+  return true;
+}
+
+qint64 Tracing::now()
+{
+  // The clock of the frame timestamps
+  return ImageSource::monotonicTime();
+}
+
+QList<Tracing::Buffer *> & Tracing::buffers()
+{
+  // Never freed, but reused: spans of finished threads are still saved
+  static QList<Buffer *> list;
+  return list;
+}
+
+Tracing::BufferOwner::~BufferOwner()
+{
+  if (buffer) {
+    buffer->finished.storeRelease(1);
+  }
+}
+
+Tracing::Buffer * Tracing::threadBuffer()
+{
+  static thread_local BufferOwner owner;
+  if (owner.buffer) {
+    return owner.buffer;
+  }
+  QString name;
+  QThread * thread = QThread::currentThread();
+  if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+    name = "Main";
+  } else if (!thread->objectName().isEmpty()) {
+    name = thread->objectName();
+  } else {
+    name = thread->metaObject()->className();
+  }
+  QMutexLocker locker(&buffersMutex());
+  // The oldest buffer of a finished thread with no span left to save
+  Buffer * buffer = nullptr;
+  for (Buffer * candidate : buffers()) {
+    if (candidate->finished.loadAcquire() && !candidate->size.loadAcquire()) {
+      buffer = candidate;
+      break;
+    }
+  }
+  if (buffer) {
+    buffers().removeOne(buffer);
+  } else if (buffers().size() < MaximumBuffers) {
+    buffer = new Buffer;
+  } else {
+    // The spans of the oldest finished thread are lost, if any
+    for (Buffer * candidate : buffers()) {
+      if (candidate->finished.loadAcquire()) {
+        buffer = candidate;
+        break;
+      }
+    }
+    if (!buffer) {
+      // Too many threads alive: this one is not recorded (looked for again at its next span)
+      return nullptr;
+    }
+    buffers().removeOne(buffer);
+  }
+  buffer->next.storeRelease(0);
+  buffer->size.storeRelease(0);
+  buffer->finished.storeRelease(0);
+  buffer->id = ++lastThreadId;
+  buffer->thread = QString("%1 (%2)").arg(name).arg(buffer->id);
+  buffers().append(buffer);
+  owner.buffer = buffer;
+  return buffer;
+}
@@ -0,0 +1,432 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   V4L2Source.cpp
+ * @date   Oct 2026
+ * @brief  Definition of the class V4L2Source
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "V4L2Source.h"
+
+#ifdef HAS_V4L2
+
+#include <QElapsedTimer>
+#include <QSettings>
+#include <QString>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/videodev2.h>
+#include <opencv2/opencv.hpp>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <unistd.h>
+#include "Common.h"
+
+namespace
+{
+int xioctl(int fd, unsigned long request, void * arg)
+{
+  int result;
+  do {
+    result = ioctl(fd, request, arg);
+  } while (result == -1 && errno == EINTR);
+  return result;
+}
+} // namespace
+
+V4L2Source::V4L2Source() : _fd(-1), _heldBuffer(-1), _pixelFormat(0), _bytesPerLine(0), _frameRate(0.0f), _frameTimestamp(0), _frameSequence(0) {}
+
+V4L2Source::~V4L2Source()
+{
+  stop();
+}
+
+bool V4L2Source::nativeCaptureEnabled()
+{
+  return QSettings().value("WebcamSource/NativeV4L2", true).toBool();
+}
+
+bool V4L2Source::usesNativeCapture() const
+{
+  return _fd != -1;
+}
+
+float V4L2Source::frameRate() const
+{
+  return _frameRate;
+}
+
+bool V4L2Source::isStarted() const
+{
+  return usesNativeCapture() || WebcamSource::isStarted();
+}
+
+void V4L2Source::start()
+{
+  if (usesNativeCapture()) {
+    // The device was kept open: frames queued meanwhile are outdated
+    dropQueuedFrames();
+    return;
+  }
+  if (isStarted() || cameraIndex() == -1) {
+    return;
+  }
+  QElapsedTimer timer;
+  timer.start();
+  takeCaptureSizeChange();
+  if (!cameraIdentity().isEmpty()) {
+    cancelBackendProbe(cameraIdentity());
+  }
+  // Only a backend chosen by the user replaces the native capture, the probe does not measure it
+  const Backend backend = chosenBackend(cameraIdentity());
+  if (!nativeCaptureEnabled() || (backend != AnyBackend && backend != V4L2Backend) || !openDevice()) {
+    closeDevice();
+    WebcamSource::start();
+    return;
+  }
+  if (!captureFirstFrame(timer)) {
+    std::cerr << "[ZArt] V4L2: no frame from camera " << cameraIndex() << ", falling back to OpenCV capture" << std::endl;
+    closeDevice();
+    WebcamSource::start();
+    return;
+  }
+  setCameraOpen(true);
+}
+
+void V4L2Source::stop()
+{
+  if (!usesNativeCapture()) {
+    WebcamSource::stop();
+    return;
+  }
+  releaseHeldBuffer();
+  closeDevice();
+}
+
+bool V4L2Source::reconfigure()
+{
+  if (!usesNativeCapture()) {
+    return WebcamSource::reconfigure();
+  }
+  // Same file descriptor, only the streaming setup is done again
+  QElapsedTimer timer;
+  timer.start();
+  releaseHeldBuffer();
+  releaseStreaming();
+  return configureStreaming() && captureFirstFrame(timer);
+}
+
+void V4L2Source::capture()
+{
+  if (!usesNativeCapture()) {
+    WebcamSource::capture();
+    return;
+  }
+  if (takeCaptureSizeChange() && !reconfigure()) {
+    stop();
+    start();
+    if (!usesNativeCapture()) {
+      WebcamSource::capture();
+      return;
+    }
+  }
+  int index;
+  if (!dequeueBuffer(index)) {
+    return;
+  }
+  const int width = captureSize().width();
+  const int height = captureSize().height();
+  cv::Mat * anImage = nullptr;
+  bool keepBuffer = false;
+  if (_pixelFormat == V4L2_PIX_FMT_BGR24) {
+    cv::Mat frame(height, width, CV_8UC3, _buffers[index].start, _bytesPerLine);
+    if (frame.isContinuous()) {
+      anImage = new cv::Mat(frame); // Shares the driver buffer
+      keepBuffer = true;
+    } else {
+      anImage = new cv::Mat(frame.clone());
+    }
+  }
+  if (anImage) {
+    setImage(anImage);
+  } else {
+    // YUV frames are handed over as is, see ImageConverter::convert(const ImageSource &, ...)
+    const unsigned char * data = static_cast<const unsigned char *>(_buffers[index].start);
+    setRawFrame((_pixelFormat == V4L2_PIX_FMT_NV12) ? NV12 : YUYV, data, _bytesPerLine, width, height);
+    keepBuffer = true;
+  }
+  setFrameInfo(_frameTimestamp ? _frameTimestamp : frameInfo().timestamp, _frameSequence);
+  // The previous buffer is no longer referenced by the source image
+  if (_heldBuffer != -1) {
+    requeueBuffer(_heldBuffer);
+    _heldBuffer = -1;
+  }
+  if (keepBuffer) {
+    _heldBuffer = index;
+  } else {
+    requeueBuffer(index);
+  }
+}
+
+bool V4L2Source::openDevice()
+{
+  const QString filename = QString("/dev/video%1").arg(cameraIndex());
+  _fd = ::open(filename.toLocal8Bit().constData(), O_RDWR | O_NONBLOCK);
+  if (_fd == -1) {
+    return false;
+  }
+  v4l2_capability cap;
+  memset(&cap, 0, sizeof(cap));
+  if (xioctl(_fd, VIDIOC_QUERYCAP, &cap) == -1 || !(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE) || !(cap.capabilities & V4L2_CAP_STREAMING)) {
+    qDebug("[V4L2Source] %s does not support streaming capture", filename.toLocal8Bit().constData());
+    return false;
+  }
+  return configureStreaming();
+}
+
+bool V4L2Source::configureStreaming()
+{
+  const QString filename = QString("/dev/video%1").arg(cameraIndex());
+  // Formats which can be used without any decoding, by order of preference
+  QList<unsigned int> formats;
+  formats << V4L2_PIX_FMT_BGR24 << V4L2_PIX_FMT_YUYV << V4L2_PIX_FMT_NV12;
+  CaptureMode mode = lastKnownGoodMode();
+  if (!formats.contains(mode.pixelFormat)) {
+    mode = bestCaptureMode(captureModes(), captureSize(), formats);
+    const CaptureMode fastestMode = bestCaptureMode(captureModes(), captureSize());
+    if (fastestMode.fps > mode.fps) {
+      // Typically MJPEG: decoding it is cheaper than capturing fewer frames
+      qDebug("[V4L2Source] %s is faster with %s frames (%.1f fps)", filename.toLocal8Bit().constData(), pixelFormatName(fastestMode.pixelFormat).toLocal8Bit().constData(), fastestMode.fps);
+      return false;
+    }
+  }
+  if (mode.pixelFormat) {
+    formats.removeOne(mode.pixelFormat);
+    formats.prepend(mode.pixelFormat);
+  }
+  v4l2_format format;
+  bool formatIsSet = false;
+  for (unsigned int pixelFormat : formats) {
+    memset(&format, 0, sizeof(format));
+    format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    format.fmt.pix.width = captureSize().width();
+    format.fmt.pix.height = captureSize().height();
+    format.fmt.pix.pixelformat = pixelFormat;
+    format.fmt.pix.field = V4L2_FIELD_NONE;
+    if (xioctl(_fd, VIDIOC_S_FMT, &format) != -1 && format.fmt.pix.pixelformat == pixelFormat) {
+      formatIsSet = true;
+      break;
+    }
+  }
+  if (!formatIsSet) {
+    qDebug("[V4L2Source] %s provides neither BGR24, YUYV nor NV12 frames", filename.toLocal8Bit().constData());
+    return false;
+  }
+  _pixelFormat = format.fmt.pix.pixelformat;
+  _bytesPerLine = format.fmt.pix.bytesperline;
+  setActualCaptureSize(QSize(format.fmt.pix.width, format.fmt.pix.height));
+
+  // Highest frame rate for this format and size (not all drivers allow to choose)
+  v4l2_streamparm parameters;
+  memset(&parameters, 0, sizeof(parameters));
+  parameters.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  if (mode.fps > 0.0f && mode.pixelFormat == _pixelFormat) {
+    parameters.parm.capture.timeperframe.numerator = 1000;
+    parameters.parm.capture.timeperframe.denominator = static_cast<unsigned int>(mode.fps * 1000.0f + 0.5f);
+    xioctl(_fd, VIDIOC_S_PARM, &parameters);
+  }
+  _frameRate = 0.0f;
+  if (xioctl(_fd, VIDIOC_G_PARM, &parameters) != -1 && parameters.parm.capture.timeperframe.numerator) {
+    _frameRate = static_cast<float>(parameters.parm.capture.timeperframe.denominator) / parameters.parm.capture.timeperframe.numerator;
+  }
+
+  v4l2_requestbuffers request;
+  memset(&request, 0, sizeof(request));
+  // Fewer buffers, fewer outdated frames waiting when filtering is slow
+  const int bufferSize = captureBufferSize();
+  request.count = (bufferSize > 0) ? std::max(MinimumBufferCount, bufferSize) : DefaultBufferCount;
+  request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  request.memory = V4L2_MEMORY_MMAP;
+  if (xioctl(_fd, VIDIOC_REQBUFS, &request) == -1 || request.count < 2) {
+    qDebug("[V4L2Source] %s: cannot allocate mmap buffers", filename.toLocal8Bit().constData());
+    return false;
+  }
+  for (unsigned int i = 0; i < request.count; ++i) {
+    v4l2_buffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer.memory = V4L2_MEMORY_MMAP;
+    buffer.index = i;
+    if (xioctl(_fd, VIDIOC_QUERYBUF, &buffer) == -1) {
+      return false;
+    }
+    Buffer mapped;
+    mapped.length = buffer.length;
+    mapped.start = mmap(nullptr, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, buffer.m.offset);
+    if (mapped.start == MAP_FAILED) {
+      return false;
+    }
+    _buffers.push_back(mapped);
+  }
+  for (int i = 0; i < _buffers.size(); ++i) {
+    requeueBuffer(i);
+  }
+  v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  if (xioctl(_fd, VIDIOC_STREAMON, &type) == -1) {
+    return false;
+  }
+  std::cout << "[ZArt] V4L2 capture on " << filename.toStdString() << " (" << captureSize().width() << "x" << captureSize().height() << ", "
+            << pixelFormatName(_pixelFormat).toStdString() << ", " << _frameRate << " fps, " << _buffers.size() << " buffers)" << std::endl;
+  return true;
+}
+
+bool V4L2Source::captureFirstFrame(const QElapsedTimer & timer)
+{
+  capture();
+  if (!hasImage()) {
+    return false;
+  }
+  setTimeToFirstFrame(static_cast<int>(timer.elapsed()));
+  CaptureMode mode;
+  mode.pixelFormat = _pixelFormat;
+  mode.size = captureSize();
+  mode.fps = _frameRate;
+  saveLastKnownGoodMode(mode);
+  return true;
+}
+
+void V4L2Source::releaseHeldBuffer()
+{
+  // The last image must outlive the driver buffers
+  if (_heldBuffer != -1 && hasImage()) {
+    setImage(new cv::Mat(image()->clone()));
+  }
+}
+
+void V4L2Source::dropQueuedFrames()
+{
+  v4l2_buffer buffer;
+  memset(&buffer, 0, sizeof(buffer));
+  buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buffer.memory = V4L2_MEMORY_MMAP;
+  while (xioctl(_fd, VIDIOC_DQBUF, &buffer) != -1) {
+    requeueBuffer(static_cast<int>(buffer.index));
+  }
+}
+
+void V4L2Source::closeDevice()
+{
+  if (_fd == -1) {
+    return;
+  }
+  releaseStreaming();
+  ::close(_fd);
+  _fd = -1;
+  setCameraOpen(false);
+}
+
+void V4L2Source::releaseStreaming()
+{
+  v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  xioctl(_fd, VIDIOC_STREAMOFF, &type);
+  for (int i = 0; i < _buffers.size(); ++i) {
+    munmap(_buffers[i].start, _buffers[i].length);
+  }
+  _buffers.clear();
+  // Releases the driver buffers
+  v4l2_requestbuffers request;
+  memset(&request, 0, sizeof(request));
+  request.count = 0;
+  request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  request.memory = V4L2_MEMORY_MMAP;
+  xioctl(_fd, VIDIOC_REQBUFS, &request);
+  _heldBuffer = -1;
+}
+
+bool V4L2Source::dequeueBuffer(int & index)
+{
+  v4l2_buffer buffer;
+  memset(&buffer, 0, sizeof(buffer));
+  buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buffer.memory = V4L2_MEMORY_MMAP;
+  while (xioctl(_fd, VIDIOC_DQBUF, &buffer) == -1) {
+    if (errno != EAGAIN) {
+      std::cerr << "[ZArt] V4L2: VIDIOC_DQBUF failed (" << strerror(errno) << ")" << std::endl;
+      return false;
+    }
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(_fd, &fds);
+    timeval timeout;
+    timeout.tv_sec = DequeueTimeout / 1000;
+    timeout.tv_usec = (DequeueTimeout % 1000) * 1000;
+    const int ready = select(_fd + 1, &fds, nullptr, nullptr, &timeout);
+    if (ready == 0 || (ready == -1 && errno != EINTR)) {
+      return false;
+    }
+  }
+  index = static_cast<int>(buffer.index);
+  // Drivers may use another clock, then the dequeue time is used instead
+  if ((buffer.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+    _frameTimestamp = static_cast<qint64>(buffer.timestamp.tv_sec) * 1000000 + buffer.timestamp.tv_usec;
+  } else {
+    _frameTimestamp = 0;
+  }
+  // Counted by the driver: gaps are frames it had to drop
+  _frameSequence = buffer.sequence;
+  return true;
+}
+
+void V4L2Source::requeueBuffer(int index)
+{
+  v4l2_buffer buffer;
+  memset(&buffer, 0, sizeof(buffer));
+  buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buffer.memory = V4L2_MEMORY_MMAP;
+  buffer.index = static_cast<unsigned int>(index);
+  if (xioctl(_fd, VIDIOC_QBUF, &buffer) == -1) {
+    std::cerr << "[ZArt] V4L2: VIDIOC_QBUF failed (" << strerror(errno) << ")" << std::endl;
+  }
+}
+
+#endif // HAS_V4L2
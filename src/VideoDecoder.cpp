@@ -0,0 +1,443 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   VideoDecoder.cpp
+ * @date   Oct 2026
+ * @brief  Definition of the class VideoDecoder
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+#include "VideoDecoder.h"
+#include <QMutexLocker>
+#include <QSettings>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "Common.h"
+#include "ImageSource.h"
+#include "Tracing.h"
+
+#if CV_MAJOR_VERSION >= 3
+#define ZART_CV_CAP_PROP_POS_FRAMES cv::VideoCaptureProperties::CAP_PROP_POS_FRAMES
+#define ZART_CV_CAP_PROP_POS_MSEC cv::VideoCaptureProperties::CAP_PROP_POS_MSEC
+#define ZART_CV_CAP_PROP_FPS cv::VideoCaptureProperties::CAP_PROP_FPS
+#define ZART_CV_CAP_PROP_FRAME_COUNT cv::VideoCaptureProperties::CAP_PROP_FRAME_COUNT
+#else
+#define ZART_CV_CAP_PROP_POS_FRAMES CV_CAP_PROP_POS_FRAMES
+#define ZART_CV_CAP_PROP_POS_MSEC CV_CAP_PROP_POS_MSEC
+#define ZART_CV_CAP_PROP_FPS CV_CAP_PROP_FPS
+#define ZART_CV_CAP_PROP_FRAME_COUNT CV_CAP_PROP_FRAME_COUNT
+#endif
+
+#if (CV_MAJOR_VERSION > 4) || ((CV_MAJOR_VERSION == 4) && (CV_MINOR_VERSION >= 7))
+#define CVCAPTURE_HAS_THREADS_PARAMETER
+#endif
+
+VideoDecoder::VideoDecoder(const QString & filename, int readAhead, int threads)
+    : _filename(filename), _readAhead(std::max(1, readAhead)), _threads(threads), _capture(nullptr), _spare(nullptr), _seekable(true), _framePeriod(40.0), _timeOffset(0.0), _lastTimestamp(0.0),
+      _continue(true), _loop(false), _seekPosition(-1), _framesToSkip(0), _endOfFile(false), _clockMode(false), _clockRunning(false), _clockOrigin(0), _estimatedFrameCount(0), _indexed(false),
+      _stopIndexing(false)
+{
+}
+
+VideoDecoder::~VideoDecoder()
+{
+  stop();
+  wait();
+  _stopIndexing = true;
+  if (_indexer.joinable()) {
+    _indexer.join();
+  }
+  clearFrames();
+  delete _capture;
+  delete _spare;
+}
+
+bool VideoDecoder::takeFrame(Frame & frame)
+{
+  QMutexLocker locker(&_mutex);
+  while (_continue) {
+    if (_frames.isEmpty()) {
+      if (_endOfFile) {
+        return false;
+      }
+      _frameAvailable.wait(&_mutex);
+      continue;
+    }
+    if (_clockMode) {
+      const Frame & next = _frames.head();
+      if (!_clockRunning) {
+        // (Re)started on the first frame, e.g. after a pause or a seek
+        _clockOrigin = ImageSource::monotonicTime() - static_cast<qint64>(next.timestamp * 1000.0);
+        _clockRunning = true;
+      }
+      const double lateness = mediaTime() - next.timestamp;
+      if (lateness > _framePeriod && _frames.size() > 1) {
+        delete _frames.dequeue().image;
+        _frameTaken.wakeAll();
+        continue;
+      }
+      if (lateness < 0.0) {
+        _frameAvailable.wait(&_mutex, static_cast<unsigned long>(std::ceil(-lateness)));
+        continue;
+      }
+    }
+    frame = _frames.dequeue();
+    _frameTaken.wakeAll();
+    return true;
+  }
+  return false;
+}
+
+void VideoDecoder::skipFrames(int count)
+{
+  QMutexLocker locker(&_mutex);
+  // Frames already decoded go first, the decoder only grabs the others
+  while (count > 0 && !_frames.isEmpty()) {
+    delete _frames.dequeue().image;
+    --count;
+  }
+  _framesToSkip += count;
+  _frameTaken.wakeAll();
+}
+
+void VideoDecoder::setLoop(bool on)
+{
+  QMutexLocker locker(&_mutex);
+  _loop = on;
+  _frameTaken.wakeAll();
+}
+
+void VideoDecoder::setClockMode(bool on)
+{
+  QMutexLocker locker(&_mutex);
+  _clockMode = on;
+  _clockRunning = false;
+  _frameAvailable.wakeAll();
+}
+
+void VideoDecoder::pauseClock()
+{
+  QMutexLocker locker(&_mutex);
+  _clockRunning = false;
+}
+
+void VideoDecoder::seek(qint64 position)
+{
+  QMutexLocker locker(&_mutex);
+  clearFrames();
+  _seekPosition = std::max(qint64(0), position);
+  if (_seekPosition) {
+    startIndexing();
+  }
+  _framesToSkip = 0;
+  _endOfFile = false;
+  _clockRunning = false;
+  _frameTaken.wakeAll();
+}
+
+qint64 VideoDecoder::positionAt(double timestamp)
+{
+  QMutexLocker locker(&_mutex);
+  startIndexing();
+  if (_indexed && !_timestamps.isEmpty()) {
+    // Last frame shown at that time
+    const QVector<double>::const_iterator it = std::upper_bound(_timestamps.constBegin(), _timestamps.constEnd(), timestamp);
+    return std::max(qint64(0), static_cast<qint64>(it - _timestamps.constBegin()) - 1);
+  }
+  return std::max(qint64(0), static_cast<qint64>(timestamp / _framePeriod));
+}
+
+qint64 VideoDecoder::frameCount()
+{
+  QMutexLocker locker(&_mutex);
+  return _indexed ? _timestamps.size() : _estimatedFrameCount;
+}
+
+void VideoDecoder::stop()
+{
+  QMutexLocker locker(&_mutex);
+  _continue = false;
+  _frameTaken.wakeAll();
+  _frameAvailable.wakeAll();
+}
+
+void VideoDecoder::run()
+{
+  _capture = openCapture();
+  QMutexLocker locker(&_mutex);
+  if (!_capture) {
+    _endOfFile = true;
+    _frameAvailable.wakeAll();
+    return;
+  }
+  const double fps = _capture->get(ZART_CV_CAP_PROP_FPS);
+  if (fps > 0.0) {
+    _framePeriod = 1000.0 / fps;
+  }
+  _estimatedFrameCount = std::max(qint64(0), static_cast<qint64>(_capture->get(ZART_CV_CAP_PROP_FRAME_COUNT)));
+  while (_continue) {
+    if (_seekPosition != -1) {
+      const qint64 position = _seekPosition;
+      _seekPosition = -1;
+      locker.unlock();
+      Frame frame;
+      const bool ok = seekTo(position, frame);
+      locker.relock();
+      if (_seekPosition != -1) {
+        // Another seek was requested meanwhile
+        if (ok) {
+          delete frame.image;
+        }
+        continue;
+      }
+      if (ok) {
+        _frames.enqueue(frame);
+      }
+      _endOfFile = !ok;
+      _frameAvailable.wakeAll();
+      continue;
+    }
+    if (_endOfFile || (_frames.size() >= _readAhead && !_framesToSkip)) {
+      // Nothing to decode: the time to open a spare decoder, if looping needs one
+      if (_loop && !_seekable && !_spare) {
+        locker.unlock();
+        cv::VideoCapture * spare = openCapture();
+        locker.relock();
+        _spare = spare;
+        continue;
+      }
+      _frameTaken.wait(&_mutex);
+      continue;
+    }
+    // Frames which would be dropped anyway are not decoded
+    bool decode = true;
+    if (_framesToSkip) {
+      --_framesToSkip;
+      decode = false;
+    } else if (_clockMode && _clockRunning && (_lastTimestamp + 2 * _framePeriod < mediaTime())) {
+      decode = false;
+    }
+    const bool loop = _loop;
+    locker.unlock();
+    Frame frame;
+    bool ok = nextFrame(frame, decode);
+    if (!ok && loop) {
+      ok = loopToStart() && nextFrame(frame, decode);
+      if (!ok && _seekable) {
+        // Seeking "worked" but nothing can be read afterwards
+        _seekable = false;
+        ok = loopToStart() && nextFrame(frame, decode);
+      }
+    }
+    locker.relock();
+    if (!ok) {
+      _endOfFile = true;
+    } else if (decode && _seekPosition == -1) {
+      _frames.enqueue(frame);
+    } else if (decode) {
+      delete frame.image;
+    }
+    _frameAvailable.wakeAll();
+  }
+}
+
+cv::VideoCapture * VideoDecoder::openCapture() const
+{
+  cv::VideoCapture * capture = new cv::VideoCapture;
+  try {
+#ifdef CVCAPTURE_HAS_THREADS_PARAMETER
+    std::vector<int> parameters;
+    if (_threads > 0) {
+      parameters.push_back(cv::CAP_PROP_N_THREADS);
+      parameters.push_back(_threads);
+    }
+    capture->open(_filename.toLocal8Bit().constData(), cv::CAP_ANY, parameters);
+#else
+    capture->open(_filename.toLocal8Bit().constData());
+#endif
+  } catch (cv::Exception & e) {
+    std::cerr << "[ZArt] Cannot open video file (" << e.what() << ")" << std::endl;
+  }
+  if (!capture->isOpened()) {
+    delete capture;
+    return nullptr;
+  }
+  return capture;
+}
+
+bool VideoDecoder::nextFrame(Frame & frame, bool decode)
+{
+  if (!_capture) {
+    return false;
+  }
+  Tracing::Span span(decode ? "decode" : "grab");
+  try {
+    if (!_capture->grab()) {
+      return false;
+    }
+  } catch (cv::Exception &) {
+    return false;
+  }
+  _lastTimestamp = _capture->get(ZART_CV_CAP_PROP_POS_MSEC) + _timeOffset;
+  return !decode || retrieveFrame(frame);
+}
+
+bool VideoDecoder::retrieveFrame(Frame & frame)
+{
+  cv::Mat * image = new cv::Mat;
+  try {
+    if (!_capture->retrieve(*image) || image->empty()) {
+      delete image;
+      return false;
+    }
+  } catch (cv::Exception &) {
+    delete image;
+    return false;
+  }
+  frame.image = image;
+  frame.position = static_cast<qint64>(_capture->get(ZART_CV_CAP_PROP_POS_FRAMES)) - 1;
+  frame.timestamp = _capture->get(ZART_CV_CAP_PROP_POS_MSEC) + _timeOffset;
+  return true;
+}
+
+bool VideoDecoder::grabUntil(qint64 position)
+{
+  while (_capture && static_cast<qint64>(_capture->get(ZART_CV_CAP_PROP_POS_FRAMES)) <= position) {
+    if (!_capture->grab()) {
+      return false;
+    }
+  }
+  return _capture != nullptr;
+}
+
+bool VideoDecoder::seekTo(qint64 position, Frame & frame)
+{
+  _timeOffset = 0.0;
+  const double expected = indexedTimestamp(position);
+  bool ok = false;
+  if (_seekable && _capture) {
+    _capture->set(ZART_CV_CAP_PROP_POS_FRAMES, static_cast<double>(position));
+    ok = grabUntil(position) && (expected < 0.0 || std::fabs(_capture->get(ZART_CV_CAP_PROP_POS_MSEC) - expected) < _framePeriod / 2);
+  }
+  if (!ok) {
+    // Frame accurate whatever the container: decode everything from the start
+    delete _capture;
+    _capture = openCapture();
+    ok = grabUntil(position);
+  }
+  if (!ok || !retrieveFrame(frame)) {
+    return false;
+  }
+  _lastTimestamp = frame.timestamp;
+  return true;
+}
+
+bool VideoDecoder::loopToStart()
+{
+  // Timestamps keep increasing, the playback clock does not have to know
+  _timeOffset = _lastTimestamp + _framePeriod;
+  if (_seekable && _capture) {
+    _capture->set(ZART_CV_CAP_PROP_POS_FRAMES, 0);
+    if (static_cast<qint64>(_capture->get(ZART_CV_CAP_PROP_POS_FRAMES)) == 0) {
+      return true;
+    }
+    _seekable = false;
+  }
+  // Usually opened in advance, while the queue was full
+  if (!_spare) {
+    _spare = openCapture();
+  }
+  delete _capture;
+  _capture = _spare;
+  _spare = nullptr;
+  return _capture != nullptr;
+}
+
+double VideoDecoder::indexedTimestamp(qint64 position)
+{
+  QMutexLocker locker(&_mutex);
+  return (_indexed && position < _timestamps.size()) ? _timestamps[static_cast<int>(position)] : -1.0;
+}
+
+double VideoDecoder::mediaTime() const
+{
+  return (ImageSource::monotonicTime() - _clockOrigin) / 1000.0;
+}
+
+void VideoDecoder::startIndexing()
+{
+  // Called with _mutex locked. Plain playback never needs the index.
+  if (_indexed || _indexer.joinable() || !QSettings().value("VideoFileSource/BuildIndex", true).toBool()) {
+    return;
+  }
+  _indexer = std::thread(&VideoDecoder::buildIndex, this);
+}
+
+void VideoDecoder::buildIndex()
+{
+  // Grabbing demuxes and decodes, but skips the color conversion
+  cv::VideoCapture * capture = openCapture();
+  if (!capture) {
+    return;
+  }
+  QVector<double> timestamps;
+  try {
+    while (!_stopIndexing && capture->grab()) {
+      timestamps.push_back(capture->get(ZART_CV_CAP_PROP_POS_MSEC));
+    }
+  } catch (cv::Exception &) {
+    _stopIndexing = true;
+  }
+  delete capture;
+  if (_stopIndexing) {
+    return;
+  }
+  QMutexLocker locker(&_mutex);
+  _timestamps = timestamps;
+  _indexed = true;
+}
+
+void VideoDecoder::clearFrames()
+{
+  while (!_frames.isEmpty()) {
+    delete _frames.dequeue().image;
+  }
+}
@@ -44,41 +44,52 @@
  * knowledge of the CeCILL license and that you accept its terms.
  */
 #include "VideoFileSource.h"
+#include <QApplication>
 #include <QFileInfo>
 #include <QMessageBox>
+#include <QSettings>
 #include <iostream>
 #include "Common.h"
+#include "VideoDecoder.h"
 
 VideoFileSource::VideoFileSource()
 {
-  _capture = 0;
+  _decoder = nullptr;
   _filename = "";
   _videoIsReadable = false;
   _loop = true;
+  _clockMode = false;
+  _position = -1;
 }
 
 VideoFileSource::~VideoFileSource()
 {
-  delete _capture;
-  _capture = nullptr;
+  delete _decoder;
+  _decoder = nullptr;
 }
 
 void VideoFileSource::capture()
 {
-  if (!_videoIsReadable) {
+  if (!_videoIsReadable || !_decoder) {
     return;
   }
-  cv::Mat * newImage = new cv::Mat;
-  if (!_capture->read(*newImage)) {
-    _capture->release();
-    delete _capture;
-    _capture = nullptr;
-    loadVideoFile(_filename);
-    if (_loop) {
-      _capture->read(*newImage);
-    }
+  VideoDecoder::Frame frame;
+  if (_decoder->takeFrame(frame)) {
+    setImage(frame.image);
+    setFrameInfo(frameInfo().timestamp, static_cast<quint64>(frame.position));
+    _position = frame.position;
+  } else {
+    // End of the file (not looping): the next playback starts over
+    setImage(nullptr);
+    _decoder->seek(0);
+  }
+}
+
+void VideoFileSource::skipFrames(int count)
+{
+  if (_decoder && count > 0) {
+    _decoder->skipFrames(count);
   }
-  setImage(newImage);
 }
 
 bool VideoFileSource::loadVideoFile(QString filename)
@@ -87,29 +98,43 @@ bool VideoFileSource::loadVideoFile(QString filename)
   if (!info.isReadable()) {
     return false;
   }
-  _capture = nullptr;
+  delete _decoder;
+  _decoder = nullptr;
+  // Checked here, in the GUI thread, decoding errors are then only reported as the end of the file
+  cv::VideoCapture * capture = nullptr;
   try {
-    _capture = new cv::VideoCapture(filename.toLocal8Bit().constData());
+    capture = new cv::VideoCapture(filename.toLocal8Bit().constData());
   } catch (cv::Exception & e) {
     std::cerr << "Error: Cannot open video file." << std::endl;
     std::cerr << "OpenCV says: " << e.what() << std::endl;
   }
-  if (_capture) {
+  if (capture) {
     cv::Mat image;
-    if (_capture->read(image)) {
+    if (capture->read(image)) {
       _filename = filename;
       _filePath = info.absolutePath();
       _videoIsReadable = true;
       setWidth(image.cols);
       setHeight(image.rows);
+      QSettings settings;
+      _decoder = new VideoDecoder(filename, settings.value("VideoFileSource/ReadAhead", DefaultReadAhead).toInt(), settings.value("VideoFileSource/DecoderThreads", 0).toInt());
+      _decoder->setLoop(_loop);
+      _decoder->setClockMode(_clockMode);
+      _decoder->start();
+      _position = -1;
     } else {
       _filename.clear();
       _videoIsReadable = false;
       setWidth(0);
       setHeight(0);
       setImage(nullptr);
-      QMessageBox::critical(0, "Error", "Could not decode video file.\nTry to install gstreamer-ffmpeg...");
+      if (qobject_cast<QApplication *>(QCoreApplication::instance())) {
+        QMessageBox::critical(0, "Error", "Could not decode video file.\nTry to install gstreamer-ffmpeg...");
+      } else {
+        std::cerr << "Error: Could not decode video file." << std::endl;
+      }
     }
+    delete capture;
   }
   return _videoIsReadable;
 }
@@ -124,7 +149,49 @@ const QString & VideoFileSource::filePath() const
   return _filePath;
 }
 
+void VideoFileSource::setClockMode(bool on)
+{
+  _clockMode = on;
+  if (_decoder) {
+    _decoder->setClockMode(on);
+  }
+}
+
+void VideoFileSource::pauseClock()
+{
+  if (_decoder) {
+    _decoder->pauseClock();
+  }
+}
+
+void VideoFileSource::seek(qint64 position)
+{
+  if (_decoder) {
+    _decoder->seek(position);
+  }
+}
+
+void VideoFileSource::seekTime(double ms)
+{
+  if (_decoder) {
+    _decoder->seek(_decoder->positionAt(ms));
+  }
+}
+
+qint64 VideoFileSource::frameCount() const
+{
+  return _decoder ? _decoder->frameCount() : 0;
+}
+
+qint64 VideoFileSource::position() const
+{
+  return _position;
+}
+
 void VideoFileSource::setLoop(bool on)
 {
   _loop = on;
+  if (_decoder) {
+    _decoder->setLoop(on);
+  }
 }
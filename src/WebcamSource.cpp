@@ -46,26 +46,38 @@
 #include "WebcamSource.h"
 #include <QCoreApplication>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QFileInfo>
 #include <QList>
+#include <QMutexLocker>
+#include <QRegExp>
 #include <QSettings>
-#include <QSplashScreen>
-#include <QStatusBar>
 #include <QStringList>
+#include <QWaitCondition>
 #include <QtGlobal>
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <set>
 #include <thread>
+#include <vector>
 #include "Common.h"
 using namespace std;
 
 #if CV_MAJOR_VERSION >= 3
 #define ZART_CV_CAP_PROP_FRAME_WIDTH cv::VideoCaptureProperties::CAP_PROP_FRAME_WIDTH
 #define ZART_CV_CAP_PROP_FRAME_HEIGHT cv::VideoCaptureProperties::CAP_PROP_FRAME_HEIGHT
+#define ZART_CV_CAP_PROP_FOURCC cv::VideoCaptureProperties::CAP_PROP_FOURCC
+#define ZART_CV_CAP_PROP_FPS cv::VideoCaptureProperties::CAP_PROP_FPS
+#define ZART_CV_CAP_PROP_POS_MSEC cv::VideoCaptureProperties::CAP_PROP_POS_MSEC
+#define ZART_CV_CAP_PROP_BUFFERSIZE cv::VideoCaptureProperties::CAP_PROP_BUFFERSIZE
 #else
 #define ZART_CV_CAP_PROP_FRAME_WIDTH CV_CAP_PROP_FRAME_WIDTH
 #define ZART_CV_CAP_PROP_FRAME_HEIGHT CV_CAP_PROP_FRAME_HEIGHT
+#define ZART_CV_CAP_PROP_FOURCC CV_CAP_PROP_FOURCC
+#define ZART_CV_CAP_PROP_FPS CV_CAP_PROP_FPS
+#define ZART_CV_CAP_PROP_POS_MSEC CV_CAP_PROP_POS_MSEC
 #endif
 
 #if (CV_MAJOR_VERSION > 3) || ((CV_MAJOR_VERSION == 3) && (CV_MINOR_VERSION > 4)) || ((CV_MAJOR_VERSION == 3) && (CV_MINOR_VERSION == 4) && (CV_SUBMINOR_VERSION >= 4))
@@ -76,6 +88,7 @@ using namespace std;
 #include <errno.h>
 #include <fcntl.h>
 #include <linux/videodev2.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -83,7 +96,11 @@ using namespace std;
 #endif
 
 QVector<QList<QSize>> WebcamSource::_webcamResolutions;
+QVector<QList<WebcamSource::CaptureMode>> WebcamSource::_webcamCaptureModes;
 QList<int> WebcamSource::_webcamList;
+QStringList WebcamSource::_webcamIdentities;
+QList<bool> WebcamSource::_webcamAvailability;
+QStringList WebcamSource::_openCameras;
 
 namespace
 {
@@ -91,9 +108,75 @@ class QSizeCompare {
 public:
   bool operator()(const QSize & a, const QSize & b) const { return ((a.width() < b.width()) || ((a.width() == b.width()) && (a.height() < b.height()))); }
 };
+
+// Device name and bus location, whatever the number OpenCV opens it with.
+// Empty if the platform does not tell: the settings of such a camera are not kept.
+QMutex & openCamerasMutex()
+{
+  static QMutex mutex;
+  return mutex;
+}
+
+// The camera whose backends are being measured, guarded by probeMutex()
+QMutex & probeMutex()
+{
+  static QMutex mutex;
+  return mutex;
+}
+
+QWaitCondition & probeFinished()
+{
+  static QWaitCondition condition;
+  return condition;
+}
+
+QString probedIdentity;
+std::atomic<bool> probeCancelled(false);
+
+QString openCVCameraIdentity(int index)
+{
+#if defined(_IS_UNIX_)
+  const QString device = QString("/sys/class/video4linux/video%1").arg(index);
+  QFile file(device + "/name");
+  if (file.open(QFile::ReadOnly)) {
+    const QString name = QString::fromLocal8Bit(file.readAll()).trimmed();
+    const QString location = QFileInfo(device + "/device").canonicalFilePath().section('/', -1);
+    if (!name.isEmpty() && !location.isEmpty()) {
+      return QString("OpenCV:%1@%2").arg(name).arg(location);
+    }
+  }
+#else
+  Q_UNUSED(index)
+#endif
+  return QString();
+}
+
+#ifdef HAS_V4L2
+float maximumFrameRate(int fd, unsigned int pixelFormat, const QSize & size)
+{
+  float fps = 0.0f;
+  v4l2_frmivalenum interval;
+  memset(&interval, 0, sizeof(interval));
+  interval.pixel_format = pixelFormat;
+  interval.width = size.width();
+  interval.height = size.height();
+  while (!ioctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &interval)) {
+    // Stepwise and continuous ranges are described by a single entry
+    const v4l2_fract & fraction = (interval.type == V4L2_FRMIVAL_TYPE_DISCRETE) ? interval.discrete : interval.stepwise.min;
+    if (fraction.numerator) {
+      fps = std::max(fps, static_cast<float>(fraction.denominator) / fraction.numerator);
+    }
+    if (interval.type != V4L2_FRMIVAL_TYPE_DISCRETE) {
+      break;
+    }
+    ++interval.index;
+  }
+  return fps;
+}
+#endif
 } // namespace
 
-WebcamSource::WebcamSource() : _capture(nullptr), _cameraIndex(-1), _captureSize(640, 480) {}
+WebcamSource::WebcamSource() : _capture(nullptr), _cameraIndex(-1), _captureSize(640, 480), _captureSizeChanged(false), _timeToFirstFrame(-1) {}
 
 WebcamSource::~WebcamSource()
 {
@@ -101,21 +184,32 @@ WebcamSource::~WebcamSource()
     delete _capture;
     _capture = nullptr;
   }
+  setCameraOpen(false);
 }
 
 void WebcamSource::capture()
 {
+  if (takeCaptureSizeChange() && !reconfigure()) {
+    stop();
+    start();
+  }
   cv::Mat * anImage = new cv::Mat;
   if (_capture && _capture->read(*anImage)) {
     setImage(anImage);
+    // The V4L2 backend reports the driver timestamp, others their own clock or nothing
+    const qint64 now = frameInfo().timestamp;
+    const qint64 timestamp = static_cast<qint64>(_capture->get(ZART_CV_CAP_PROP_POS_MSEC) * 1000.0);
+    if (timestamp > now - MaximumCaptureAge && timestamp <= now) {
+      setFrameInfo(timestamp, frameInfo().sequence);
+    }
   } else {
     delete anImage;
   }
 }
 
-const QList<int> & WebcamSource::getWebcamList()
+QList<int> WebcamSource::getWebcamList()
 {
-  _webcamList.clear();
+  QList<int> webcamList;
 #if defined(HAS_V4L2)
   for (int i = 0; i <= 10; ++i) {
     QString filename = QString("/dev/video%1").arg(i);
@@ -147,7 +241,7 @@ const QList<int> & WebcamSource::getWebcamList()
 
       close(fd);
       if (isCapture && camera) {
-        _webcamList.push_back(i);
+        webcamList.push_back(i);
       }
     }
   }
@@ -161,7 +255,7 @@ const QList<int> & WebcamSource::getWebcamList()
       cv::VideoCapture capture;
       capture.open(i);
       if (captureIsValid(capture, i)) {
-        _webcamList.push_back(i);
+        webcamList.push_back(i);
       }
       capture.release();
     }
@@ -173,26 +267,20 @@ const QList<int> & WebcamSource::getWebcamList()
     if (capture && capture->open(i)) {
       capture->release();
       delete capture;
-      _webcamList.push_back(i);
+      webcamList.push_back(i);
     }
   }
 #endif
-  TSHOW(_webcamList);
-  return _webcamList;
+  TSHOW(webcamList);
+  return webcamList;
 }
 
 int WebcamSource::getFirstUnusedWebcam()
 {
-  if (!_webcamList.size()) {
-    getWebcamList();
-  }
-  QList<int>::iterator it = _webcamList.begin();
-  while (it != _webcamList.end()) {
-    TRACE << "Looking for first unused webcam : " << *it;
-    if (isWebcamUnused(*it)) {
-      return *it;
+  for (int i = 0; i < _webcamList.size(); ++i) {
+    if (_webcamAvailability[i]) {
+      return _webcamList[i];
     }
-    ++it;
   }
   return -1;
 }
@@ -252,6 +340,10 @@ const QList<int> & WebcamSource::getCachedWebcamList()
 void WebcamSource::setCameraIndex(int i)
 {
   _cameraIndex = i;
+  // Kept here, the static lists may be updated (hotplug) while capturing
+  const int position = _webcamList.indexOf(i);
+  _cameraIdentity = webcamIdentity(position);
+  _captureModes = webcamCaptureModes(position);
 }
 
 void WebcamSource::stop()
@@ -260,16 +352,49 @@ void WebcamSource::stop()
     delete _capture;
     _capture = nullptr;
   }
+  setCameraOpen(false);
+}
+
+bool WebcamSource::isCameraOpen(const QString & identity)
+{
+  QMutexLocker locker(&openCamerasMutex());
+  return !identity.isEmpty() && _openCameras.contains(identity);
+}
+
+void WebcamSource::setCameraOpen(bool open)
+{
+  // Read by the camera discovery thread
+  QMutexLocker locker(&openCamerasMutex());
+  if (!_openIdentity.isEmpty()) {
+    _openCameras.removeOne(_openIdentity);
+    _openIdentity.clear();
+  }
+  if (open && !_cameraIdentity.isEmpty()) {
+    _openIdentity = _cameraIdentity;
+    _openCameras.append(_openIdentity);
+  }
 }
 
 void WebcamSource::start()
 {
   if (!_capture && _cameraIndex != -1) {
+    if (!_cameraIdentity.isEmpty()) {
+      cancelBackendProbe(_cameraIdentity);
+    }
+    QElapsedTimer timer;
+    timer.start();
+    takeCaptureSizeChange();
     _capture = new cv::VideoCapture;
     cv::Mat * capturedImage = new cv::Mat;
-    if (_capture && _capture->open(_cameraIndex)) {
+    if (_capture && openCapture(*_capture, _cameraIndex, captureBackend(), captureSize(), captureBufferSize())) {
+      setCameraOpen(true);
+      // The format is set before the first read, changing it afterwards restarts the stream
+      applyCaptureMode();
       try {
-        _capture->read(*capturedImage); // TODO : Check
+        if (!_capture->read(*capturedImage)) {
+          delete capturedImage;
+          capturedImage = nullptr;
+        }
       } catch (cv::Exception &) {
         delete capturedImage;
         capturedImage = nullptr;
@@ -280,26 +405,106 @@ void WebcamSource::start()
     }
     setImage(capturedImage);
     if (image()) {
-      QSize imageSize(image()->cols, image()->rows);
-      if (imageSize != _captureSize) {
-        _capture->set(ZART_CV_CAP_PROP_FRAME_WIDTH, _captureSize.width());
-        _capture->set(ZART_CV_CAP_PROP_FRAME_HEIGHT, _captureSize.height());
-        cv::Mat * anImage = new cv::Mat;
-        // Read two images!
-        _capture->grab();
-        // _capture->read(*anImage);
-        if (_capture->read(*anImage)) {
-          setImage(anImage);
-        } else {
-          delete anImage;
-        }
-      }
-      setWidth(image()->cols);
-      setHeight(image()->rows);
+      setTimeToFirstFrame(static_cast<int>(timer.elapsed()));
+      CaptureMode mode;
+      mode.pixelFormat = static_cast<unsigned int>(_capture->get(ZART_CV_CAP_PROP_FOURCC));
+      mode.size = QSize(image()->cols, image()->rows);
+      mode.fps = static_cast<float>(_capture->get(ZART_CV_CAP_PROP_FPS));
+      saveLastKnownGoodMode(mode);
     }
   }
 }
 
+bool WebcamSource::reconfigure()
+{
+  if (!_capture) {
+    return false;
+  }
+  QElapsedTimer timer;
+  timer.start();
+  applyCaptureMode();
+  cv::Mat * anImage = new cv::Mat;
+  if (!_capture->read(*anImage) || !anImage->rows) {
+    delete anImage;
+    return false;
+  }
+  setImage(anImage);
+  setTimeToFirstFrame(static_cast<int>(timer.elapsed()));
+  return true;
+}
+
+void WebcamSource::applyCaptureMode()
+{
+  const QSize size = captureSize();
+  CaptureMode mode = lastKnownGoodMode();
+  if (!mode.pixelFormat) {
+    // Ask for the fastest known mode, which is often a compressed one
+    mode = bestCaptureMode(_captureModes, size);
+  }
+  if (mode.pixelFormat) {
+    _capture->set(ZART_CV_CAP_PROP_FOURCC, mode.pixelFormat);
+  }
+  _capture->set(ZART_CV_CAP_PROP_FRAME_WIDTH, size.width());
+  _capture->set(ZART_CV_CAP_PROP_FRAME_HEIGHT, size.height());
+  if (mode.fps > 0.0f) {
+    _capture->set(ZART_CV_CAP_PROP_FPS, mode.fps);
+  }
+}
+
+const QList<WebcamSource::CaptureMode> & WebcamSource::captureModes() const
+{
+  return _captureModes;
+}
+
+WebcamSource::CaptureMode WebcamSource::lastKnownGoodMode()
+{
+  CaptureMode mode;
+  mode.pixelFormat = 0;
+  mode.size = captureSize();
+  mode.fps = 0.0f;
+  if (_cameraIdentity.isEmpty()) {
+    return mode;
+  }
+  // Format code, size and frame rate
+  const QStringList values = QSettings().value(settingsKey(_cameraIdentity, "LastFormat")).toStringList();
+  if (values.size() == 3 && values[1] == QString("%1x%2").arg(mode.size.width()).arg(mode.size.height())) {
+    mode.pixelFormat = values[0].toUInt();
+    mode.fps = values[2].toFloat();
+  }
+  return mode;
+}
+
+void WebcamSource::saveLastKnownGoodMode(const CaptureMode & mode)
+{
+  if (_cameraIdentity.isEmpty() || !mode.pixelFormat || mode.size != captureSize()) {
+    return;
+  }
+  QStringList values;
+  values << QString::number(mode.pixelFormat) << QString("%1x%2").arg(mode.size.width()).arg(mode.size.height()) << QString::number(mode.fps);
+  QSettings().setValue(settingsKey(_cameraIdentity, "LastFormat"), values);
+}
+
+void WebcamSource::setTimeToFirstFrame(int ms)
+{
+  _timeToFirstFrame = ms;
+  std::cout << "[ZArt] Webcam " << _cameraIndex << ": first frame after " << ms << " ms" << std::endl;
+}
+
+int WebcamSource::timeToFirstFrame() const
+{
+  return _timeToFirstFrame;
+}
+
+WebcamSource::Backend WebcamSource::captureBackend() const
+{
+  return cameraBackend(_cameraIdentity);
+}
+
+int WebcamSource::captureBufferSize() const
+{
+  return cameraBufferSize(_cameraIdentity);
+}
+
 void WebcamSource::setCaptureSize(int width, int height)
 {
   setCaptureSize(QSize(width, height));
@@ -307,15 +512,37 @@ void WebcamSource::setCaptureSize(int width, int height)
 
 void WebcamSource::setCaptureSize(const QSize & size)
 {
-  _captureSize = size;
-  if (_capture) {
-    stop();
-    start();
+  QMutexLocker locker(&_captureSizeMutex);
+  if (size == _captureSize) {
+    return;
   }
+  _captureSize = size;
+  // An open device is reconfigured by the next capture(), in the capturing thread
+  _captureSizeChanged = isStarted();
+}
+
+void WebcamSource::setActualCaptureSize(const QSize & size)
+{
+  QMutexLocker locker(&_captureSizeMutex);
+  _captureSize = size;
+}
+
+bool WebcamSource::takeCaptureSizeChange()
+{
+  QMutexLocker locker(&_captureSizeMutex);
+  const bool changed = _captureSizeChanged;
+  _captureSizeChanged = false;
+  return changed;
+}
+
+bool WebcamSource::isStarted() const
+{
+  return _capture != nullptr;
 }
 
 QSize WebcamSource::captureSize()
 {
+  QMutexLocker locker(&_captureSizeMutex);
   return _captureSize;
 }
 
@@ -324,235 +551,621 @@ int WebcamSource::cameraIndex()
   return _cameraIndex;
 }
 
-void WebcamSource::retrieveWebcamResolutions(const QList<int> & camList, QSplashScreen * splashScreen, QStatusBar * statusBar)
+QString WebcamSource::cameraIdentity() const
+{
+  return _cameraIdentity;
+}
+
+QList<WebcamSource::CameraInfo> WebcamSource::discoverCameras()
+{
+  const QList<int> indexes = getWebcamList();
+  std::vector<CameraInfo> cameras(indexes.size());
+  for (int i = 0; i < indexes.size(); ++i) {
+    cameras[i].index = indexes[i];
+    cameras[i].available = false;
+  }
+  // Devices are probed in parallel, opening a camera may take a while
+  std::vector<std::thread> threads;
+  for (CameraInfo & camera : cameras) {
+    threads.push_back(std::thread(&WebcamSource::probeCamera, std::ref(camera)));
+  }
+  for (std::thread & thread : threads) {
+    thread.join();
+  }
+  qDebug("Done checking resolutions");
+  QList<CameraInfo> result;
+  for (const CameraInfo & camera : cameras) {
+    result.push_back(camera);
+  }
+  return result;
+}
+
+void WebcamSource::probeCamera(CameraInfo & camera)
 {
 #if defined(HAS_V4L2)
-  retrieveWebcamResolutionsV4L2(camList);
-  Q_UNUSED(splashScreen)
-  Q_UNUSED(statusBar)
+  probeCameraV4L2(camera);
 #else
-  retrieveWebcamResolutionsOpenCV(camList, splashScreen, statusBar);
+  camera.identity = openCVCameraIdentity(camera.index);
+  probeCameraOpenCV(camera);
 #endif
-  return;
 }
 
-void WebcamSource::retrieveWebcamResolutionsOpenCV(const QList<int> & camList, QSplashScreen * splashScreen, QStatusBar * statusBar)
+void WebcamSource::probeCameraOpenCV(CameraInfo & camera)
 {
   QSettings settings;
-  QList<std::set<QSize, QSizeCompare>> resolutions;
-  QList<int>::const_iterator it = camList.begin();
-  int iCam = 0;
-  while (it != camList.end()) {
-    resolutions.push_back(std::set<QSize, QSizeCompare>());
-    cv::VideoCapture * capture = nullptr;
-    try {
-      capture = new cv::VideoCapture;
-      if (!canOpenDeviceFile(*it) || !capture->open(*it) || !captureIsValid(*capture, *it)) {
-        delete capture;
-        capture = nullptr;
+  const QString key = settingsKey(camera.identity, "Resolutions");
+  if (isCameraOpen(camera.identity)) {
+    // Captured by ZArt, it cannot be opened again: its resolutions were saved when it was detected
+    camera.available = true;
+    for (const QString & resolution : settings.value(key).toStringList()) {
+      const QStringList str = resolution.split(QChar('x'));
+      if (str.size() == 2) {
+        camera.resolutions.push_back(QSize(str[0].toInt(), str[1].toInt()));
       }
-    } catch (cv::Exception & e) {
-      std::cerr << "Error: cannot open camera " << *it << std::endl;
-      std::cerr << "OpenCV says: " << e.what() << std::endl;
-    }
-    if (capture) {
-      QStringList resolutionsStrList = settings.value(QString("WebcamSource/ResolutionsListForCam%1").arg(camList[iCam])).toStringList();
-      bool settingsAreFine = !resolutionsStrList.isEmpty();
-      for (int i = 0; i < resolutionsStrList.size() && settingsAreFine; ++i) {
-        QStringList str = resolutionsStrList.at(i).split(QChar('x'));
-        int w = str[0].toInt();
-        int h = str[1].toInt();
-        bool ok1 = capture->set(ZART_CV_CAP_PROP_FRAME_WIDTH, w);
-        bool ok2 = capture->set(ZART_CV_CAP_PROP_FRAME_HEIGHT, h);
-        if (!ok1 || !ok2) {
-          continue;
-        }
-        cv::Mat tmpA;
-        capture->read(tmpA);
-        QSize size(static_cast<int>(capture->get(ZART_CV_CAP_PROP_FRAME_WIDTH)), static_cast<int>(capture->get(ZART_CV_CAP_PROP_FRAME_HEIGHT)));
-        if (size == QSize(w, h)) {
-          resolutions.back().insert(size);
-        } else {
-          settingsAreFine = false;
-        }
+    }
+    return;
+  }
+  std::set<QSize, QSizeCompare> resolutions;
+  cv::VideoCapture * capture = nullptr;
+  try {
+    capture = new cv::VideoCapture;
+    if (!canOpenDeviceFile(camera.index) || !capture->open(camera.index) || !captureIsValid(*capture, camera.index)) {
+      delete capture;
+      capture = nullptr;
+    }
+  } catch (cv::Exception & e) {
+    std::cerr << "Error: cannot open camera " << camera.index << std::endl;
+    std::cerr << "OpenCV says: " << e.what() << std::endl;
+  }
+  if (!capture) {
+    std::cout << "[ZArt] Cannot use webcam " << camera.index << std::endl;
+    return;
+  }
+  {
+    cv::Mat tmp;
+    camera.available = capture->read(tmp);
+  }
+  QStringList resolutionsStrList = settings.value(key).toStringList();
+  bool settingsAreFine = !resolutionsStrList.isEmpty();
+  for (int i = 0; i < resolutionsStrList.size() && settingsAreFine; ++i) {
+    QStringList str = resolutionsStrList.at(i).split(QChar('x'));
+    int w = str[0].toInt();
+    int h = str[1].toInt();
+    bool ok1 = capture->set(ZART_CV_CAP_PROP_FRAME_WIDTH, w);
+    bool ok2 = capture->set(ZART_CV_CAP_PROP_FRAME_HEIGHT, h);
+    if (!ok1 || !ok2) {
+      continue;
+    }
+    cv::Mat tmpA;
+    capture->read(tmpA);
+    QSize size(static_cast<int>(capture->get(ZART_CV_CAP_PROP_FRAME_WIDTH)), static_cast<int>(capture->get(ZART_CV_CAP_PROP_FRAME_HEIGHT)));
+    if (size == QSize(w, h)) {
+      resolutions.insert(size);
+    } else {
+      settingsAreFine = false;
+    }
+  }
+
+  if (!settingsAreFine) {
+    resolutions.clear();
+
+    // Default size ?
+    {
+      cv::Mat tmp;
+      capture->read(tmp);
+      QSize defaultSize(static_cast<int>(capture->get(ZART_CV_CAP_PROP_FRAME_WIDTH)), static_cast<int>(capture->get(ZART_CV_CAP_PROP_FRAME_HEIGHT)));
+      if (defaultSize.isValid() && !defaultSize.isEmpty()) {
+        resolutions.insert(defaultSize);
       }
+    }
 
-      if (!settingsAreFine) {
-        if (splashScreen) {
-          splashScreen->showMessage(QString("Retrieving webcam #%1 resolutions...\n(almost-brute-force checking!)\nResult will be saved.").arg(iCam + 1), Qt::AlignBottom);
-          qApp->processEvents();
-        }
-        if (statusBar) {
-          statusBar->showMessage(QString("Retrieving webcam #%1 resolutions...").arg(iCam + 1), Qt::AlignBottom);
-          qApp->processEvents();
-        }
-        resolutions.back().clear();
+    int ratioWidth[] = {4, 16, 0};
+    int ratioHeight[] = {3, 9, 0};
+    int widths[] = {320, 640, 800, 1024, 1280, 1600, 1920, 0};
 
-        // Default size ?
-        {
+    for (int i = 0; widths[i]; ++i) {
+      int w = widths[i];
+      for (int ratio = 0; ratioWidth[ratio]; ++ratio) {
+        int h = w * ratioHeight[ratio] / ratioWidth[ratio];
+        try {
           cv::Mat tmp;
           capture->read(tmp);
-          QSize defaultSize(static_cast<int>(capture->get(ZART_CV_CAP_PROP_FRAME_WIDTH)), static_cast<int>(capture->get(ZART_CV_CAP_PROP_FRAME_HEIGHT)));
-          if (defaultSize.isValid() && !defaultSize.isEmpty()) {
-            resolutions.back().insert(defaultSize);
+          capture->set(ZART_CV_CAP_PROP_FRAME_WIDTH, w);
+          capture->set(ZART_CV_CAP_PROP_FRAME_HEIGHT, h);
+          QSize size(static_cast<int>(capture->get(ZART_CV_CAP_PROP_FRAME_WIDTH)), static_cast<int>(capture->get(ZART_CV_CAP_PROP_FRAME_HEIGHT)));
+          if (size.isValid() && !size.isNull()) {
+            resolutions.insert(size);
           }
+        } catch (cv::Exception &) {
+          std::cerr << "Cannot set capture size " << w << "x" << h << std::endl;
         }
+      }
+    }
+  }
+  delete capture;
 
-        int ratioWidth[] = {4, 16, 0};
-        int ratioHeight[] = {3, 9, 0};
-        int widths[] = {320, 640, 800, 1024, 1280, 1600, 1920, 0};
-
-        for (int i = 0; widths[i]; ++i) {
-          int w = widths[i];
-          for (int ratio = 0; ratioWidth[ratio]; ++ratio) {
-            int h = w * ratioHeight[ratio] / ratioWidth[ratio];
-            QSize requestedSize(w, h);
-            try {
-              cv::Mat tmp;
-              capture->read(tmp);
-              capture->set(ZART_CV_CAP_PROP_FRAME_WIDTH, w);
-              capture->set(ZART_CV_CAP_PROP_FRAME_HEIGHT, h);
-              QSize size(static_cast<int>(capture->get(ZART_CV_CAP_PROP_FRAME_WIDTH)), static_cast<int>(capture->get(ZART_CV_CAP_PROP_FRAME_HEIGHT)));
-              if ((splashScreen || statusBar) && resolutions.back().find(size) == resolutions.back().end()) {
-                if (splashScreen) {
-                  splashScreen->showMessage(QString("Retrieving webcam #%1 resolutions... %2x%3\n(brute-force checking!)\nResult will be saved.").arg(iCam + 1).arg(size.width()).arg(size.height()),
-                                            Qt::AlignBottom);
-                }
-                if (statusBar) {
-                  statusBar->showMessage(QString("Retrieving webcam #%1 resolutions... %2x%3").arg(iCam + 1).arg(size.width()).arg(size.height()));
-                }
-                qApp->processEvents();
-              }
-              if (size.isValid() && !size.isNull()) {
-                resolutions.back().insert(size);
-              }
-            } catch (cv::Exception &) {
-              std::cerr << "Cannot set capture size " << w << "x" << h << std::endl;
-            }
-          }
+  QStringList resolutionsList;
+  for (const QSize & size : resolutions) {
+    camera.resolutions.push_back(size);
+    resolutionsList << QString("%1x%2").arg(size.width()).arg(size.height());
+  }
+  if (!camera.identity.isEmpty()) {
+    settings.setValue(key, resolutionsList);
+  }
+}
+
+void WebcamSource::probeCameraV4L2(CameraInfo & camera)
+{
+#if defined(HAS_V4L2)
+  camera.identity = QString::number(camera.index);
+  QString filename = QString("/dev/video%1").arg(camera.index);
+  if (!QFileInfo(filename).isReadable()) {
+    return;
+  }
+  int fd = open(filename.toLocal8Bit().constData(), O_RDWR);
+  if (fd == -1) {
+    return;
+  }
+  // Card name and bus location identify a device whatever its /dev/videoN number
+  v4l2_capability cap;
+  memset(&cap, 0, sizeof(cap));
+  if (!ioctl(fd, VIDIOC_QUERYCAP, &cap)) {
+    camera.identity = QString("%1@%2").arg(reinterpret_cast<const char *>(cap.card)).arg(reinterpret_cast<const char *>(cap.bus_info));
+  }
+
+  // Is a camera?
+  bool isCamera = false;
+  v4l2_input input;
+  input.index = 0;
+  while (!ioctl(fd, VIDIOC_ENUMINPUT, &input)) {
+    if (input.type == V4L2_INPUT_TYPE_CAMERA) {
+      qDebug("[Device %d] is a camera", camera.index);
+      isCamera = true;
+    }
+    ++input.index;
+  }
+  if (isCamera) {
+    // A device already streaming for another process refuses buffer requests.
+    // So does the one captured by ZArt itself, which is available to it.
+    camera.available = isCameraOpen(camera.identity);
+    if (!camera.available) {
+      v4l2_requestbuffers request;
+      memset(&request, 0, sizeof(request));
+      request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+      request.memory = V4L2_MEMORY_MMAP;
+      camera.available = !(ioctl(fd, VIDIOC_REQBUFS, &request) == -1 && errno == EBUSY);
+    }
+
+    std::set<QSize, QSizeCompare> resolutions;
+    v4l2_fmtdesc fmt;
+    fmt.index = 0;
+    fmt.type = V4L2_CAP_VIDEO_CAPTURE;
+    QList<unsigned int> pixelFormats;
+    while (!ioctl(fd, VIDIOC_ENUM_FMT, &fmt)) {
+      qDebug("[Device %d] pixel format %c%c%c%c", camera.index, (char)(fmt.pixelformat & 0xFF), (char)((fmt.pixelformat & 0xFF00) >> 8), (char)((fmt.pixelformat & 0xFF0000) >> 16),
+             (char)((fmt.pixelformat & 0xFF000000) >> 24));
+      pixelFormats += fmt.pixelformat;
+      ++fmt.index;
+    }
+    for (unsigned int pixelformat : pixelFormats) {
+      v4l2_frmsizeenum framesize;
+      framesize.index = 0;
+      framesize.pixel_format = pixelformat;
+      while (!ioctl(fd, VIDIOC_ENUM_FRAMESIZES, &framesize)) {
+        if (framesize.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+          QSize size(framesize.discrete.width, framesize.discrete.height);
+          resolutions.insert(size);
+          CaptureMode mode;
+          mode.pixelFormat = pixelformat;
+          mode.size = size;
+          mode.fps = maximumFrameRate(fd, pixelformat, size);
+          camera.modes.push_back(mode);
         }
+        ++framesize.index;
       }
-    } else {
-      if (splashScreen) {
-        splashScreen->showMessage(QString("Webcam #%1 cannot be opened of used.").arg(iCam + 1), Qt::AlignBottom);
-        qApp->processEvents();
+    }
+    for (const QSize & size : resolutions) {
+      camera.resolutions.push_back(size);
+    }
+  }
+  close(fd);
+#else
+  Q_UNUSED(camera)
+#endif
+}
+
+void WebcamSource::setCameras(const QList<CameraInfo> & cameras)
+{
+  _webcamList.clear();
+  _webcamIdentities.clear();
+  _webcamAvailability.clear();
+  _webcamResolutions.clear();
+  _webcamCaptureModes.clear();
+  for (const CameraInfo & camera : cameras) {
+    _webcamList.push_back(camera.index);
+    _webcamIdentities.push_back(camera.identity);
+    _webcamAvailability.push_back(camera.available);
+    _webcamResolutions.push_back(camera.resolutions);
+    _webcamCaptureModes.push_back(camera.modes);
+  }
+}
+
+bool WebcamSource::camerasDiffer(const QList<CameraInfo> & cameras)
+{
+  if (cameras.size() != _webcamList.size()) {
+    return true;
+  }
+  for (int i = 0; i < cameras.size(); ++i) {
+    if (cameras[i].index != _webcamList[i] || cameras[i].identity != _webcamIdentities[i] || cameras[i].resolutions != _webcamResolutions[i]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+QString WebcamSource::webcamIdentity(int index)
+{
+  return (index >= 0 && index < _webcamIdentities.size()) ? _webcamIdentities[index] : QString();
+}
+
+QString WebcamSource::settingsKey(const QString & identity, const QString & name)
+{
+  QString group = identity;
+  group.replace(QRegExp("[^A-Za-z0-9_.:@-]"), "_");
+  return QString("WebcamSource/%1/%2").arg(name).arg(group);
+}
+
+const QList<QSize> & WebcamSource::webcamResolutions(int index)
+{
+  static const QList<QSize> empty;
+  return (index >= 0 && index < _webcamResolutions.size()) ? _webcamResolutions[index] : empty;
+}
+
+const QList<WebcamSource::CaptureMode> & WebcamSource::webcamCaptureModes(int index)
+{
+  static const QList<CaptureMode> empty;
+  return (index >= 0 && index < _webcamCaptureModes.size()) ? _webcamCaptureModes[index] : empty;
+}
+
+WebcamSource::CaptureMode WebcamSource::bestCaptureMode(int index, const QSize & size, const QList<unsigned int> & pixelFormats)
+{
+  return bestCaptureMode(webcamCaptureModes(index), size, pixelFormats);
+}
+
+WebcamSource::CaptureMode WebcamSource::bestCaptureMode(const QList<CaptureMode> & modes, const QSize & size, const QList<unsigned int> & pixelFormats)
+{
+  CaptureMode best;
+  best.pixelFormat = 0;
+  best.size = size;
+  best.fps = 0.0f;
+  // Modes are enumerated in the driver's order of preference, which breaks ties
+  for (const CaptureMode & mode : modes) {
+    if (mode.size == size && mode.fps > best.fps && (pixelFormats.isEmpty() || pixelFormats.contains(mode.pixelFormat))) {
+      best = mode;
+    }
+  }
+  return best;
+}
+
+QString WebcamSource::pixelFormatName(unsigned int pixelFormat)
+{
+  if (!pixelFormat) {
+    return QString();
+  }
+  char fourcc[5] = {static_cast<char>(pixelFormat & 0xFF), static_cast<char>((pixelFormat >> 8) & 0xFF), static_cast<char>((pixelFormat >> 16) & 0xFF),
+                    static_cast<char>((pixelFormat >> 24) & 0xFF), 0};
+  return QString(fourcc).trimmed();
+}
+
+QString WebcamSource::backendName(Backend backend)
+{
+  switch (backend) {
+  case V4L2Backend:
+    return "V4L2";
+  case GStreamerBackend:
+    return "GStreamer";
+  case FFmpegBackend:
+    return "FFmpeg";
+  default:
+    return "Any";
+  }
+}
+
+WebcamSource::Backend WebcamSource::backendFromName(const QString & name)
+{
+  for (Backend backend : probedBackends()) {
+    if (name.compare(backendName(backend), Qt::CaseInsensitive) == 0) {
+      return backend;
+    }
+  }
+  return AnyBackend;
+}
+
+QList<WebcamSource::Backend> WebcamSource::probedBackends()
+{
+  QList<Backend> backends;
+#if CV_MAJOR_VERSION >= 3
+#if defined(_IS_UNIX_)
+  backends << V4L2Backend;
+#endif
+  backends << GStreamerBackend << FFmpegBackend;
+#endif
+  return backends;
+}
+
+WebcamSource::Backend WebcamSource::cameraBackend(const QString & identity)
+{
+  // An explicit choice, otherwise the result of the probe
+  const Backend backend = chosenBackend(identity);
+  return (backend == AnyBackend) ? recommendedBackend(identity) : backend;
+}
+
+WebcamSource::Backend WebcamSource::chosenBackend(const QString & identity)
+{
+  return backendFromName(QSettings().value(settingsKey(identity, "Backend")).toString());
+}
+
+WebcamSource::Backend WebcamSource::recommendedBackend(const QString & identity)
+{
+  return backendFromName(QSettings().value(settingsKey(identity, "RecommendedBackend")).toString());
+}
+
+int WebcamSource::cameraBufferSize(const QString & identity)
+{
+  // 0 keeps the driver's default queue depth
+  return QSettings().value(settingsKey(identity, "BufferSize"), 0).toInt();
+}
+
+bool WebcamSource::openCapture(cv::VideoCapture & capture, int index, Backend backend, const QSize & size, int bufferSize)
+{
+  Q_UNUSED(size)
+  try {
+#if CV_MAJOR_VERSION >= 3
+    switch (backend) {
+    case V4L2Backend:
+      // Camera indexes are offset by the backend identifier
+      capture.open(index + cv::CAP_V4L2);
+      break;
+    case GStreamerBackend:
+#if defined(_IS_UNIX_) && defined(CVCAPTURE_HAS_BACKEND_METHOD)
+    {
+      // appsink would otherwise keep every frame the filter was too slow to take
+      const QString pipeline = QString("v4l2src device=/dev/video%1 ! decodebin ! videoconvert ! videoscale ! video/x-raw,format=BGR,width=%2,height=%3 ! appsink drop=true sync=false max-buffers=%4")
+                                   .arg(index)
+                                   .arg(size.width())
+                                   .arg(size.height())
+                                   .arg(std::max(1, bufferSize));
+      capture.open(pipeline.toStdString(), cv::CAP_GSTREAMER);
+    }
+#else
+      capture.open(index + cv::CAP_GSTREAMER);
+#endif
+      break;
+    case FFmpegBackend:
+      // See setCaptureEnvironment()
+#if defined(_IS_UNIX_) && defined(CVCAPTURE_HAS_BACKEND_METHOD)
+      capture.open(QString("/dev/video%1").arg(index).toStdString(), cv::CAP_FFMPEG);
+#else
+      capture.open(index + cv::CAP_FFMPEG);
+#endif
+      break;
+    default:
+      capture.open(index);
+      break;
+    }
+#else
+    Q_UNUSED(backend)
+    capture.open(index);
+#endif
+  } catch (const cv::Exception &) {
+    return false;
+  }
+  if (!capture.isOpened()) {
+    return false;
+  }
+#ifdef ZART_CV_CAP_PROP_BUFFERSIZE
+  if (bufferSize > 0) {
+    capture.set(ZART_CV_CAP_PROP_BUFFERSIZE, bufferSize);
+  }
+#else
+  Q_UNUSED(bufferSize)
+#endif
+  return true;
+}
+
+WebcamSource::BackendProbe WebcamSource::probeBackend(int index, Backend backend, const QSize & size, int bufferSize)
+{
+  BackendProbe probe;
+  probe.backend = backend;
+  probe.ok = false;
+  probe.fps = 0.0f;
+  probe.latency = 0.0f;
+  cv::VideoCapture capture;
+  if (!openCapture(capture, index, backend, size, bufferSize)) {
+    return probe;
+  }
+  try {
+    capture.set(ZART_CV_CAP_PROP_FRAME_WIDTH, size.width());
+    capture.set(ZART_CV_CAP_PROP_FRAME_HEIGHT, size.height());
+    cv::Mat frame;
+    // Auto exposure settles during the first frames, which are often slow
+    for (int i = 0; i < ProbeWarmupFrames; ++i) {
+      if (probeCancelled || !capture.read(frame)) {
+        return probe;
       }
-      if (statusBar) {
-        statusBar->showMessage(QString("Webcam #%1 cannot be opened or used.").arg(iCam + 1), Qt::AlignBottom);
-        qApp->processEvents();
+    }
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < ProbeFrames; ++i) {
+      if (probeCancelled || !capture.read(frame)) {
+        return probe;
       }
-      resolutions.back().clear();
     }
-    delete capture;
-    ++it;
-    ++iCam;
+    probe.fps = ProbeFrames * 1000.0f / std::max(qint64(1), timer.elapsed());
+    const float period = 1000.0f / probe.fps;
+
+    // After a pause longer than the queue, like a filter slower than the
+    // camera, queued frames come back at once: each one is a period old.
+    float latency = 0.0f;
+    for (int trial = 0; trial < ProbeLatencyTrials; ++trial) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(ProbeIdleTime));
+      int staleFrames = 0;
+      timer.restart();
+      qint64 previous = 0;
+      while (staleFrames < 2 * ProbeFrames) {
+        if (probeCancelled || !capture.read(frame)) {
+          return probe;
+        }
+        const qint64 now = timer.elapsed();
+        if (now - previous > period / 2) {
+          break;
+        }
+        previous = now;
+        ++staleFrames;
+      }
+      // A fresh frame was exposed half a period ago on average
+      latency += (staleFrames + 0.5f) * period;
+    }
+    probe.latency = latency / ProbeLatencyTrials;
+    probe.ok = true;
+  } catch (const cv::Exception &) {
+    probe.ok = false;
   }
+  return probe;
+}
 
-  qDebug("Done checking resolutions");
+QList<WebcamSource::BackendProbe> WebcamSource::probeBackends(int index, const QSize & size, int bufferSize)
+{
+  QList<BackendProbe> probes;
+  for (Backend backend : probedBackends()) {
+    if (probeCancelled) {
+      break;
+    }
+    probes.push_back(probeBackend(index, backend, size, bufferSize));
+    const BackendProbe & probe = probes.back();
+    if (probe.ok) {
+      std::cout << "[ZArt] Webcam " << index << ": " << backendName(backend).toStdString() << " delivers " << probe.fps << " fps, latency ~" << static_cast<int>(probe.latency) << " ms"
+                << std::endl;
+    } else {
+      std::cout << "[ZArt] Webcam " << index << ": " << backendName(backend).toStdString() << " is not usable" << std::endl;
+    }
+  }
+  return probes;
+}
 
-  _webcamResolutions.clear();
-  _webcamResolutions.resize(camList.size());
-  iCam = 0;
-  QList<std::set<QSize, QSizeCompare>>::iterator itCam = resolutions.begin();
-  while (itCam != resolutions.end()) {
-    QStringList resolutionsList;
-    std::set<QSize, QSizeCompare>::iterator itRes = itCam->begin();
-    while (itRes != itCam->end()) {
-      _webcamResolutions[iCam].push_back(*itRes);
-      resolutionsList << QString("%1x%2").arg(itRes->width()).arg(itRes->height());
-      ++itRes;
+WebcamSource::Backend WebcamSource::bestBackend(const QList<BackendProbe> & probes)
+{
+  float maxFps = 0.0f;
+  for (const BackendProbe & probe : probes) {
+    if (probe.ok) {
+      maxFps = std::max(maxFps, probe.fps);
     }
-    settings.setValue(QString("WebcamSource/ResolutionsListForCam%1").arg(camList[iCam]), resolutionsList);
-    ++itCam;
-    ++iCam;
   }
+  // Lag matters most, as long as frames are not dropped by the backend
+  Backend best = AnyBackend;
+  float bestLatency = 0.0f;
+  for (const BackendProbe & probe : probes) {
+    if (probe.ok && probe.fps >= 0.9f * maxFps && (best == AnyBackend || probe.latency < bestLatency)) {
+      best = probe.backend;
+      bestLatency = probe.latency;
+    }
+  }
+  return best;
 }
 
-void WebcamSource::retrieveWebcamResolutionsV4L2(const QList<int> & camList)
+void WebcamSource::recommendBackend(const CameraInfo & camera)
 {
-  ENTERING;
-#if defined(HAS_V4L2)
   QSettings settings;
-  QList<std::set<QSize, QSizeCompare>> resolutions;
-  QList<int>::const_iterator it = camList.begin();
-  int iCam = 0;
-  for (; it != camList.end(); ++it, ++iCam) {
-    resolutions.push_back(std::set<QSize, QSizeCompare>());
-    QString filename = QString("/dev/video%1").arg(*it);
-    if (!QFileInfo(filename).isReadable()) {
+  if (!settings.value("WebcamSource/ProbeBackends", true).toBool() || settings.contains(settingsKey(camera.identity, "RecommendedBackend"))) {
+    return;
+  }
+  QSize size = settings.value(settingsKey(camera.identity, "DefaultResolution"), QSize()).toSize();
+  if (!size.isValid()) {
+    size = QSize(640, 480);
+  }
+  const QList<BackendProbe> probes = probeBackends(camera.index, size, cameraBufferSize(camera.identity));
+  if (probeCancelled || isCameraOpen(camera.identity)) {
+    // Opened by ZArt meanwhile: measured at a later detection, once released
+    std::cout << "[ZArt] Webcam " << camera.index << ": measure of the capture backends interrupted" << std::endl;
+    return;
+  }
+  // Also stored if every backend failed, so that it is not measured again at each detection (see --probe-backends)
+  const Backend best = bestBackend(probes);
+  QStringList report;
+  for (const BackendProbe & probe : probes) {
+    report << (probe.ok ? QString("%1: %2 fps, %3 ms").arg(backendName(probe.backend)).arg(probe.fps, 0, 'f', 1).arg(static_cast<int>(probe.latency))
+                        : QString("%1: failed").arg(backendName(probe.backend)));
+  }
+  settings.setValue(settingsKey(camera.identity, "BackendProbe"), report);
+  settings.setValue(settingsKey(camera.identity, "RecommendedBackend"), backendName(best));
+  if (best == AnyBackend) {
+    std::cout << "[ZArt] Webcam " << camera.index << ": capture backends could not be measured" << std::endl;
+  } else {
+    std::cout << "[ZArt] Webcam " << camera.index << ": recommended capture backend is " << backendName(best).toStdString() << std::endl;
+  }
+}
+
+void WebcamSource::recommendBackends(const QList<CameraInfo> & cameras)
+{
+  // Sequentially: cameras measured together would share the USB bus and the CPU
+  for (const CameraInfo & camera : cameras) {
+    // A camera busy for another application is measured at a later detection
+    if (!camera.available || camera.resolutions.isEmpty() || camera.identity.isEmpty()) {
       continue;
     }
-    int fd = open(filename.toLocal8Bit().constData(), O_RDWR);
-    if (fd != -1) {
-      // Is a camera?
-      bool camera = false;
-      v4l2_input input;
-      input.index = 0;
-      while (!ioctl(fd, VIDIOC_ENUMINPUT, &input)) {
-        if (input.type == V4L2_INPUT_TYPE_CAMERA) {
-          qDebug("[Device %d] is a camera", *it);
-          camera = true;
-        }
-        ++input.index;
-      }
-      if (camera) {
-        v4l2_fmtdesc fmt;
-        fmt.index = 0;
-        fmt.type = V4L2_CAP_VIDEO_CAPTURE;
-        QList<unsigned int> pixelFormats;
-        while (!ioctl(fd, VIDIOC_ENUM_FMT, &fmt)) {
-          qDebug("[Device %d] pixel format %c%c%c%c", *it, (char)(fmt.pixelformat & 0xFF), (char)((fmt.pixelformat & 0xFF00) >> 8), (char)((fmt.pixelformat & 0xFF0000) >> 16),
-                 (char)((fmt.pixelformat & 0xFF000000) >> 24));
-          pixelFormats += fmt.pixelformat;
-          ++fmt.index;
-        }
-        for (unsigned int pixelformat : pixelFormats) {
-          v4l2_frmsizeenum framesize;
-          framesize.index = 0;
-          framesize.pixel_format = pixelformat;
-          while (!ioctl(fd, VIDIOC_ENUM_FRAMESIZES, &framesize)) {
-            if (framesize.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
-              QSize size(framesize.discrete.width, framesize.discrete.height);
-              resolutions.back().insert(size);
-            }
-            ++framesize.index;
-          }
-        }
+    {
+      QMutexLocker locker(&probeMutex());
+      // Not the one ZArt keeps open (its availability was checked before it was opened)
+      if (isCameraOpen(camera.identity)) {
+        continue;
       }
-      close(fd);
+      probedIdentity = camera.identity;
+      probeCancelled = false;
     }
+    recommendBackend(camera);
+    QMutexLocker locker(&probeMutex());
+    probedIdentity.clear();
+    probeCancelled = false;
+    probeFinished().wakeAll();
   }
-  qDebug("Done checking resolutions");
-  _webcamResolutions.clear();
-  _webcamResolutions.resize(camList.size());
-  iCam = 0;
-  QList<std::set<QSize, QSizeCompare>>::iterator itCam = resolutions.begin();
-  while (itCam != resolutions.end()) {
-    QStringList resolutionsList;
-    std::set<QSize, QSizeCompare>::iterator itRes = itCam->begin();
-    while (itRes != itCam->end()) {
-      _webcamResolutions[iCam].push_back(*itRes);
-      resolutionsList << QString("%1x%2").arg(itRes->width()).arg(itRes->height());
-      ++itRes;
-    }
-    settings.setValue(QString("WebcamSource/ResolutionsListForCam%1").arg(camList[iCam]), resolutionsList);
-    ++iCam;
-    ++itCam;
+}
+
+void WebcamSource::cancelBackendProbe(const QString & identity)
+{
+  QMutexLocker locker(&probeMutex());
+  if (probedIdentity.isEmpty() || (!identity.isEmpty() && probedIdentity != identity)) {
+    return;
+  }
+  probeCancelled = true;
+  // The camera is released within a frame or so, unless it is being opened
+  QElapsedTimer timer;
+  timer.start();
+  while (!probedIdentity.isEmpty() && (identity.isEmpty() || probedIdentity == identity) && timer.elapsed() < static_cast<qint64>(ProbeCancelTimeout)) {
+    probeFinished().wait(&probeMutex(), ProbeCancelTimeout - static_cast<unsigned long>(timer.elapsed()));
   }
-#else
-  Q_UNUSED(camList)
-#endif
 }
 
-const QList<QSize> & WebcamSource::webcamResolutions(int index)
+void WebcamSource::setCaptureEnvironment()
 {
-  static const QList<QSize> empty;
-  return index >= 0 ? _webcamResolutions[index] : empty;
+  // Read by OpenCV whenever an FFmpeg stream is opened, possibly from other threads
+  if (qgetenv("OPENCV_FFMPEG_CAPTURE_OPTIONS").isEmpty()) {
+    qputenv("OPENCV_FFMPEG_CAPTURE_OPTIONS", "fflags;nobuffer|flags;low_delay");
+  }
+}
+
+void WebcamSource::clearBackendProbes()
+{
+  QSettings settings;
+  settings.remove("WebcamSource/RecommendedBackend");
+  settings.remove("WebcamSource/BackendProbe");
 }
 
 void WebcamSource::clearSavedSettings()
 {
   QSettings settings;
+  clearBackendProbes();
+  settings.remove("WebcamSource/Resolutions");
+  settings.remove("WebcamSource/DefaultResolution");
   for (int i = 0; i < 50; ++i) {
     settings.remove(QString("WebcamSource/ResolutionsListForCam%1").arg(i));
     settings.remove(QString("WebcamSource/DefaultResolutionCam%1").arg(i));
@@ -51,28 +51,90 @@ using namespace std;
 #include <QObject>
 #include <QSplashScreen>
 #include "Common.h"
+#include "FrameSink.h"
+#include "HeadlessRunner.h"
+#include "ImageSequenceSource.h"
 #include "MainWindow.h"
+#include "RawFrameSource.h"
+#include "ScreenSource.h"
+#include "Tracing.h"
 #include "WebcamSource.h"
 #include "gmic.h"
 
+// Given by --trace, written when leaving
+QString traceFile;
+void saveTrace()
+{
+  if (!traceFile.isEmpty() && Tracing::isEnabled()) {
+    Tracing::stop();
+    Tracing::save(traceFile);
+  }
+}
+
 #ifdef _IS_UNIX_
 #include <signal.h>
+HeadlessRunner * headlessRunner = nullptr;
 void onSigQuit(int)
 {
   std::cout << "Got a Quit/Interrupt signal from keyboard.\n";
+  if (headlessRunner) {
+    // The output is completed and statistics are printed
+    headlessRunner->stop();
+    return;
+  }
   qApp->closeAllWindows();
+  saveTrace();
   exit(0);
 }
 #endif
 
+// Removes an option and its value from the arguments
+QString takeOption(QStringList & args, const QString & option)
+{
+  const int index = args.indexOf(option);
+  if (index == -1 || index + 1 >= args.size()) {
+    return QString();
+  }
+  const QString value = args[index + 1];
+  args.removeAt(index);
+  args.removeAt(index);
+  return value;
+}
+
 void usage(const char * argv0)
 {
   cout << "Usage:" << endl
-       << "       " << QFileInfo(argv0).baseName().toLocal8Bit().constData() << " [options] [image_file|video_file]" << endl
+       << "       " << QFileInfo(argv0).baseName().toLocal8Bit().constData() << " [options] [image_file|video_file|folder|pattern|stream|screen]" << endl
+       << "       (a folder, or a pattern like frame_%04d.png, is played as an image sequence)" << endl
+       << "       (a stream of frames from another process is shm:name, fifo:path or stdin)" << endl
+       << "       (a region of the X11 screen is screen:, screen:WxH+X+Y or screen:window=<id>)" << endl
        << "\n"
        << "Options: " << endl
        << "      --clear-cams  : Clear webcam cache." << endl
+       << "      --probe-backends : Measure again the capture backends of each webcam." << endl
+       << "      --record <file> : Record the output to a video file." << endl
+       << "      --sink <stdout|fifo:path|shm:name|v4l2:device> : Write raw output frames for other processes." << endl
+       << "      --sink-format <rgb24|bgr24|gray8> : Pixel format of the raw frames (rgb24)." << endl
+       << "      --sink-no-header : Pixels only on pipes (e.g. for ffmpeg -f rawvideo)." << endl
+       << "      --mjpeg <[host:]port> : Serve the output as MJPEG over HTTP (localhost unless a host is given, * for any)." << endl
+       << "      --mjpeg-rate <fps> : Maximum frame rate of the MJPEG stream (15)." << endl
+       << "      --mjpeg-quality <1-100> : JPEG quality of the MJPEG stream (80)." << endl
+       << "      --raw-size <WxH> : Input stream (stdin, fifo:path) without headers, e.g. from ffmpeg -f rawvideo." << endl
+       << "      --raw-format <bgr24|rgb24|gray8> : Pixel format of such a stream (bgr24)." << endl
+       << "      --trace <file.json> : Record the work of each thread, saved on exit as a Chrome trace." << endl
+       << "      --metrics-socket <path> : Write health and performance metrics (JSON) to each client of a Unix socket." << endl
+       << "      --metrics-log <file> : Append the same metrics to a file, one line at a time." << endl
+       << "      --metrics-interval <seconds> : Period of the metrics log (10)." << endl
        << "      --help | -h   : print this help." << endl
+       << "\n"
+       << "Headless mode (no window, frames are rendered as fast as possible):" << endl
+       << "      --headless --input <camera_index|image|video|folder|pattern|stream|screen>" << endl
+       << "      [--preset <name|group/name> [--presets <file.xml>] | --command <gmic_command>]" << endl
+       << "      [--params <comma separated values>] [--output <image|pattern|video>]" << endl
+       << "      [--frames <count>] [--rate <fps of the output video>]" << endl
+       << "      [--codec <fourcc>] [--record-policy <wait|drop>]" << endl
+       << "      [--mjpeg <[host:]port> [--mjpeg-rate <fps>] [--mjpeg-quality <1-100>]]" << endl
+       << "      [--trace <file.json>] [--metrics-socket <path>] [--metrics-log <file> [--metrics-interval <seconds>]]" << endl
        << endl;
   exit(EXIT_SUCCESS);
 }
@@ -83,28 +145,83 @@ int main(int argc, char * argv[])
   signal(SIGQUIT, onSigQuit);
   signal(SIGINT, onSigQuit);
 #endif
-  QApplication app(argc, argv);
-  app.setWindowIcon(QIcon(":images/gmic_hat.png"));
   QCoreApplication::setOrganizationName("GREYC");
   QCoreApplication::setOrganizationDomain("greyc.fr");
   QCoreApplication::setApplicationName("ZArt");
+  WebcamSource::setCaptureEnvironment();
+  if (HeadlessRunner::isRequested(argc, argv)) {
+    QCoreApplication app(argc, argv);
+    if (QCoreApplication::arguments().contains("-h") || QCoreApplication::arguments().contains("--help")) {
+      usage(argv[0]);
+    }
+    if (!gmic::init_rc()) {
+      cerr << "[ZArt] Warning: Could not create resources directory.\n";
+    }
+    HeadlessRunner runner;
+#ifdef _IS_UNIX_
+    headlessRunner = &runner;
+#endif
+    const int status = runner.exec(QCoreApplication::arguments());
+#ifdef _IS_UNIX_
+    headlessRunner = nullptr;
+#endif
+    return status;
+  }
+  QApplication app(argc, argv);
+  app.setWindowIcon(QIcon(":images/gmic_hat.png"));
   QCoreApplication::setAttribute(Qt::AA_DontUseNativeMenuBar);
   if (QApplication::arguments().contains("-h") || QApplication::arguments().contains("--help")) {
     usage(argv[0]);
   }
+  // Option values are not input files
+  QStringList args = QApplication::arguments();
+  const QString recordFile = takeOption(args, "--record");
+  const QString sinkFormat = takeOption(args, "--sink-format");
+  const QString sinkSpec = takeOption(args, "--sink");
+  const QSize rawSize = RawFrameSource::sizeFromString(takeOption(args, "--raw-size"));
+  const QString rawFormat = takeOption(args, "--raw-format");
+  const QString mjpegAddress = takeOption(args, "--mjpeg");
+  const double mjpegRate = takeOption(args, "--mjpeg-rate").toDouble();
+  const QString mjpegQuality = takeOption(args, "--mjpeg-quality");
+  traceFile = takeOption(args, "--trace");
+  const QString metricsSocket = takeOption(args, "--metrics-socket");
+  const QString metricsLog = takeOption(args, "--metrics-log");
+  const int metricsInterval = takeOption(args, "--metrics-interval").toInt();
+  if (!traceFile.isEmpty()) {
+    Tracing::start();
+  }
+  // Created first: messages printed until then would be mixed with frames sent to the standard output
+  FrameSink * sink = sinkSpec.isEmpty() ? nullptr : FrameSink::create(sinkSpec, sinkFormat, !args.contains("--sink-no-header"));
   QSplashScreen splashScreen(QPixmap(":/images/splash.png"));
   splashScreen.show();
   app.processEvents();
   if (QApplication::arguments().contains("--clear-cams")) {
     WebcamSource::clearSavedSettings();
   }
-  WebcamSource::retrieveWebcamResolutions(WebcamSource::getWebcamList(), &splashScreen);
+  if (QApplication::arguments().contains("--probe-backends")) {
+    // Cameras without a recommended backend are probed when detected
+    WebcamSource::clearBackendProbes();
+  }
   if (!gmic::init_rc()) {
     cerr << "[ZArt] Warning: Could not create resources directory.\n";
   }
   MainWindow mainWindow;
-  QStringList args = QApplication::arguments();
-  if ((args.size() > 1) && QFileInfo(args.back()).isReadable()) {
+  if (!recordFile.isEmpty()) {
+    mainWindow.setRecordFile(recordFile);
+  }
+  mainWindow.setFrameSink(sink);
+  mainWindow.setMetrics(metricsSocket, metricsLog, metricsInterval);
+  if (!mjpegAddress.isEmpty()) {
+    mainWindow.setMjpegAddress(mjpegAddress, mjpegRate, mjpegQuality.isEmpty() ? -1 : mjpegQuality.toInt());
+  }
+  if ((args.size() > 1) && RawFrameSource::isStream(args.back())) {
+    mainWindow.setInputStream(args.back(), rawSize, rawFormat);
+  } else if ((args.size() > 1) && ScreenSource::isScreen(args.back())) {
+    mainWindow.setInputScreen(args.back());
+  } else if ((args.size() > 1) && ImageSequenceSource::isSequence(args.back())) {
+    // A folder, or a printf-style pattern like frame_%04d.png
+    mainWindow.setInputSequence(args.back());
+  } else if ((args.size() > 1) && QFileInfo(args.back()).isReadable()) {
     QStringList imagesExtensions = QString(".bmp;.gif;.jpg;.png;.pbm;.pgm;.ppm;.xbm;.xpm;.svg").split(";");
     for (const QString & ext : imagesExtensions) {
       if (args.back().endsWith(ext)) {
@@ -120,5 +237,7 @@ int main(int argc, char * argv[])
   }
   mainWindow.show();
   splashScreen.finish(&mainWindow);
-  return app.exec();
+  const int status = app.exec();
+  saveTrace();
+  return status;
 }
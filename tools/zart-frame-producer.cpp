@@ -0,0 +1,302 @@
+/** -*- mode: c++ ; c-basic-offset: 2 -*-
+ * @file   zart-frame-producer.cpp
+ * @author Sebastien Fourey
+ * @date   Oct 2026
+ * @brief  Test producer of raw frames for the stream input of ZArt
+ *
+ * This file is part of the ZArt software's source code.
+ *
+ * Copyright Sebastien Fourey / GREYC Ensicaen (2010-...)
+ *
+ *                    https://foureys.users.greyc.fr/
+ *
+ * This software is a computer program whose purpose is to demonstrate
+ * the possibilities of the GMIC image processing language by offering the
+ * choice of several manipulations on a video stream acquired from a webcam. In
+ * other words, ZArt is a GUI for G'MIC real-time manipulations on the output
+ * of a webcam.
+ *
+ * This software is governed by the CeCILL  license under French law and
+ * abiding by the rules of distribution of free software.  You can  use,
+ * modify and/ or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info". See also the directory "Licence" which comes
+ * with this source code for the full text of the CeCILL license.
+ *
+ * As a counterpart to the access to the source code and  rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty  and the software's author,  the holder of the
+ * economic rights,  and the successive licensors  have only  limited
+ * liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated
+ * with loading,  using,  modifying and/or developing or reproducing the
+ * software by the user in light of its specific status of free software,
+ * that may mean  that it is complicated to manipulate,  and  that  also
+ * therefore means  that it is reserved for developers  and  experienced
+ * professionals having in-depth computer knowledge. Users are therefore
+ * encouraged to load and test the software's suitability as regards their
+ * requirements in conditions enabling the security of their systems and/or
+ * data to be ensured and,  more generally, to use and operate it in the
+ * same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ */
+
+/*
+ * Writes a moving test pattern as raw frames (see include/RawFrame.h), to
+ * a shared memory ring or to the standard output, for the stream input of
+ * ZArt. It does not depend on Qt and is a reference for other producers.
+ *
+ * Build:  g++ -O2 -std=c++11 -Iinclude -o zart-frame-producer tools/zart-frame-producer.cpp -lrt
+ * Run:    ./zart-frame-producer --shm /zart-input &   zart shm:/zart-input
+ *         ./zart-frame-producer --stdout | zart stdin
+ *         ./zart-frame-producer --stdout --no-header | zart --raw-size 640x480 stdin
+ */
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include "RawFrame.h"
+
+namespace
+{
+volatile std::sig_atomic_t running = 1;
+
+void onSignal(int)
+{
+  running = 0;
+}
+
+std::int64_t monotonicTime()
+{
+  // Same clock as ZArt, so that latencies can be measured across processes
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return std::int64_t(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+void ringDoorbell(RawFrame::RingHeader * ring)
+{
+  ++ring->doorbell;
+#if defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&ring->doorbell), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+bool writeAll(int fd, const void * data, size_t size)
+{
+  const unsigned char * position = static_cast<const unsigned char *>(data);
+  while (size) {
+    const ssize_t count = write(fd, position, size);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return false;
+    }
+    position += count;
+    size -= count;
+  }
+  return true;
+}
+
+// Scrolling color bars, a bouncing square, and the frame number in binary on the first rows
+void drawFrame(unsigned char * pixels, const RawFrame::FrameHeader & header)
+{
+  const int width = header.width;
+  const int height = header.height;
+  const int bpp = RawFrame::bytesPerPixel(header.format);
+  const std::uint64_t n = header.sequence;
+  const int squareSize = height / 6;
+  const int period = 2 * (width - squareSize);
+  const int squareX = (period > 0) ? int(n * 4 % period) : 0;
+  const int squareLeft = (squareX < width - squareSize) ? squareX : period - squareX;
+  const int squareTop = height / 2 - squareSize / 2;
+  static const unsigned char bars[8][3] = {{255, 255, 255}, {255, 255, 0}, {0, 255, 255}, {0, 255, 0}, {255, 0, 255}, {255, 0, 0}, {0, 0, 255}, {0, 0, 0}};
+  for (int y = 0; y < height; ++y) {
+    unsigned char * row = pixels + size_t(y) * header.stride;
+    for (int x = 0; x < width; ++x) {
+      const unsigned char * rgb = bars[((x + int(n * 2)) * 8 / width) % 8];
+      unsigned char r = rgb[0], g = rgb[1], b = rgb[2];
+      if (y < 16) {
+        const bool bit = (n >> (63 - (x * 64 / width))) & 1;
+        r = g = b = bit ? 255 : 32;
+      } else if (x >= squareLeft && x < squareLeft + squareSize && y >= squareTop && y < squareTop + squareSize) {
+        r = g = b = 128;
+      }
+      unsigned char * pixel = row + x * bpp;
+      if (header.format == RawFrame::Gray8) {
+        pixel[0] = static_cast<unsigned char>((r * 77 + g * 150 + b * 29) >> 8);
+      } else if (header.format == RawFrame::BGR24) {
+        pixel[0] = b;
+        pixel[1] = g;
+        pixel[2] = r;
+      } else {
+        pixel[0] = r;
+        pixel[1] = g;
+        pixel[2] = b;
+      }
+    }
+  }
+}
+
+void usage(const char * argv0)
+{
+  std::fprintf(stderr,
+               "Usage: %s (--shm <name> | --stdout) [--size <WxH>] [--fps <rate>] [--format <bgr24|rgb24|gray8>]\n"
+               "       [--slots <count>] [--frames <count>] [--no-header]\n",
+               argv0);
+  std::exit(EXIT_FAILURE);
+}
+} // namespace
+
+int main(int argc, char * argv[])
+{
+  std::string shmName;
+  bool toStdout = false;
+  bool headers = true;
+  int width = 640;
+  int height = 480;
+  double fps = 30.0;
+  int slotCount = 4;
+  long maxFrames = 0;
+  std::uint32_t format = RawFrame::BGR24;
+  for (int i = 1; i < argc; ++i) {
+    const std::string option = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (option == "--shm" && hasValue) {
+      shmName = argv[++i];
+      if (shmName[0] != '/') {
+        shmName.insert(0, "/");
+      }
+    } else if (option == "--stdout") {
+      toStdout = true;
+    } else if (option == "--no-header") {
+      headers = false;
+    } else if (option == "--size" && hasValue) {
+      if (std::sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+        usage(argv[0]);
+      }
+    } else if (option == "--fps" && hasValue) {
+      fps = std::atof(argv[++i]);
+    } else if (option == "--slots" && hasValue) {
+      slotCount = std::max(2, std::atoi(argv[++i]));
+    } else if (option == "--frames" && hasValue) {
+      maxFrames = std::atol(argv[++i]);
+    } else if (option == "--format" && hasValue) {
+      const std::string name = argv[++i];
+      format = (name == "rgb24") ? RawFrame::RGB24 : (name == "gray8") ? RawFrame::Gray8 : RawFrame::BGR24;
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (shmName.empty() == !toStdout || fps <= 0.0) {
+    usage(argv[0]);
+  }
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+  std::signal(SIGPIPE, onSignal);
+
+  RawFrame::FrameHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = RawFrame::FrameMagic;
+  header.format = format;
+  header.width = width;
+  header.height = height;
+  header.stride = width * RawFrame::bytesPerPixel(format);
+  header.size = header.stride * height;
+
+  // Shared memory ring, laid out as described in RawFrame.h
+  RawFrame::RingHeader * ring = nullptr;
+  unsigned char * memory = nullptr;
+  size_t slotSize = 0;
+  size_t memorySize = 0;
+  std::vector<unsigned char> buffer;
+  if (!shmName.empty()) {
+    slotSize = RawFrame::SlotHeaderSize + ((header.size + 63) & ~size_t(63));
+    memorySize = RawFrame::RingHeaderSize + slotCount * slotSize;
+    shm_unlink(shmName.c_str());
+    const int fd = shm_open(shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1 || ftruncate(fd, memorySize) == -1) {
+      std::fprintf(stderr, "Cannot create shared memory %s: %s\n", shmName.c_str(), std::strerror(errno));
+      return EXIT_FAILURE;
+    }
+    void * address = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+      std::fprintf(stderr, "Cannot map shared memory %s: %s\n", shmName.c_str(), std::strerror(errno));
+      shm_unlink(shmName.c_str());
+      return EXIT_FAILURE;
+    }
+    memory = static_cast<unsigned char *>(address);
+    ring = new (memory) RawFrame::RingHeader;
+    ring->slotCount = slotCount;
+    ring->slotSize = static_cast<std::uint32_t>(slotSize);
+    ring->doorbell = 0;
+    ring->closed = 0;
+    ring->frames = 0;
+    for (int i = 0; i < slotCount; ++i) {
+      new (memory + RawFrame::RingHeaderSize + i * slotSize) RawFrame::SlotHeader();
+    }
+    ring->version = RawFrame::Version;
+    std::atomic_thread_fence(std::memory_order_release);
+    ring->magic = RawFrame::RingMagic;
+    std::fprintf(stderr, "Writing %dx%d frames at %g fps to %s (%d slots)\n", width, height, fps, shmName.c_str(), slotCount);
+  } else {
+    buffer.resize(header.size);
+    std::fprintf(stderr, "Writing %dx%d frames at %g fps to the standard output%s\n", width, height, fps, headers ? "" : " (no headers)");
+  }
+
+  const std::int64_t period = static_cast<std::int64_t>(1000000.0 / fps);
+  std::int64_t next = monotonicTime();
+  for (std::uint64_t n = 0; running && (!maxFrames || long(n) < maxFrames); ++n) {
+    header.sequence = n;
+    header.timestamp = monotonicTime();
+    if (ring) {
+      RawFrame::SlotHeader * slot = reinterpret_cast<RawFrame::SlotHeader *>(memory + RawFrame::RingHeaderSize + (n % slotCount) * slotSize);
+      slot->lock.fetch_add(1); // Odd: being written
+      std::atomic_thread_fence(std::memory_order_release);
+      slot->frame = header;
+      drawFrame(reinterpret_cast<unsigned char *>(slot) + RawFrame::SlotHeaderSize, header);
+      slot->lock.fetch_add(1, std::memory_order_release);
+      ++ring->frames;
+      ringDoorbell(ring);
+    } else {
+      drawFrame(buffer.data(), header);
+      if ((headers && !writeAll(STDOUT_FILENO, &header, sizeof(header))) || !writeAll(STDOUT_FILENO, buffer.data(), buffer.size())) {
+        break; // The reader has gone
+      }
+    }
+    next += period;
+    const std::int64_t delay = next - monotonicTime();
+    if (delay > 0) {
+      usleep(static_cast<useconds_t>(delay));
+    } else {
+      next = monotonicTime(); // Late: do not try to catch up
+    }
+  }
+  if (ring) {
+    // Readers reopen the ring if a new one comes up with the same name
+    ring->closed = 1;
+    ringDoorbell(ring);
+    shm_unlink(shmName.c_str());
+    munmap(memory, memorySize);
+  }
+  return EXIT_SUCCESS;
+}
@@ -132,6 +132,15 @@ linux:!exists(/usr/include/linux/videodev2.h) {
  warning(v4l2 header file videodev2.h not found. It is HIGHLY recommended.)
 }
 
+#
+# Check for the X11 shared memory extension (screen capture)
+#
+linux:packagesExist(x11 xext) {
+ message("X11 shared memory extension is available")
+ PKGCONFIG += x11 xext
+ DEFINES += HAS_XSHM
+}
+
 DEFINES += cimg_use_abort
 
 INCLUDEPATH += $$PWD $$PWD/include
@@ -153,8 +162,23 @@ HEADERS	+= $$GMIC_PATH/gmic.h \
     include/DialogLicense.h \
     include/ImageSource.h \
     include/WebcamSource.h \
+    include/V4L2Source.h \
     include/StillImageSource.h \
     include/VideoFileSource.h \
+    include/VideoDecoder.h \
+    include/ImageSequenceSource.h \
+    include/HeadlessRunner.h \
+    include/Recorder.h \
+    include/RawFrame.h \
+    include/SharedFrameRing.h \
+    include/FrameBus.h \
+    include/FrameTimings.h \
+    include/Tracing.h \
+    include/FrameSink.h \
+    include/MetricsReporter.h \
+    include/MjpegServer.h \
+    include/RawFrameSource.h \
+    include/ScreenSource.h \
     include/Common.h \
     include/TreeWidgetPresetItem.h \
     include/AbstractParameter.h \
@@ -176,7 +200,10 @@ HEADERS	+= $$GMIC_PATH/gmic.h \
     include/PointParameter.h \
     include/KeypointList.h\
     include/OverrideCursor.h\
-    include/OutputWindow.h
+    include/OutputWindow.h \
+    include/CameraDiscovery.h \
+    include/LatencyMonitor.h \
+    include/RenderCache.h
 
 SOURCES	+= \
     src/ImageView.cpp \
@@ -189,8 +216,22 @@ SOURCES	+= \
     src/DialogLicense.cpp \
     src/ImageSource.cpp \
     src/WebcamSource.cpp \
+    src/V4L2Source.cpp \
     src/StillImageSource.cpp \
     src/VideoFileSource.cpp \
+    src/VideoDecoder.cpp \
+    src/ImageSequenceSource.cpp \
+    src/HeadlessRunner.cpp \
+    src/Recorder.cpp \
+    src/SharedFrameRing.cpp \
+    src/FrameBus.cpp \
+    src/FrameTimings.cpp \
+    src/Tracing.cpp \
+    src/FrameSink.cpp \
+    src/MetricsReporter.cpp \
+    src/MjpegServer.cpp \
+    src/RawFrameSource.cpp \
+    src/ScreenSource.cpp \
     src/TreeWidgetPresetItem.cpp \
     src/AbstractParameter.cpp \
     src/IntParameter.cpp \
@@ -210,7 +251,10 @@ SOURCES	+= \
     src/ConstParameter.cpp \
     src/KeypointList.cpp \
     src/OverrideCursor.cpp \
-    src/OutputWindow.cpp
+    src/OutputWindow.cpp \
+    src/CameraDiscovery.cpp \
+    src/LatencyMonitor.cpp \
+    src/RenderCache.cpp
 
 RESOURCES = zart.qrc
 DEPENDPATH += $$PWD/images
@@ -242,6 +286,9 @@ OBJECTS_DIR = .obj
 
 unix:!macx { DEFINES += _IS_UNIX_ }
 
+# shm_open() with older C libraries
+linux { LIBS += -lrt }
+
 freebsd {
  DEFINES += _IS_FREEBSD_
  message(Detected OS is PreeBSD)